@@ -0,0 +1,112 @@
+// Level archive and cache: store a few hundred generated levels, then bring
+// them back in random order. Reports record size, store and restore times,
+// the resident set before and after the restores, and what a trip up and
+// down the stairs costs when the level cache holds both levels.
+#include "global.h"
+#include "character.h"
+#include "level_cache.h"
+#include "rng.h"
+#include "bench_common.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// A line of /proc/self/status, in KiB.
+static long status_kb(const char* key) {
+    long kb = 0;
+    char line[256];
+    FILE* f = std::fopen("/proc/self/status", "r");
+    if (!f)
+        return 0;
+    while (std::fgets(line, sizeof line, f))
+        if (std::strncmp(line, key, std::strlen(key)) == 0)
+            kb = std::atol(line + std::strlen(key));
+    std::fclose(f);
+    return kb;
+}
+
+int main(int argc, char* argv[]) {
+    int levels = 300, monsters = 50, rounds = 2000;
+    const char* prefix = "/tmp/bench_archive.";
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--levels") == 0 && i + 1 < argc)
+            levels = std::atoi(argv[++i]);
+        else if (strcmp(argv[i], "--nummon") == 0 && i + 1 < argc)
+            monsters = std::atoi(argv[++i]);
+        else if (strcmp(argv[i], "--rounds") == 0 && i + 1 < argc)
+            rounds = std::atoi(argv[++i]);
+        else if (strcmp(argv[i], "--prefix") == 0 && i + 1 < argc)
+            prefix = argv[++i];
+    }
+    if (levels < 1 || levels > ARCHIVE_DEPTHS / 2) {
+        std::fprintf(stderr, "--levels must be 1..%d\n", ARCHIVE_DEPTHS / 2);
+        return 1;
+    }
+    rng_seed(327);
+
+    use_bench_rats();
+    use_bench_objects();
+
+    // The file is unlinked once open, and goes when the bench does.
+    archive_set_prefix(prefix, true);
+    archive_new_game();
+    if (!archive_is_open())
+        return 1;
+
+    double store_us = 0;
+    stored_level_t level;
+    for (int d = 0; d < levels; d++) {
+        new_level(monsters);
+        auto t0 = bench_clock::now();
+        level_capture(level);
+        if (!archive_store(d, level)) {
+            std::perror(prefix);
+            return 1;
+        }
+        store_us += us_since(t0);
+    }
+
+    long anon_before = status_kb("RssAnon:"), file_before = status_kb("RssFile:");
+    double restore_us = 0;
+    for (int r = 0; r < rounds; r++) {
+        int d = static_cast<int>(rng_below(RngStream::Level, levels));
+        auto t0 = bench_clock::now();
+        if (!archive_load(d, level)) {
+            std::fprintf(stderr, "depth %d did not restore\n", d);
+            return 1;
+        }
+        level_apply(level);
+        restore_us += us_since(t0);
+    }
+    long anon_after = status_kb("RssAnon:"), file_after = status_kb("RssFile:");
+    archive_stats_t s = archive_stats();
+
+    // Back and forth between two depths, both held in memory; each level
+    // left is still written to the archive.
+    double hit_us = 0;
+    level_cache_leave(0);
+    level_cache_enter(1);
+    for (int r = 0; r < rounds; r++) {
+        auto t0 = bench_clock::now();
+        level_cache_leave(1 - r % 2);
+        if (!level_cache_enter(r % 2)) {
+            std::fprintf(stderr, "depth %d was not cached\n", r % 2);
+            return 1;
+        }
+        hit_us += us_since(t0);
+    }
+    level_cache_stats_t cs = level_cache_stats();
+    archive_close();
+
+    std::printf("map %dx%d, %d levels of %d monsters, %llu bytes (%llu per level, %zu raw hardness)\n",
+                WIDTH, HEIGHT, s.levels, monsters, static_cast<unsigned long long>(s.bytes),
+                static_cast<unsigned long long>(s.bytes / s.levels), sizeof(hardness));
+    std::printf("store %.1f us (mean of %d), restore %.1f us (mean of %d)\n",
+                store_us / levels, levels, restore_us / rounds, rounds);
+    std::printf("cached stairs %.1f us (mean of %d, %ld hits, %ld misses, %zu KiB a level held)\n",
+                hit_us / rounds, rounds, cs.hits, cs.misses, cs.levels ? (cs.bytes >> 10) / cs.levels : 0);
+    std::printf("resident before restores %ld KiB heap, %ld KiB file; after %ld KiB heap, %ld KiB file\n",
+                anon_before, file_before, anon_after, file_after);
+    return 0;
+}
@@ -0,0 +1,124 @@
+#ifndef BENCH_COMMON_H
+#define BENCH_COMMON_H
+
+// What the benches that play a level share: the clock, monster and object
+// templates, and the turn loop.
+#include "global.h"
+#include "character.h"
+#include "monster_template.h"
+#include "object_template.h"
+
+#include <chrono>
+#include <queue>
+#include <vector>
+
+using bench_clock = std::chrono::steady_clock;
+
+inline double us_since(bench_clock::time_point t0) {
+    return std::chrono::duration<double, std::micro>(bench_clock::now() - t0).count();
+}
+
+inline MonsterTemplate make_template(char symb, const char* abil, const char* color = "RED") {
+    MonsterTemplate t;
+    t.name = std::string(1, symb);
+    t.symbol = symb;
+    t.colors = {color};
+    t.speed = Dice{5, 1, 15};
+    t.abilities = {abil};
+    t.hp = Dice{10, 2, 6};
+    t.damage = Dice{0, 1, 4};
+    t.rarity = 100;
+    return t;
+}
+
+// Tunnelling, wandering and smart monsters.
+inline void use_bench_monsters() {
+    monster_templates = {make_template('T', "TUNNEL"), make_template('r', "ERRATIC"),
+                         make_template('p', "SMART")};
+}
+
+// Only rats, all alike: for benches that measure storing or drawing a
+// level rather than how monsters behave.
+inline void use_bench_rats() {
+    MonsterTemplate t;
+    t.name = "rat";
+    t.symbol = 'r';
+    t.colors = {"YELLOW"};
+    t.speed = Dice{10, 0, 1};
+    t.abilities = {"ERRATIC"};
+    t.hp = Dice{5, 0, 1};
+    t.damage = Dice{0, 1, 2};
+    t.rarity = 100;
+    monster_templates = {t};
+}
+
+// One kind of object, a dagger, for new_level() to scatter.
+inline void use_bench_objects() {
+    ObjectTemplate o;
+    o.name = "dagger";
+    o.description = "A short, sharp blade.";
+    o.symbol = '|';
+    o.colors = {"CYAN"};
+    o.hit = o.dodge = o.defense = o.weight = o.speed = o.attribute = o.value = Dice{0, 1, 3};
+    o.damage = Dice{0, 1, 4};
+    o.artifact = false;
+    o.rarity = 100;
+    object_templates = {o};
+}
+
+// Ties go to the lower slot, so a run does not depend on the queue's order.
+struct EventComparator {
+    bool operator()(const event_t &a, const event_t &b) const {
+        if (a.time != b.time)
+            return a.time > b.time;
+        return a.c > b.c;
+    }
+};
+
+// Play the characters on the map from their next_time, the way the game
+// loop does, until the PC has had pc_turns turns or no monster is left.
+// pc_turn(pc) plays the PC's turns; monsters due at the same time move as
+// one do_monster_turns() batch, whose time is added to monster_us if
+// given. next_time is kept up, so another call carries on from here.
+template <typename PcTurn>
+void play_turns(int pc_turns, PcTurn pc_turn, double* monster_us = nullptr) {
+    std::priority_queue<event_t, std::vector<event_t>, EventComparator> q;
+    for (auto &ch : characters)
+        if (ch.alive)
+            q.push({ch.next_time, &ch});
+    std::vector<character_t*> batch;
+    while (pc_turns > 0 && !q.empty() && monsters_alive > 0) {
+        event_t e = q.top();
+        q.pop();
+        character_t* c = e.c;
+        if (!c->alive)
+            continue;
+        if (c->type == CharType::PC) {
+            pc_turn(*c);
+            c->next_time = e.time + 1000 / c->speed;
+            q.push({c->next_time, c});
+            pc_turns--;
+            continue;
+        }
+        batch.clear();
+        batch.push_back(c);
+        while (!q.empty() && q.top().time == e.time && q.top().c->type == CharType::Monster) {
+            if (q.top().c->alive)
+                batch.push_back(q.top().c);
+            q.pop();
+        }
+        auto t0 = bench_clock::now();
+        do_monster_turns(batch);
+        if (monster_us)
+            *monster_us += us_since(t0);
+        for (character_t* m : batch) {
+            m->turn++;
+            if (m->alive) {
+                m->next_time = e.time + 1000 / m->speed;
+                q.push({m->next_time, m});
+            }
+        }
+    }
+}
+
+#endif // BENCH_COMMON_H
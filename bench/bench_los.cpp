@@ -0,0 +1,51 @@
+// Ranged line-of-fire queries: cost of monster_has_shot() for many monsters
+// scattered around the PC on a rubble-strewn level.
+#include "global.h"
+#include "character.h"
+#include "los.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using bench_clock = std::chrono::steady_clock;
+
+int main(int argc, char* argv[]) {
+    int queries = 1000000;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--queries") == 0 && i + 1 < argc)
+            queries = std::atoi(argv[++i]);
+    }
+    srand(327);
+
+    // 70% open floor, the rest rock, so lines of fire are often blocked.
+    for (int y = 0; y < HEIGHT; y++)
+        for (int x = 0; x < WIDTH; x++)
+            hardness[y][x] = (rand() % 10 < 7) ? 0 : 100;
+    terrain_generation++;
+    pc_x = WIDTH / 2;
+    pc_y = HEIGHT / 2;
+
+    auto t0 = bench_clock::now();
+    los_sync();
+    double build_us = std::chrono::duration<double, std::micro>(bench_clock::now() - t0).count();
+
+    std::vector<character_t> shooters(4096);
+    for (auto &m : shooters) {
+        m.x = pc_x + rand() % (2 * MAX_TARGET_RANGE + 1) - MAX_TARGET_RANGE;
+        m.y = pc_y + rand() % (2 * MAX_TARGET_RANGE + 1) - MAX_TARGET_RANGE;
+    }
+
+    int clear = 0;
+    t0 = bench_clock::now();
+    for (int i = 0; i < queries; i++)
+        clear += monster_has_shot(shooters[i & 4095]);
+    double total_us = std::chrono::duration<double, std::micro>(bench_clock::now() - t0).count();
+
+    std::printf("map %dx%d, range %d\n", WIDTH, HEIGHT, MAX_TARGET_RANGE);
+    std::printf("tables + walkable build: %.1f us\n", build_us);
+    std::printf("%d queries, %.1f%% clear, %.3f us/query\n", queries,
+                100.0 * clear / queries, total_us / queries);
+    return 0;
+}
@@ -0,0 +1,133 @@
+// Monster-count sweep: per-turn cost of AI, scheduling, pathfinding and
+// rendering on a large open level. Build with `make bench`, which sets a
+// 512x256 map so 100k monsters fit.
+#include "global.h"
+#include "dungeon.h"
+#include "pathfinding.h"
+#include "character.h"
+#include "occupancy.h"
+#include "ui.h"
+#include "renderer.h"
+#include "rng.h"
+#include "bench_common.h"
+
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+struct bench_row_t {
+    int monsters;
+    double ai_us, sched_us, paths_us, render_us;
+};
+
+// One big room covering the whole interior, PC in the middle.
+static void build_open_level() {
+    characters.clear();
+    monsters_alive = 0;
+    object_instances.clear();
+    rebuild_object_map();
+    initializeDungeon();
+    for (int y = 1; y < HEIGHT - 1; y++) {
+        for (int x = 1; x < WIDTH - 1; x++) {
+            dungeon[y][x] = '.';
+            hardness[y][x] = 0;
+        }
+    }
+    room_x[0] = 1; room_y[0] = 1;
+    room_w[0] = WIDTH - 2; room_h[0] = HEIGHT - 2;
+    room_count = 1;
+    placeStairs();
+    base_map = dungeon;
+    pc_x = WIDTH / 2;
+    pc_y = HEIGHT / 2;
+    placePC(pc_x, pc_y);
+    for (auto &row : char_map)
+        row.fill(-1);
+}
+
+static bench_row_t run_sweep_point(int nummon, int turns) {
+    build_open_level();
+    characters.reserve(nummon + 1);
+    create_pc();
+    characters[0].hp = INT_MAX / 2;  // the PC only exists to be chased
+    for (int i = 0; i < nummon; i++)
+        create_monster();
+
+    bench_row_t row{monsters_alive, 0, 0, 0, 0};
+    auto loop_start = bench_clock::now();
+    double ai_total = 0;
+    play_turns(turns, [&row](character_t &) {
+        // Worst case for the lazy maps: both rebuilt every PC turn, as if
+        // the PC had moved.
+        auto t0 = bench_clock::now();
+        pathfinding_terrain_changed();
+        ensure_distance_maps(true, true);
+        row.paths_us += us_since(t0);
+        t0 = bench_clock::now();
+        display_dungeon();
+        row.render_us += us_since(t0);
+    }, &ai_total);
+    double loop_total = us_since(loop_start);
+    row.ai_us = ai_total / turns;
+    row.paths_us /= turns;
+    row.render_us /= turns;
+    row.sched_us = (loop_total - ai_total) / turns - row.paths_us - row.render_us;
+    return row;
+}
+
+int main(int argc, char* argv[]) {
+    int turns = 20;
+    int max_mon = 100000;
+    std::string backend = "headless";
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--turns") == 0 && i + 1 < argc)
+            turns = std::atoi(argv[++i]);
+        else if (strcmp(argv[i], "--max") == 0 && i + 1 < argc)
+            max_mon = std::atoi(argv[++i]);
+        else if (strcmp(argv[i], "--renderer") == 0 && i + 1 < argc)
+            backend = argv[++i];
+    }
+    rng_seed(327);
+
+    monster_templates = {
+        make_template('p', "SMART", "BLUE"),
+        make_template('T', "TUNNEL", "RED"),
+        make_template('r', "ERRATIC", "YELLOW"),
+        make_template('d', "SMART", "GREEN"),
+    };
+
+    // Render off-screen: headless into memory, the terminal backends into
+    // /dev/null sized to the whole map.
+    FILE* devnull = fopen("/dev/null", "w");
+    if (backend == "headless") {
+        set_renderer(make_renderer("headless"));
+    } else if (backend == "ncurses") {
+        setenv("TERM", "xterm-256color", 0);
+        setenv("LINES", std::to_string(HEIGHT + 3).c_str(), 1);
+        setenv("COLUMNS", std::to_string(WIDTH).c_str(), 1);
+        set_renderer(std::unique_ptr<Renderer>(new NcursesRenderer(devnull)));
+    } else if (backend == "ansi") {
+        set_renderer(std::unique_ptr<Renderer>(new AnsiRenderer(fileno(devnull), -1)));
+    } else {
+        std::fprintf(stderr, "unknown renderer '%s' (headless, ncurses, ansi)\n", backend.c_str());
+        return 1;
+    }
+    init_screen();
+
+    std::vector<bench_row_t> rows;
+    for (int n = 10; n <= max_mon; n *= 10)
+        rows.push_back(run_sweep_point(n, turns));
+
+    end_screen();
+    set_renderer(nullptr);
+    fclose(devnull);
+
+    std::printf("map %dx%d, %d PC turns per point, %u threads, %s renderer\n", WIDTH, HEIGHT, turns,
+                std::thread::hardware_concurrency(), backend.c_str());
+    std::printf("%10s %12s %12s %12s %12s\n", "monsters", "ai us/turn", "sched us", "paths us", "render us");
+    for (const auto &r : rows)
+        std::printf("%10d %12.1f %12.1f %12.1f %12.1f\n", r.monsters, r.ai_us, r.sched_us, r.paths_us, r.render_us);
+    return 0;
+}
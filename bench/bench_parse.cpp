@@ -0,0 +1,119 @@
+// Description files: writes monster and object description files with
+// many entries each and times parse_monsters() and parse_objects() on them.
+#include "monster_template.h"
+#include "object_template.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+using bench_clock = std::chrono::steady_clock;
+
+static double ms_since(bench_clock::time_point t0) {
+    return std::chrono::duration<double, std::milli>(bench_clock::now() - t0).count();
+}
+
+static const char* colors[] = {"RED", "GREEN", "BLUE", "CYAN", "YELLOW", "MAGENTA", "WHITE", "BLACK"};
+static const char* abilities[] = {"SMART", "TELE", "TUNNEL", "ERRATIC", "PASS", "PICKUP", "DESTROY", "UNIQ"};
+static const char* types[] = {"WEAPON", "OFFHAND", "RANGED", "ARMOR", "HELMET", "CLOAK", "GLOVES",
+                              "BOOTS", "RING", "AMULET", "LIGHT", "SCROLL", "BOOK", "FLASK"};
+
+static void dice(FILE* f, const char* key, int i) {
+    std::fprintf(f, "%s %d+%dd%d\n", key, i % 20, i % 4, 2 + i % 10);
+}
+
+// Entries differ in field order, colors and description length, the way
+// hand-written files do.
+static long write_monsters(const char* path, int n) {
+    FILE* f = std::fopen(path, "w");
+    if (!f)
+        return -1;
+    std::fprintf(f, "RLG327 MONSTER DESCRIPTION 1\n");
+    for (int i = 0; i < n; i++) {
+        std::fprintf(f, "\nBEGIN MONSTER\nNAME Monster number %d\n", i);
+        if (i % 2)
+            std::fprintf(f, "SYMB %c\n", 'a' + i % 26);
+        std::fprintf(f, "COLOR %s", colors[i % 8]);
+        for (int c = 1; c <= i % 3; c++)
+            std::fprintf(f, " %s", colors[(i + c) % 8]);
+        std::fprintf(f, "\nDESC\n");
+        for (int l = 0; l <= i % 5; l++)
+            std::fprintf(f, "Line %d of what there is to say about monster %d, which is not much.\n", l, i);
+        std::fprintf(f, ".\n");
+        if (i % 2 == 0)
+            std::fprintf(f, "SYMB %c\n", 'a' + i % 26);
+        dice(f, "SPEED", i + 5);
+        dice(f, "DAM", i);
+        dice(f, "HP", i + 3);
+        std::fprintf(f, "ABIL %s %s\nRRTY %d\nEND\n", abilities[i % 8], abilities[(i + 3) % 8],
+                     1 + i % 100);
+    }
+    long bytes = std::ftell(f);
+    std::fclose(f);
+    return bytes;
+}
+
+static long write_objects(const char* path, int n) {
+    FILE* f = std::fopen(path, "w");
+    if (!f)
+        return -1;
+    std::fprintf(f, "RLG327 OBJECT DESCRIPTION 1\n");
+    for (int i = 0; i < n; i++) {
+        std::fprintf(f, "\nBEGIN OBJECT\nNAME Object number %d\nTYPE %s\nSYMB %c\nCOLOR %s\n", i,
+                     types[i % 14], '!' + i % 30, colors[i % 8]);
+        dice(f, "WEIGHT", i);
+        dice(f, "HIT", i + 1);
+        dice(f, "DAM", i + 2);
+        dice(f, "ATTR", i + 3);
+        dice(f, "VAL", i + 4);
+        dice(f, "DODGE", i + 5);
+        dice(f, "DEF", i + 6);
+        dice(f, "SPEED", i + 7);
+        std::fprintf(f, "DESC\n");
+        for (int l = 0; l <= i % 4; l++)
+            std::fprintf(f, "Line %d about object %d.\n", l, i);
+        std::fprintf(f, ".\nRRTY %d\nART %s\nEND\n", 1 + i % 100, i % 50 ? "FALSE" : "TRUE");
+    }
+    long bytes = std::ftell(f);
+    std::fclose(f);
+    return bytes;
+}
+
+int main(int argc, char* argv[]) {
+    int entries = 50000, rounds = 5;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--entries") == 0 && i + 1 < argc)
+            entries = std::atoi(argv[++i]);
+        else if (strcmp(argv[i], "--rounds") == 0 && i + 1 < argc)
+            rounds = std::atoi(argv[++i]);
+    }
+    const char* mpath = "/tmp/bench_parse_monsters.txt";
+    const char* opath = "/tmp/bench_parse_objects.txt";
+    long mbytes = write_monsters(mpath, entries), obytes = write_objects(opath, entries);
+    if (mbytes < 0 || obytes < 0) {
+        std::perror("/tmp");
+        return 1;
+    }
+
+    // Best of a few rounds; the files stay in the page cache throughout.
+    double mbest = 1e30, obest = 1e30;
+    size_t mcount = 0, ocount = 0;
+    for (int r = 0; r < rounds; r++) {
+        auto t0 = bench_clock::now();
+        mcount = parse_monsters(mpath).size();
+        mbest = std::min(mbest, ms_since(t0));
+        t0 = bench_clock::now();
+        ocount = parse_objects(opath).size();
+        obest = std::min(obest, ms_since(t0));
+    }
+    std::remove(mpath);
+    std::remove(opath);
+
+    std::printf("monsters: %zu of %d entries, %.1f MB, %.1f ms (%.0f MB/s)\n", mcount, entries,
+                mbytes / 1e6, mbest, mbytes / 1e3 / mbest);
+    std::printf("objects:  %zu of %d entries, %.1f MB, %.1f ms (%.0f MB/s)\n", ocount, entries,
+                obytes / 1e6, obest, obytes / 1e3 / obest);
+    return mcount == size_t(entries) && ocount == size_t(entries) ? 0 : 1;
+}
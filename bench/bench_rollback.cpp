@@ -0,0 +1,147 @@
+// Rollback: lookahead on a generated level with tunnelling and wandering
+// monsters. Every turn takes a mark, plays several short futures from it
+// (each opening with a different PC step) and goes back after each one,
+// then plays the real turn. Reports what marks and rollbacks cost next to
+// copying the world outright, and checks each rollback against such a copy.
+#include "global.h"
+#include "character.h"
+#include "occupancy.h"
+#include "fov.h"
+#include "ui.h"
+#include "renderer.h"
+#include "rng.h"
+#include "rollback.h"
+#include "zobrist.h"
+#include "bench_common.h"
+
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// The world copied the plain way, which is what a mark replaces.
+struct world_copy_t {
+    std::array<std::array<int, WIDTH>, HEIGHT> hardness, char_map, object_map;
+    std::array<std::array<char, WIDTH>, HEIGHT> dungeon, base_map;
+    cell_bits_t explored;
+    std::vector<character_t> characters;
+    std::vector<ObjectInstance> objects;
+    uint64_t hash;
+};
+
+static void copy_world(world_copy_t &w) {
+    w.hardness = hardness;
+    w.char_map = char_map;
+    w.object_map = object_map;
+    w.dungeon = dungeon;
+    w.base_map = base_map;
+    w.explored = pc_explored;
+    w.characters = characters;
+    w.objects = object_instances;
+    w.hash = zobrist_hash();
+}
+
+static bool same_world(const world_copy_t &w) {
+    if (w.hardness != hardness || w.char_map != char_map || w.object_map != object_map ||
+        w.dungeon != dungeon || w.base_map != base_map || w.explored != pc_explored ||
+        w.characters.size() != characters.size() || w.objects.size() != object_instances.size())
+        return false;
+    for (size_t i = 0; i < characters.size(); i++) {
+        const character_t &a = w.characters[i], &b = characters[i];
+        if (a.alive != b.alive || a.x != b.x || a.y != b.y || a.hp != b.hp || a.turn != b.turn ||
+            a.next_time != b.next_time || a.mana != b.mana || a.pc_seen_x != b.pc_seen_x ||
+            a.pc_seen_y != b.pc_seen_y)
+            return false;
+        for (int s = 0; s < character_t::MAX_CARRY; s++)
+            if (a.inventory[s].has_value() != b.inventory[s].has_value())
+                return false;
+    }
+    for (size_t i = 0; i < object_instances.size(); i++)
+        if (w.objects[i].x != object_instances[i].x || w.objects[i].y != object_instances[i].y ||
+            w.objects[i].name != object_instances[i].name)
+            return false;
+    return w.hash == zobrist_hash() && w.hash == zobrist_full();
+}
+
+static const int step_dx[8] = {-1, 0, 1, -1, 1, -1, 0, 1};
+static const int step_dy[8] = {-1, -1, -1, 0, 0, 1, 1, 1};
+
+// Play from the characters' next_time until the PC has had pc_turns turns;
+// its first step is toward dir, the rest are random.
+static void play(int pc_turns, int dir) {
+    play_turns(pc_turns, [&dir](character_t &pc) {
+        int d = dir >= 0 ? dir : rng_below(RngStream::Combat, 8);
+        dir = -1;
+        int nx = pc.x + step_dx[d], ny = pc.y + step_dy[d];
+        if (hardness[ny][nx] == 0 && !monster_at(nx, ny))
+            move_character(pc, nx, ny);
+        try_pickup_item(pc);
+        update_fog_map();
+        pc.turn++;
+    });
+}
+
+int main(int argc, char* argv[]) {
+    int turns = 200, monsters = 200, branches = 8, depth = 4;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--turns") == 0 && i + 1 < argc)
+            turns = std::atoi(argv[++i]);
+        else if (strcmp(argv[i], "--nummon") == 0 && i + 1 < argc)
+            monsters = std::atoi(argv[++i]);
+        else if (strcmp(argv[i], "--branches") == 0 && i + 1 < argc)
+            branches = std::atoi(argv[++i]);
+        else if (strcmp(argv[i], "--depth") == 0 && i + 1 < argc)
+            depth = std::atoi(argv[++i]);
+    }
+    rng_seed(327);
+    use_bench_monsters();
+    use_bench_objects();
+
+    // Messages go to the in-memory renderer.
+    set_renderer(make_renderer("headless"));
+    init_screen();
+    new_level(monsters);
+    characters[0].hp = INT_MAX / 2;  // the PC only has to survive
+    zobrist_rehash();
+    rollback_mark();  // the one full capture, kept off the averages
+    rollback_stats_t first = rollback_stats();
+
+    // Held across turns so the copy is timed into reused storage.
+    static world_copy_t before;
+    int played = 0, rollbacks = 0, mismatches = 0;
+    double mark_us = 0, back_us = 0, copy_us = 0;
+    for (; played < turns && monsters_alive > 0; played++) {
+        auto t0 = bench_clock::now();
+        world_mark_t mark = rollback_mark();
+        mark_us += us_since(t0);
+        t0 = bench_clock::now();
+        copy_world(before);
+        copy_us += us_since(t0);
+
+        for (int b = 0; b < branches; b++) {
+            play(depth, b % 8);
+            t0 = bench_clock::now();
+            bool ok = rollback_to(mark);
+            back_us += us_since(t0);
+            rollbacks++;
+            if ((!ok || !same_world(before)) && mismatches++ == 0)
+                std::fprintf(stderr, "rollback differs at turn %d, branch %d\n", played, b);
+        }
+        play(1, -1);
+    }
+    end_screen();
+    set_renderer(nullptr);
+
+    rollback_stats_t s = rollback_stats();
+    long marks = s.marks - first.marks;
+    std::printf("map %dx%d, %d monsters, %d turns of %d branches %d PC turns deep, %d mismatches\n",
+                WIDTH, HEIGHT, monsters, played, branches, depth, mismatches);
+    std::printf("mark %.1f us (%.1f tiles of %zu bytes, %.1f characters copied), rollback %.1f us "
+                "(%.1f tiles, %.1f characters put back)\n",
+                mark_us / played, double(s.tiles_copied - first.tiles_copied) / marks,
+                s.tile_bytes, double(s.characters_copied - first.characters_copied) / marks,
+                back_us / rollbacks, double(s.tiles_restored) / rollbacks,
+                double(s.characters_restored) / rollbacks);
+    std::printf("copying the world instead: %.1f us\n", copy_us / played);
+    return mismatches ? 1 : 0;
+}
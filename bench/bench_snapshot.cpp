@@ -0,0 +1,64 @@
+// Session snapshots: time to build, write, read back and apply a version 1
+// save of a populated level with carried and floor objects.
+#include "global.h"
+#include "character.h"
+#include "snapshot.h"
+#include "fileio.h"
+#include "rng.h"
+#include "bench_common.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+int main(int argc, char* argv[]) {
+    int monsters = 1000, rounds = 200;
+    const char* path = "/tmp/bench_snapshot.rlg327";
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--nummon") == 0 && i + 1 < argc)
+            monsters = std::atoi(argv[++i]);
+        else if (strcmp(argv[i], "--rounds") == 0 && i + 1 < argc)
+            rounds = std::atoi(argv[++i]);
+        else if (strcmp(argv[i], "--path") == 0 && i + 1 < argc)
+            path = argv[++i];
+    }
+    rng_seed(327);
+
+    use_bench_rats();
+    use_bench_objects();
+
+    new_level(monsters);
+    for (int s = 0; s < character_t::MAX_CARRY && s < static_cast<int>(object_instances.size()); s++)
+        characters[0].inventory[s] = object_instances[s];
+
+    std::vector<uint8_t> buf;
+    double build_us = 0, write_us = 0, read_us = 0, apply_us = 0;
+    for (int r = 0; r < rounds; r++) {
+        auto t0 = bench_clock::now();
+        snapshot_build(buf);
+        build_us += us_since(t0);
+
+        t0 = bench_clock::now();
+        if (!write_file(path, buf)) {
+            std::perror(path);
+            return 1;
+        }
+        write_us += us_since(t0);
+
+        t0 = bench_clock::now();
+        read_file(path, buf);
+        read_us += us_since(t0);
+
+        t0 = bench_clock::now();
+        if (load_game_from(buf, path) != LoadKind::Session)
+            return 1;
+        apply_us += us_since(t0);
+    }
+    std::remove(path);
+
+    std::printf("map %dx%d, %zu characters, %zu floor objects, %zu bytes\n", WIDTH, HEIGHT,
+                characters.size(), object_instances.size(), buf.size());
+    std::printf("build %.1f us, write %.1f us, read %.1f us, apply %.1f us (mean of %d)\n",
+                build_us / rounds, write_us / rounds, read_us / rounds, apply_us / rounds, rounds);
+    return 0;
+}
@@ -0,0 +1,143 @@
+// Terminal output cost: frame build/flush time, bytes and write syscalls
+// per frame for each terminal backend, drawing into a local pty so runs
+// are reproducible without a real terminal. The PC takes a fixed random
+// walk with fog on, then again with fog off (whole-map frames).
+#include "global.h"
+#include "dungeon.h"
+#include "character.h"
+#include "occupancy.h"
+#include "ui.h"
+#include "renderer.h"
+#include "rng.h"
+#include "bench_common.h"
+#include "metrics.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <thread>
+#include <unistd.h>
+
+// Master side of the pty: drains and counts everything the backend sends.
+struct pty_t {
+    int master = -1, slave = -1;
+    std::atomic<long> bytes{0};
+    std::atomic<bool> stop{false};
+    std::thread drain;
+};
+
+static bool open_pty(pty_t &p, int rows, int cols) {
+    p.master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (p.master < 0 || grantpt(p.master) != 0 || unlockpt(p.master) != 0)
+        return false;
+    p.slave = open(ptsname(p.master), O_RDWR | O_NOCTTY);
+    if (p.slave < 0)
+        return false;
+    struct winsize ws = {};
+    ws.ws_row = static_cast<unsigned short>(rows);
+    ws.ws_col = static_cast<unsigned short>(cols);
+    ioctl(p.slave, TIOCSWINSZ, &ws);
+
+    p.drain = std::thread([&p]() {
+        char buf[65536];
+        for (;;) {
+            struct pollfd pfd = {p.master, POLLIN, 0};
+            int r = poll(&pfd, 1, 10);
+            if (r > 0) {
+                ssize_t n = read(p.master, buf, sizeof(buf));
+                if (n <= 0)
+                    break;
+                p.bytes += n;
+            } else if (p.stop) {
+                break;
+            }
+        }
+    });
+    return true;
+}
+
+static void close_pty(pty_t &p) {
+    p.stop = true;
+    if (p.drain.joinable())
+        p.drain.join();
+    if (p.slave >= 0)
+        close(p.slave);
+    if (p.master >= 0)
+        close(p.master);
+}
+
+static void walk(int frames) {
+    character_t &pc = characters[0];
+    static const int dirs[8][2] = {{-1,-1},{0,-1},{1,-1},{1,0},{1,1},{0,1},{-1,1},{-1,0}};
+    for (int f = 0; f < frames; f++) {
+        const int* d = dirs[rand() % 8];
+        int nx = pc.x + d[0], ny = pc.y + d[1];
+        if (nx > 0 && nx < WIDTH - 1 && ny > 0 && ny < HEIGHT - 1 &&
+            pc_can_walk_on(dungeon[ny][nx]) && !monster_at(nx, ny))
+            move_character(pc, nx, ny);
+        display_dungeon();
+        if (f % 10 == 0)
+            display_message("Turn " + std::to_string(f) + ": nothing happens.");
+    }
+}
+
+static bool run_backend(const std::string &name, int frames, unsigned seed) {
+    pty_t p;
+    int rows = HEIGHT + 3, cols = WIDTH;
+    if (!open_pty(p, rows, cols)) {
+        std::fprintf(stderr, "could not open a pty\n");
+        close_pty(p);
+        return false;
+    }
+    FILE* out = fdopen(dup(p.slave), "w");
+    if (name == "ncurses") {
+        setenv("LINES", std::to_string(rows).c_str(), 1);
+        setenv("COLUMNS", std::to_string(cols).c_str(), 1);
+        set_renderer(std::unique_ptr<Renderer>(new NcursesRenderer(out)));
+    } else {
+        set_renderer(std::unique_ptr<Renderer>(new AnsiRenderer(p.slave, -1)));
+    }
+
+    srand(seed);
+    rng_seed(seed);
+    new_level(10);
+    init_screen();
+    metrics_reset();
+    fog_toggle = false;
+    walk(frames / 2);
+    fog_toggle = true;
+    walk(frames - frames / 2);
+    std::vector<std::string> report = metrics_report();
+    end_screen();
+    set_renderer(nullptr);
+    fclose(out);
+    close_pty(p);
+
+    std::printf("%s: %ld bytes seen on the pty\n", name.c_str(), p.bytes.load());
+    for (const std::string &line : report)
+        std::printf("  %s\n", line.c_str());
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    int frames = 400;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+            frames = std::atoi(argv[++i]);
+    }
+    setenv("TERM", "xterm-256color", 0);
+
+    use_bench_rats();
+
+    std::printf("map %dx%d, %d frames per backend (half fog on, half off)\n", WIDTH, HEIGHT, frames);
+    std::fflush(stdout);
+    bool ok = true;
+    for (const char* name : {"ncurses", "ansi"})
+        ok = run_backend(name, frames, 327) && ok;
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,79 @@
+// State hash: plays a generated level with tunnelling and wandering
+// monsters while the PC walks about picking things up and dropping them,
+// and checks after every turn that the incrementally kept hash matches
+// one computed from scratch. Reports what reading each costs.
+#include "global.h"
+#include "character.h"
+#include "occupancy.h"
+#include "ui.h"
+#include "renderer.h"
+#include "rng.h"
+#include "zobrist.h"
+#include "bench_common.h"
+
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// A step to a random walkable neighbour, then a pickup, or now and then a
+// drop of something carried.
+static void pc_turn(character_t &pc) {
+    int dx = rng_below(RngStream::Combat, 3) - 1, dy = rng_below(RngStream::Combat, 3) - 1;
+    int nx = pc.x + dx, ny = pc.y + dy;
+    if (hardness[ny][nx] == 0 && !monster_at(nx, ny) && (dx || dy))
+        move_character(pc, nx, ny);
+    try_pickup_item(pc);
+    int slot = rng_below(RngStream::Combat, 4 * character_t::MAX_CARRY);
+    if (slot < character_t::MAX_CARRY && pc.inventory[slot]) {
+        ObjectInstance item = *pc.inventory[slot];
+        item.x = pc.x;
+        item.y = pc.y;
+        place_object(item);
+        pc.inventory[slot].reset();
+    }
+}
+
+int main(int argc, char* argv[]) {
+    int turns = 2000, monsters = 200;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--turns") == 0 && i + 1 < argc)
+            turns = std::atoi(argv[++i]);
+        else if (strcmp(argv[i], "--nummon") == 0 && i + 1 < argc)
+            monsters = std::atoi(argv[++i]);
+    }
+    rng_seed(327);
+    use_bench_monsters();
+    use_bench_objects();
+
+    // Messages go to the in-memory renderer.
+    set_renderer(make_renderer("headless"));
+    init_screen();
+    new_level(monsters);
+    characters[0].hp = INT_MAX / 2;  // the PC only has to survive
+    zobrist_rehash();
+
+    int pc_turns = 0, mismatches = 0;
+    double hash_us = 0, full_us = 0;
+    play_turns(turns, [&](character_t &pc) {
+        pc_turn(pc);
+        pc_turns++;
+
+        auto t0 = bench_clock::now();
+        uint64_t kept = zobrist_hash();
+        hash_us += us_since(t0);
+        t0 = bench_clock::now();
+        uint64_t full = zobrist_full();
+        full_us += us_since(t0);
+        if (kept != full && mismatches++ == 0)
+            std::fprintf(stderr, "hash drifted at PC turn %d\n", pc_turns);
+    });
+    end_screen();
+    set_renderer(nullptr);
+
+    std::printf("map %dx%d, %d monsters, %d PC turns, %d mismatches\n", WIDTH, HEIGHT, monsters,
+                pc_turns, mismatches);
+    std::printf("kept hash %.2f us, from scratch %.1f us (mean per PC turn)\n", hash_us / pc_turns,
+                full_us / pc_turns);
+    return mismatches ? 1 : 0;
+}
@@ -0,0 +1,29 @@
+#ifndef ANIMATION_H
+#define ANIMATION_H
+
+#include <utility>
+#include <vector>
+
+// Effect timeline for projectiles and blasts. Handlers queue frames of
+// overlay cells, then anim_play() shows them over the current map frame
+// through the normal render path. Any key skips the rest of the timeline
+// and stays queued as the next command.
+
+// Frames are never shown faster than this.
+constexpr int ANIM_MAX_FPS = 60;
+
+// Start a new frame held for hold_ms (at least one frame interval).
+void anim_frame(int hold_ms);
+
+// Add overlay cells to the frame being built.
+void anim_cell(int x, int y, char glyph, int pair);
+void anim_cells(const std::vector<std::pair<int, int>> &cells, char glyph, int pair);
+
+// Show the queued frames, then restore the map. The queue is emptied.
+void anim_play();
+
+// With animation off (headless runs, --no-anim) anim_play() just drops
+// the queue.
+void anim_set_enabled(bool enabled);
+
+#endif // ANIMATION_H
@@ -0,0 +1,37 @@
+#ifndef AOE_H
+#define AOE_H
+
+#include <string>
+#include <utility>
+#include <vector>
+#include "global.h"
+
+enum class AoeShape { Disc, Square };
+
+struct aoe_area_t {
+    AoeShape shape;
+    int radius;
+    bool stop_at_walls;  // only cells with a clear line from the centre
+};
+
+struct aoe_hits_t {
+    std::vector<std::pair<int, int>> cells;  // affected cells, for drawing
+    std::vector<int> ids;                    // monsters caught, ascending id
+};
+
+// Cells covered by the area and the monsters standing on them, gathered in
+// one pass over the shape's stencil via the occupancy index.
+aoe_hits_t aoe_query(int cx, int cy, const aoe_area_t &area);
+
+struct aoe_result_t {
+    int hit;
+    int killed;
+};
+
+// Deal base + a random 0..spread-1 damage to every monster in hits.ids (in id
+// order), then remove the dead in a single sweep and post one summary
+// message naming the spell.
+aoe_result_t aoe_apply_damage(const aoe_hits_t &hits, int base, int spread,
+                              const std::string &spell);
+
+#endif // AOE_H
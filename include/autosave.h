@@ -0,0 +1,24 @@
+#ifndef AUTOSAVE_H
+#define AUTOSAVE_H
+
+#include <string>
+
+// Background autosave. The game thread captures a snapshot into one of
+// two buffers and swaps it to a writer thread, which checksums it and
+// writes it with write_file_atomic(). The game thread only ever waits for
+// that swap. If the writer falls behind, a newer snapshot replaces the
+// one still waiting. Capture time, save latency and queue depth go to
+// the metrics.
+
+// Save to path every every_turns PC turns (and on autosave_now()).
+void autosave_start(const std::string &path, int every_turns);
+// Finish any save in flight and stop the writer.
+void autosave_stop();
+bool autosave_enabled();
+
+// Call once per PC turn; saves when the turn count comes round.
+void autosave_turn(int pc_turn);
+// Save at the next chance regardless of the turn count (stairs).
+void autosave_now();
+
+#endif // AUTOSAVE_H
@@ -0,0 +1,31 @@
+#ifndef BITGRID_H
+#define BITGRID_H
+
+#include <array>
+#include <cstdint>
+#include "global.h"
+
+// One bit per map cell, packed 64 cells to a word, one row of words per
+// map row, so whole-row operations are word-wide.
+constexpr int ROW_WORDS = (WIDTH + 63) / 64;
+using row_bits_t = std::array<uint64_t, ROW_WORDS>;
+using cell_bits_t = std::array<row_bits_t, HEIGHT>;
+
+inline bool bit_test(const cell_bits_t &g, int x, int y) {
+    return (g[y][x >> 6] >> (x & 63)) & 1;
+}
+
+inline void bit_set(cell_bits_t &g, int x, int y) {
+    g[y][x >> 6] |= uint64_t(1) << (x & 63);
+}
+
+inline void bit_clear(cell_bits_t &g, int x, int y) {
+    g[y][x >> 6] &= ~(uint64_t(1) << (x & 63));
+}
+
+inline void bits_clear_all(cell_bits_t &g) {
+    for (auto &row : g)
+        row.fill(0);
+}
+
+#endif // BITGRID_H
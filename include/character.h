@@ -37,6 +37,17 @@ struct character_t {
   std::vector<std::string> color;
   int mana; 
   int max_mana;
+
+  // Where this monster last saw the PC, or -1 if it never has.
+  int pc_seen_x, pc_seen_y;
+
+  // Game time of this character's next turn in the event queue.
+  int next_time;
+};
+
+// A monster's chosen destination from the decide phase.
+struct monster_move_t {
+  int x, y;
 };
 
 struct event_t {
@@ -48,12 +59,23 @@ struct event_t {
 void create_pc();
 void create_monster();
 void do_monster_movement(character_t &m);
+void perceive_pc(character_t &m);
+bool monster_has_shot(const character_t &m);
+int roll_monster_move(const character_t &m);
+monster_move_t decide_monster_move(const character_t &m, int roll);
+void apply_monster_move(character_t &m, const monster_move_t &mv);
+void do_monster_turns(std::vector<character_t*> &batch);
 // character.h
 void try_pickup_item(character_t &pc);
 void new_level(int nummon);
+// Take the stairs delta levels down (negative: up). The level left is
+// kept (level_cache.h), and one visited before comes back as it was left;
+// otherwise a new one is generated with nummon monsters.
+void change_level(int delta, int nummon);
 int calculate_total_damage(const character_t &attacker);
 void perform_attack(character_t &attacker, character_t &defender);
 extern std::vector<character_t> characters;
 extern bool pc_is_alive;
+extern int monsters_alive;
 
 #endif // CHARACTER_H
@@ -0,0 +1,39 @@
+#ifndef COMMANDS_H
+#define COMMANDS_H
+
+#include <string>
+
+// Player commands. A key maps to an action through the keymap, and the
+// action indexes the handler table in ui.cpp, so dispatch is two array
+// lookups however many commands there are.
+enum class Action {
+    None,
+    MoveNW, MoveN, MoveNE, MoveE, MoveSE, MoveS, MoveSW, MoveW,
+    Rest,
+    StairsDown, StairsUp,
+    Teleport, Travel, Explore,
+    Inventory, Equipment, Inspect, Wear, TakeOff, Drop, Expunge,
+    ToggleFog, Look, MonsterList, MessageLog, Metrics,
+    Ranged, PoisonBall, Fireball,
+    Quit,
+    COUNT
+};
+
+constexpr int ACTION_COUNT = static_cast<int>(Action::COUNT);
+
+// Keys are plain characters or the renderer's SCREEN_KEY_* codes.
+constexpr int KEYMAP_SIZE = 512;
+
+Action action_for_key(int key);
+void bind_key(int key, Action a);
+
+// Name used in keymap files ("move_nw", "rest", ...).
+const char* action_name(Action a);
+
+// Default bindings, then overrides from a keymap file if it exists. Each
+// line is "<key> <action>"; keys are a character, ^X for control keys, or
+// one of space, esc, up, down, pgup, pgdn. '#' starts a comment. Bad lines
+// are reported on stderr and skipped.
+void keymap_init(const std::string &path);
+
+#endif // COMMANDS_H
@@ -0,0 +1,14 @@
+#ifndef COMPOSITOR_H
+#define COMPOSITOR_H
+
+// Builds render_next from separate layers:
+//   terrain   base_map, what is really there
+//   visible   byte mask from pc_visible (all set with fog off)
+//   explored  byte mask from pc_explored; remembered cells show terrain
+//   objects   glyph/colour overlay, 0 where empty
+//   monsters  glyph/colour overlay including the PC, 0 where empty
+// Each row is merged with byte-wise masked selects, 16 cells at a time
+// where SSE2 is available.
+void compose_frame();
+
+#endif // COMPOSITOR_H
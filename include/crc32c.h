@@ -0,0 +1,11 @@
+#ifndef CRC32C_H
+#define CRC32C_H
+
+#include <cstddef>
+#include <cstdint>
+
+// CRC-32C (Castagnoli), as used by iSCSI and ext4. Pass the previous
+// result as crc to checksum data in pieces; start from 0.
+uint32_t crc32c(const void* data, size_t len, uint32_t crc = 0);
+
+#endif // CRC32C_H
@@ -0,0 +1,63 @@
+#ifndef DESC_READER_H
+#define DESC_READER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Reads a description file (monster_desc.txt, object_desc.txt) a line at a
+// time. The file is mapped read-only and lines are views into the mapping,
+// so reading allocates nothing; they stay valid until the reader goes away.
+class DescReader {
+public:
+    explicit DescReader(const std::string& path);
+    ~DescReader();
+    DescReader(const DescReader&) = delete;
+    DescReader& operator=(const DescReader&) = delete;
+
+    bool is_open() const { return opened; }
+    // The next line without its newline (or a trailing \r); false at the
+    // end of the file.
+    bool next_line(std::string_view& line);
+    // 1-based number of the line next_line() returned last.
+    int line_number() const { return line_no; }
+    // "path:line: what" on std::cerr, for line (or the current line).
+    void error(const std::string& what, int line = 0) const;
+
+private:
+    std::string path;
+    const char* data = nullptr;
+    size_t size = 0;
+    size_t pos = 0;
+    int line_no = 0;
+    bool opened = false;
+};
+
+// Split off the next whitespace-separated word of rest; empty when none.
+std::string_view desc_word(std::string_view& rest);
+// rest with leading whitespace removed.
+std::string_view desc_trim(std::string_view rest);
+// Take a decimal integer, optionally negative, off the front of s; false
+// if s does not start with one or it does not fit in an int.
+bool desc_number(std::string_view& s, int& out);
+
+// The keywords either file uses, one bit each in a seen-fields mask.
+enum DescKey {
+    KEY_NAME, KEY_DESC, KEY_SYMB, KEY_COLOR, KEY_SPEED, KEY_DAM, KEY_RRTY,
+    KEY_ABIL, KEY_HP,                                         // monsters
+    KEY_TYPE, KEY_HIT, KEY_DODGE, KEY_DEF, KEY_WEIGHT, KEY_ATTR, KEY_VAL,
+    KEY_ART,                                                  // objects
+    KEY_UNKNOWN
+};
+DescKey desc_key(std::string_view word);
+const char* desc_key_name(DescKey key);
+// "missing NAME SYMB": the fields of want (a mask of 1 << DescKey) that
+// seen lacks.
+std::string desc_missing(uint32_t want, uint32_t seen);
+
+// Append the lines up to one holding just "." to text, each with its
+// newline (the DESC field).
+void desc_read_text(DescReader& in, std::string& text);
+
+#endif // DESC_READER_H
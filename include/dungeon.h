@@ -2,6 +2,7 @@
 #define DUNGEON_H
 
 #include "global.h"
+#include <cstdint>
 
 // Dungeon generation functions
 void initializeDungeon();
@@ -10,9 +11,17 @@ void connectRoomsViaCorridor();
 void placeStairs();
 void placePC(int x, int y);
 
-// File I/O functions
-void load_dungeon(const char* path);
-void save_dungeon(const char* path);
+// Turn a dug-out rock cell into corridor and tell terrain caches about it.
+void carve_corridor(int x, int y);
+
+// File I/O functions. Both report problems on stderr and return false;
+// a failed load leaves the current level untouched.
+bool load_dungeon(const char* path);
+bool load_dungeon_from(const std::vector<uint8_t> &buf, const char* path);
+bool save_dungeon(const char* path);
+
+// Redraw the dungeon array from hardness, rooms and stairs.
+void rebuild_level_map();
 
 // Helper functions for directory/path creation
 void checkDir();
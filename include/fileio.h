@@ -0,0 +1,18 @@
+#ifndef FILEIO_H
+#define FILEIO_H
+
+#include <cstdint>
+#include <vector>
+
+// Whole-file I/O with one read()/write() call (retried only on short
+// transfers and EINTR). Both return false with errno set on failure.
+bool read_file(const char* path, std::vector<uint8_t> &buf);
+bool write_file(const char* path, const std::vector<uint8_t> &buf);
+// All of buf to an open descriptor.
+bool write_all(int fd, const std::vector<uint8_t> &buf);
+
+// Write to "<path>.tmp", fsync it, rename it over path and fsync the
+// directory, so path always holds either the old or the new contents.
+bool write_file_atomic(const char* path, const std::vector<uint8_t> &buf);
+
+#endif // FILEIO_H
@@ -0,0 +1,32 @@
+#ifndef FOV_H
+#define FOV_H
+
+#include "global.h"
+#include "bitgrid.h"
+
+// Radius of the PC's light, in Chebyshev distance.
+constexpr int LIGHT_RADIUS = 3;
+
+// Cells the PC can currently see, from recursive shadowcasting. Rock
+// (hardness > 0) blocks light but is itself lit.
+extern cell_bits_t pc_visible;
+
+// Cells the PC has seen at some point on this level; kept up to date by
+// update_fog_map(). Remembered cells show their base_map terrain.
+extern cell_bits_t pc_explored;
+
+// Recompute pc_visible for (pc_x, pc_y). Octants whose origin is unchanged
+// and whose terrain was not touched since the last call are reused; a new
+// terrain_generation drops them all.
+void fov_update();
+
+// Raw line-of-sight test against pc_visible.
+bool fov_visible(int x, int y);
+
+// What the player gets to see: everything with fog off, else fov_visible.
+bool pc_can_see(int x, int y);
+
+// Note that the terrain at (x, y) changed (a wall was dug out).
+void fov_terrain_changed(int x, int y);
+
+#endif // FOV_H
@@ -16,8 +16,16 @@
 
 
 // --- Constants ---
-constexpr int WIDTH = 80;
-constexpr int HEIGHT = 21;
+// Map size can be overridden at build time (the benchmark uses a large map);
+// the RLG327 save format and the 80x24 UI assume the defaults.
+#ifndef RLG_WIDTH
+#define RLG_WIDTH 80
+#endif
+#ifndef RLG_HEIGHT
+#define RLG_HEIGHT 21
+#endif
+constexpr int WIDTH = RLG_WIDTH;
+constexpr int HEIGHT = RLG_HEIGHT;
 constexpr int MAX_ROOMS = 10;
 constexpr int DEFAULT_NUMMON = 10;
 
@@ -33,9 +41,11 @@ constexpr int FILE_VERSION = 0;
 extern std::array<std::array<char, WIDTH>, HEIGHT> dungeon;
 extern std::array<std::array<int, WIDTH>, HEIGHT> hardness;
 extern std::array<std::array<char, WIDTH>, HEIGHT> base_map;
+// Bumped whenever the whole level's terrain is replaced (new level, load),
+// so terrain-derived caches know to start over.
+extern unsigned terrain_generation;
 
-// Fog of war array.
-extern std::array<std::array<char, WIDTH>, HEIGHT> fog_map;
+// Fog of war: false hides what the PC has not seen (see fov.h).
 extern bool fog_toggle;
 
 // PC coordinates.
@@ -58,8 +68,18 @@ extern int down_xCoord, down_yCoord;
 extern std::array<std::array<int, WIDTH>, HEIGHT> disTunneling;
 extern std::array<std::array<int, WIDTH>, HEIGHT> disNonTunneling;
 
+// Occupancy index: characters[] index / object_instances[] index per cell,
+// or -1 when empty. Kept in step with the dungeon array, see occupancy.h.
+extern std::array<std::array<int, WIDTH>, HEIGHT> char_map;
+extern std::array<std::array<int, WIDTH>, HEIGHT> object_map;
+
+// How far below the starting level the PC is (negative above it).
+extern int dungeon_depth;
+
 // New flag: set to true when a new level has been generated.
 extern bool level_changed;
+// Set when the player asks to save and quit.
+extern bool game_quit;
 
 extern std::vector<MonsterTemplate> monster_templates;
 
@@ -0,0 +1,64 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include "character.h"
+#include <string>
+
+// Append-only turn journal. Every PC turn appends one record: the input
+// results the turn acted on, how far each random stream moved and the
+// state hash it ended on. Records are framed with a length and crc32c and
+// written in groups, on a writer thread, after a checkpoint (a version 1
+// snapshot). Replaying feeds the recorded input back through the
+// renderer's input tap, headless, with the recorded stream positions and
+// state hash (zobrist.h) checked as each turn completes.
+//
+// The records go to one of two places:
+//  - the crash journal: a checkpoint file and a journal file in a
+//    directory. Each checkpoint starts the journal again, and every group
+//    is fdatasync'd;
+//  - a recording: one file holding the whole session, with a snapshot
+//    every JOURNAL_CHECKPOINT_TURNS turns so a replay can start near any
+//    turn.
+
+// PC turns per group commit; a crash loses at most this many.
+constexpr int JOURNAL_GROUP_TURNS = 32;
+// PC turns between checkpoints (recording snapshots).
+constexpr int JOURNAL_CHECKPOINT_TURNS = 500;
+
+enum class JournalTarget { None, Crash, Recording };
+
+// The crash journal's checkpoint file in dir.
+std::string journal_checkpoint_path(const std::string &dir);
+
+// Load something to replay; call before the screen is up. false (with the
+// reason on stderr) leaves nothing changed.
+// The checkpoint in dir and the journal after it; play resumes after it.
+bool journal_recover(const std::string &dir);
+// The last snapshot in a recording at or before seek_turn, and the records
+// from there to seek_turn; play resumes after it. With seek_turn < 0 the
+// whole recording is loaded and the replay ends the game when done.
+bool journal_load_recording(const std::string &path, int seek_turn);
+
+// Start once the screen is up and the event queue is built: begin the
+// replay of whatever was loaded, and record live turns into where (a
+// directory for Crash, a file for Recording).
+void journal_start(JournalTarget target, const std::string &where);
+
+// Call after every PC turn, once the PC is rescheduled.
+void journal_end_turn(const character_t &pc);
+
+// Input is coming from the journal; nothing needs drawing.
+bool journal_replaying();
+// A replay with nothing to resume has played everything it can.
+bool journal_replay_finished();
+
+struct replay_stats_t {
+    int played = 0, total = 0;  // records
+    int diverged_at = -1;       // turn whose check failed, or -1
+};
+replay_stats_t journal_replay_stats();
+
+// Commit what is buffered and stop the writer.
+void journal_stop();
+
+#endif // JOURNAL_H
@@ -0,0 +1,94 @@
+#ifndef LEVEL_ARCHIVE_H
+#define LEVEL_ARCHIVE_H
+
+#include "global.h"
+#include "character.h"
+#include "bitgrid.h"
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Levels the PC has left, kept on disk so the stairs lead back to them.
+// One file per game, named after the game's id (see archive_set_prefix()):
+// a header with the id and an offset index by depth, then level records
+// appended one after another. A record packs
+// the terrain (hardness run-length encoded, rooms and stairs), explored
+// cells, monsters and floor objects, and carries a crc32c. Reads go
+// through a read-only mmap of the file, so bringing a level back costs
+// the same however many are stored, and none of them are held in memory
+// here (level_cache.h keeps the recent ones).
+//
+// Records are only ever appended; the index points at each depth's latest.
+// A snapshot notes the game and how far the archive reached, and loading
+// it carries on from a copy of the game's archive cut back to that point,
+// so crash recovery and replays find the levels exactly as they were. A
+// session only ever writes to a file of its own, so it cannot change the
+// levels a save refers to.
+
+// Depths -ARCHIVE_DEPTHS / 2 .. ARCHIVE_DEPTHS / 2 - 1 can be archived;
+// levels beyond are generated afresh each time.
+constexpr int ARCHIVE_DEPTHS = 1024;
+
+// Archives are the files prefix + the game id in hex + ".levels". Scratch
+// ones are unlinked as soon as they are opened, for sessions that keep
+// nothing. Without a prefix the game runs without an archive, as it does
+// when a file cannot be opened (the reason goes to stderr).
+void archive_set_prefix(const std::string &prefix, bool scratch = false);
+void archive_close();
+bool archive_is_open();
+// The open file's name, or "" without one.
+std::string archive_path();
+
+// Open a file for a new game under a fresh id.
+void archive_new_game();
+// A snapshot of game_id was loaded: copy what its file stored before mark
+// into the file of a fresh id, or start over if there is none. The loaded
+// game's own file is left as the save expects it.
+void archive_attach(uint64_t game_id, uint64_t mark);
+// The next archive_attach() takes its levels from a copy of the archive
+// at path (a recording's) instead, under a fresh id, so the session goes
+// on as a game of its own.
+void archive_import(const std::string &path);
+uint64_t archive_game_id();
+uint64_t archive_mark();
+
+// Delete the archives under the prefix of every game but those in keep
+// (the ones the saves on disk refer to). Call with the archive closed.
+void archive_prune(const std::vector<uint64_t> &keep);
+
+// A level the PC is not on: what the archive keeps of it. Only living
+// monsters are kept; the PC is not part of it.
+struct stored_level_t {
+    std::array<std::array<uint8_t, WIDTH>, HEIGHT> hardness;
+    int room_count;
+    std::array<int, MAX_ROOMS> room_x, room_y, room_w, room_h;
+    int up_count, down_count;
+    int up_x, up_y, down_x, down_y;
+    cell_bits_t explored;
+    int pc_x, pc_y;  // where the PC left it
+    std::vector<character_t> monsters;
+    std::vector<ObjectInstance> objects;
+};
+
+// Store level as depth (false with errno set on a write error), or read
+// depth back into level (false if it was never stored or its record is
+// damaged; level may then be partly filled).
+bool archive_store(int depth, const stored_level_t &level);
+bool archive_load(int depth, stored_level_t &level);
+
+// Put stored levels on disk before a snapshot referring to them is
+// written. The snapshot is written on another thread while the game goes
+// on storing, or opens a new file, so the game thread takes a descriptor
+// of the file as it is (-1 without an archive) and the writer passes it
+// to archive_sync(), which syncs and closes it.
+int archive_sync_fd();
+void archive_sync(int fd);
+
+struct archive_stats_t {
+    int levels;      // depths with a record
+    uint64_t bytes;  // file size
+};
+archive_stats_t archive_stats();
+
+#endif // LEVEL_ARCHIVE_H
@@ -0,0 +1,45 @@
+#ifndef LEVEL_CACHE_H
+#define LEVEL_CACHE_H
+
+#include "level_archive.h"
+#include <cstddef>
+
+// The levels the PC left most recently, kept in memory in front of the
+// level archive so taking the stairs back to one reads nothing from disk.
+// Levels are kept whole (terrain, explored cells, monsters, objects) up to
+// a memory budget; past it the least recently left are dropped. Each level
+// is written to the archive as it is left, so a snapshot, which refers to
+// the archive as it stands, covers every level without the game thread
+// writing anything when one is taken.
+
+constexpr int LEVEL_CACHE_DEFAULT_MB = 16;
+
+// 0 keeps nothing: every level left is written to the archive at once.
+void level_cache_set_budget(size_t bytes);
+
+// Move the current level out as depth. false (errno set) if it could not
+// be archived; the cache is still updated.
+bool level_cache_leave(int depth);
+// Make depth the current level, from memory or else from the archive.
+// false if neither has it; nothing is changed then.
+bool level_cache_enter(int depth);
+
+// Forget every level held, unwritten ones included (a game was loaded).
+void level_cache_clear();
+
+// The current level to and from a stored_level_t; apply() leaves level
+// emptied and sets level_changed.
+void level_capture(stored_level_t &level);
+void level_apply(stored_level_t &level);
+
+struct level_cache_stats_t {
+    long hits = 0;           // found in memory
+    long misses = 0;         // not in memory
+    long archive_loads = 0;  // misses the archive answered
+    long evictions = 0;
+    int levels = 0;          // held now
+    size_t bytes = 0;        // their estimated size
+};
+level_cache_stats_t level_cache_stats();
+
+#endif // LEVEL_CACHE_H
@@ -0,0 +1,55 @@
+#ifndef LOS_H
+#define LOS_H
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "global.h"
+#include "bitgrid.h"
+
+// Offsets inside this Chebyshev range come from the precomputed ray table;
+// the line helpers trace longer shots on the fly.
+constexpr int MAX_TARGET_RANGE = 32;
+// Largest blast radius with a precomputed disc stencil.
+constexpr int MAX_BLAST_RADIUS = 4;
+
+struct ray_step_t {
+    int8_t dx, dy;
+};
+
+// A sequence of offsets from the origin, excluding the origin itself.
+struct ray_t {
+    const ray_step_t* steps;
+    int len;
+};
+
+// Cells with hardness 0, i.e. open floor that projectiles can fly over.
+extern cell_bits_t walkable;
+
+// Build the ray and disc tables. Cheap to call more than once.
+void los_init();
+
+// Bresenham line from (0,0) to (dx,dy), ending on (dx,dy). Empty when the
+// offset is beyond MAX_TARGET_RANGE.
+ray_t los_ray(int dx, int dy);
+
+// Offsets (dx,dy) with dx*dx + dy*dy <= radius*radius, centre first.
+ray_t los_disc(int radius);
+
+// True when every cell strictly between the two points is walkable.
+bool los_clear(int x0, int y0, int x1, int y1);
+
+// Follow the line from (x0,y0) toward (x1,y1). Stops on the first monster,
+// the first non-walkable cell or the target itself; (hx,hy) is where it
+// stopped. Returns true when it stopped on a monster.
+bool los_trace(int x0, int y0, int x1, int y1, int &hx, int &hy);
+
+// Cells from (x0,y0) to (x1,y1) along the same line, origin excluded.
+std::vector<std::pair<int, int>> los_line(int x0, int y0, int x1, int y1);
+
+// Keep walkable in step with terrain. los_terrain_changed covers a single
+// dug cell; a new terrain_generation triggers a full rebuild on next use.
+void los_terrain_changed(int x, int y);
+void los_sync();
+
+#endif // LOS_H
@@ -0,0 +1,40 @@
+#ifndef MESSAGE_LOG_H
+#define MESSAGE_LOG_H
+
+#include <string>
+
+// Message history and the message line (screen row 0). Messages are only
+// queued when posted; everything posted since the last frame is drawn
+// together, once, when the frame is drawn or before waiting for a key.
+// A repeat of the newest message bumps its count instead of adding a line.
+
+constexpr int MESSAGE_LOG_SIZE = 256;  // entries kept for scrollback
+
+struct log_entry_t {
+    std::string text;
+    int count;
+};
+
+// interrupts = false for routine status lines that should not stop a
+// multi-turn action such as travel.
+void message_log_add(const std::string &msg, bool interrupts = true);
+
+// Count of interrupting messages posted so far.
+long message_log_interrupts();
+
+// Entries currently kept, 0 = oldest.
+int message_log_size();
+const log_entry_t& message_log_entry(int i);
+std::string message_log_format(const log_entry_t &e);
+
+// Put the message line into the current frame if anything changed; the
+// caller flushes.
+void messages_draw();
+
+// Draw and flush right away if new messages are waiting.
+void messages_flush();
+
+// The screen was cleared; redraw the line on the next frame.
+void messages_invalidate();
+
+#endif // MESSAGE_LOG_H
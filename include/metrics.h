@@ -0,0 +1,58 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Render-path instrumentation. Every flush to the terminal is one frame:
+// how long it took to build, how long the flush took, and how many bytes
+// and write syscalls reached the terminal. Autosaves add how long the game
+// thread spent capturing, how long until the save was on disk, and how
+// many saves were already queued; the journal adds its cost per PC turn,
+// and the stairs how long a change of level took.
+// Each series keeps the last METRICS_WINDOW samples so percentiles follow
+// recent play.
+
+constexpr int METRICS_WINDOW = 1024;
+
+// Ring of recent samples; percentiles are taken over the window.
+class RollingHistogram {
+public:
+    void add(double v);
+    double percentile(double p) const;
+    double max() const;
+    long count() const { return total; }
+    void reset();
+
+private:
+    std::vector<double> samples;
+    int next = 0;
+    long total = 0;
+};
+
+enum class MetricSeries {
+    BuildUs, FlushUs, Bytes, Writes,
+    CaptureUs, SaveUs, SaveQueue,
+    JournalUs, LevelUs,
+    COUNT
+};
+
+// Mark the start of building a frame (map, message line, list screen).
+void metrics_frame_begin();
+
+// Wrap one flush: time it and attribute the backend's I/O to the frame.
+void metrics_flush_begin();
+void metrics_flush_end();
+
+// Add a sample from elsewhere (autosave). Game thread only.
+void metrics_record(MetricSeries s, double v);
+
+const RollingHistogram& metrics_series(MetricSeries s);
+void metrics_reset();
+
+// One line per series: count, p50, p99, max.
+std::vector<std::string> metrics_report();
+void metrics_dump(FILE* out);
+
+#endif // METRICS_H
@@ -2,8 +2,8 @@
 #define MONSTER_TEMPLATE_H
 
 #include <string>
+#include <string_view>
 #include <vector>
-#include <random>
 
 struct Dice {
     int base;
@@ -11,7 +11,9 @@ struct Dice {
     int sides;
 
     int roll() const;
-    static Dice parse(const std::string& s);
+    // "<base>+<dice>d<sides>", base possibly negative; false if s is
+    // anything else.
+    static bool parse(std::string_view s, Dice& out);
     std::string to_string() const;
 };
 
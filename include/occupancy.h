@@ -0,0 +1,40 @@
+#ifndef OCCUPANCY_H
+#define OCCUPANCY_H
+
+#include "global.h"
+#include "character.h"
+#include <vector>
+
+// Cell -> entity lookups backed by char_map and object_map, so nothing has
+// to scan characters or object_instances to find what stands on a cell.
+
+void rebuild_char_map();
+void rebuild_object_map();
+
+// Living monster on (x, y), or nullptr. Bounds are checked.
+character_t* monster_at(int x, int y);
+// Index into object_instances of an object on (x, y), or -1.
+int object_at(int x, int y);
+
+// Indices into characters of the living monsters the player can see, in
+// no particular order. With fog on only the lit square around the PC is
+// looked at; with it off every living monster is visible anyway.
+void monsters_in_view(std::vector<int> &out);
+
+// The changes below go through these helpers so the state hash
+// (zobrist.h) and rollback marks (rollback.h) hear about them.
+
+// Move a character and keep dungeon/char_map in step.
+void move_character(character_t &c, int nx, int ny);
+// Mark a character dead and clear it off the map.
+void kill_character(character_t &c);
+// Change a character's hp.
+void set_hp(character_t &c, int hp);
+// Change a cell's hardness.
+void set_hardness(int x, int y, int h);
+// Put an object down on its (x, y), keeping object_map valid.
+void place_object(const ObjectInstance &o);
+// Remove object_instances[idx], keeping object_map valid.
+void remove_object(int idx);
+
+#endif // OCCUPANCY_H
@@ -6,4 +6,10 @@
 void djikstraForTunnel(int sx, int sy);
 void djikstraForNonTunnel(int sx, int sy);
 
+// The monster distance maps are built on demand: only when a monster is
+// about to follow one and it is stale (the PC moved, the level changed,
+// or rock was dug since it was built).
+void ensure_distance_maps(bool tunnel, bool non_tunnel);
+void pathfinding_terrain_changed();
+
 #endif // PATHFINDING_H
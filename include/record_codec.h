@@ -0,0 +1,72 @@
+#ifndef RECORD_CODEC_H
+#define RECORD_CODEC_H
+
+// Pieces shared by the save file (snapshot.h) and the level archive
+// (level_archive.h): both write fixed-size records that refer to strings
+// in one table, colours as a single space-separated string, and dice as
+// three numbers. Each format picks its own field widths; StrRef is any
+// struct of {off, len} and DiceRec any of {base, dice, sides}.
+#include "monster_template.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+bool in_map(int x, int y);
+
+std::string join_colors(const std::vector<std::string> &colors);
+std::vector<std::string> split_colors(const std::string &s);
+
+// Strings repeated across records (names, descriptions, colours) are
+// stored once. Lengths past what StrRef::len holds are cut short.
+template <typename StrRef>
+struct string_table_t {
+    std::string bytes;
+    std::unordered_map<std::string, uint32_t> seen;
+
+    StrRef add(const std::string &s) {
+        using len_t = decltype(StrRef::len);
+        auto it = seen.find(s);
+        if (it == seen.end()) {
+            it = seen.emplace(s, static_cast<uint32_t>(bytes.size())).first;
+            bytes += s;
+        }
+        size_t len = std::min<size_t>(s.size(), std::numeric_limits<len_t>::max());
+        return {it->second, static_cast<len_t>(len)};
+    }
+
+    StrRef add_colors(const std::vector<std::string> &colors) {
+        return add(join_colors(colors));
+    }
+};
+
+// Whether r lies inside a table of table_len bytes.
+template <typename StrRef>
+bool ref_ok(const StrRef &r, uint32_t table_len) {
+    return r.off <= table_len && r.len <= table_len - r.off;
+}
+
+template <typename DiceRec>
+DiceRec dice_record(const Dice &d) {
+    return {d.base, static_cast<decltype(DiceRec::dice)>(d.dice),
+            static_cast<decltype(DiceRec::sides)>(d.sides)};
+}
+
+template <typename DiceRec>
+Dice dice_from(const DiceRec &d) {
+    return Dice{d.base, d.dice, d.sides};
+}
+
+// Record i of an array of T that need not be aligned.
+template <typename T>
+T record_at(const uint8_t* base, size_t i) {
+    T v;
+    std::memcpy(&v, base + i * sizeof(T), sizeof v);
+    return v;
+}
+
+#endif // RECORD_CODEC_H
@@ -0,0 +1,34 @@
+#ifndef RENDER_H
+#define RENDER_H
+
+#include <array>
+#include <cstdint>
+#include "global.h"
+
+// Shadow framebuffer for the map area (screen rows 1..HEIGHT). A frame is
+// composed into render_next, then render_present() sends only the cells
+// that differ from what the terminal already shows, grouped into runs.
+
+// Rows are padded to a multiple of 16 bytes so the compositor can work on
+// whole vectors; columns past WIDTH are never drawn.
+constexpr int FB_STRIDE = (WIDTH + 15) & ~15;
+
+struct frame_t {
+    alignas(16) std::array<std::array<char, FB_STRIDE>, HEIGHT> glyph;
+    alignas(16) std::array<std::array<uint8_t, FB_STRIDE>, HEIGHT> color;  // pair, 0 = none
+};
+
+extern frame_t render_next;
+
+// Emit the changed cells of render_next and refresh.
+void render_present();
+
+// Draw one cell on top of the current frame right away (cursors,
+// projectiles, blast flashes). The next present repaints it as needed.
+void render_overlay(int x, int y, char glyph, int pair);
+
+// Forget what the terminal shows; the next present repaints every cell.
+// Needed after anything else drew over the map area.
+void render_invalidate();
+
+#endif // RENDER_H
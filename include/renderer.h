@@ -0,0 +1,166 @@
+#ifndef RENDERER_H
+#define RENDERER_H
+
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+#include <termios.h>
+
+// Terminal backend behind the UI. Everything that draws text or reads
+// keys goes through the current renderer: ncurses for play, raw ANSI for
+// terminals without curses, or an in-memory screen for benchmarks and
+// scripted runs.
+
+// Key codes returned by get_key(); plain keys are their character code.
+constexpr int SCREEN_KEY_NONE = -1;   // timed out, or no scripted input left
+constexpr int SCREEN_KEY_DOWN = 0402;
+constexpr int SCREEN_KEY_UP   = 0403;
+constexpr int SCREEN_KEY_NPAGE = 0522;  // page down
+constexpr int SCREEN_KEY_PPAGE = 0523;  // page up
+
+// Cumulative output sent to the terminal.
+struct io_counts_t {
+    long bytes, writes;
+};
+
+class Renderer {
+public:
+    virtual ~Renderer() = default;
+
+    virtual void begin() = 0;
+    virtual void end() = 0;
+
+    // Blank the whole screen / one row.
+    virtual void clear() = 0;
+    virtual void clear_line(int y) = 0;
+
+    // Draw n characters at (y, x) in a colour pair (0 = default).
+    virtual void put(int y, int x, const char* text, int n, int pair) = 0;
+
+    // Make everything drawn so far visible.
+    virtual void flush() = 0;
+
+    // Next key, waiting at most timeout_ms (forever when negative).
+    virtual int get_key(int timeout_ms) = 0;
+    virtual void unget_key(int ch) = 0;
+
+    virtual io_counts_t io_counts() const = 0;
+};
+
+// ncurses; with an output stream the screen is created with newterm so it
+// can be pointed somewhere other than the terminal.
+class NcursesRenderer : public Renderer {
+public:
+    explicit NcursesRenderer(FILE* out = nullptr) : out(out) {}
+    void begin() override;
+    void end() override;
+    void clear() override;
+    void clear_line(int y) override;
+    void put(int y, int x, const char* text, int n, int pair) override;
+    void flush() override;
+    int get_key(int timeout_ms) override;
+    void unget_key(int ch) override;
+    // ncurses writes on its own, so this comes from the thread's kernel
+    // I/O accounting (Linux only; zero elsewhere).
+    io_counts_t io_counts() const override;
+
+private:
+    FILE* out;
+    void* screen = nullptr;
+    int proc_io_fd = -1;
+};
+
+// Escape sequences built into one buffer and sent with a single write()
+// per flush. Input is read raw from in_fd when it is a terminal.
+class AnsiRenderer : public Renderer {
+public:
+    explicit AnsiRenderer(int out_fd = 1, int in_fd = 0) : out_fd(out_fd), in_fd(in_fd) {}
+    void begin() override;
+    void end() override;
+    void clear() override;
+    void clear_line(int y) override;
+    void put(int y, int x, const char* text, int n, int pair) override;
+    void flush() override;
+    int get_key(int timeout_ms) override;
+    void unget_key(int ch) override;
+    io_counts_t io_counts() const override { return written; }
+
+private:
+    void set_pair(int pair);
+    int read_byte(int timeout_ms);
+
+    int out_fd, in_fd;
+    std::string buf;
+    int cur_pair = -1;
+    bool raw = false;
+    struct termios saved_termios;
+    std::deque<int> pending;
+    io_counts_t written = {0, 0};
+};
+
+// In-memory screen with a scripted key queue. Nothing touches the
+// terminal; get_key() returns SCREEN_KEY_NONE once the script runs out.
+class HeadlessRenderer : public Renderer {
+public:
+    HeadlessRenderer(int rows, int cols);
+    void begin() override {}
+    void end() override {}
+    void clear() override;
+    void clear_line(int y) override;
+    void put(int y, int x, const char* text, int n, int pair) override;
+    void flush() override { frames++; }
+    int get_key(int timeout_ms) override;
+    void unget_key(int ch) override { keys.push_front(ch); }
+    io_counts_t io_counts() const override { return {0, 0}; }
+
+    void push_keys(const std::string &script);
+    void push_key(int ch) { keys.push_back(ch); }
+
+    char glyph_at(int y, int x) const;
+    int pair_at(int y, int x) const;
+    std::string row_text(int y) const;
+    long frame_count() const { return frames; }
+
+private:
+    int rows, cols;
+    std::vector<char> glyphs;
+    std::vector<unsigned char> pairs;
+    std::deque<int> keys;
+    long frames = 0;
+};
+
+// Backend by name ("ncurses", "ansi", "headless"); null if unknown.
+std::unique_ptr<Renderer> make_renderer(const std::string &name);
+
+// The current backend; ncurses until set_renderer() says otherwise.
+Renderer& renderer();
+void set_renderer(std::unique_ptr<Renderer> r);
+// Install r and hand back the previous backend, still running.
+std::unique_ptr<Renderer> swap_renderer(std::unique_ptr<Renderer> r);
+
+// Sees every input result the game acts on: keys read, polls (including
+// SCREEN_KEY_NONE) and key-waiting checks (0 or 1). A journal records
+// them; during a replay it supplies them instead of the backend.
+class InputTap {
+public:
+    virtual ~InputTap() = default;
+    // Set value and return true to stand in for the backend.
+    virtual bool replay(int &value) = 0;
+    virtual void record(int value) = 0;
+};
+void set_input_tap(InputTap* tap);
+
+// Shorthands used by the UI code.
+void screen_printf(int y, int x, const char* fmt, ...)
+    __attribute__((format(printf, 3, 4)));
+void screen_clear();
+void screen_refresh();  // flush, with timing and byte counts recorded
+int screen_getch();
+// Without waiting: the next key, or SCREEN_KEY_NONE.
+int screen_poll_key();
+// Whether a key is waiting; it stays queued for screen_getch().
+bool screen_key_waiting();
+
+#endif // RENDERER_H
@@ -0,0 +1,25 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <cstdint>
+
+// Game random numbers. Each stream is counter based: the n-th draw is a
+// hash of (seed, stream, n), so a stream's whole state is its position
+// and saving, restoring or checking it is just copying a counter.
+// Streams keep level generation apart from play, so one can be checked
+// without the other shifting it.
+enum class RngStream { Level, Monsters, Combat, COUNT };
+constexpr int RNG_STREAMS = static_cast<int>(RngStream::COUNT);
+
+// Reseed and rewind every stream.
+void rng_seed(uint64_t seed);
+uint64_t rng_get_seed();
+
+uint64_t rng_next(RngStream s);
+// Uniform in [0, n); n must be positive.
+int rng_below(RngStream s, int n);
+
+uint64_t rng_position(RngStream s);
+void rng_set_position(RngStream s, uint64_t pos);
+
+#endif // RNG_H
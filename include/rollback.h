@@ -0,0 +1,51 @@
+#ifndef ROLLBACK_H
+#define ROLLBACK_H
+
+#include <cstddef>
+#include <memory>
+
+// Marks of the current level's state that the game can be put back to:
+// for undo, seeking within a replay, or trying several futures from one
+// turn (AI lookahead) without copying the world for each.
+//
+// A mark is persistent. The map is cut into 64x8 tiles (terrain, display,
+// occupancy and explored cells together) and each tile, each character and
+// the floor object list is held by shared pointer, so a mark shares
+// everything unchanged with the one before it. The code that changes state
+// marks what it touched (the helpers in occupancy.h do it), and taking a
+// mark copies just those tiles and characters, plus one pointer per 64
+// tiles or characters. The PC changes in too many places to track, so it
+// is always copied and always put back.
+//
+// Putting the game back writes only the tiles and characters that differ
+// between the mark and the live state. Characters keep their slots, so
+// pointers into characters stay valid, but an event queue built since the
+// mark must be rebuilt from next_time.
+
+struct world_state_t;
+using world_mark_t = std::shared_ptr<const world_state_t>;
+
+// Take a mark. The first one on a level captures everything.
+world_mark_t rollback_mark();
+// Put the level back as it was at mark. false, with nothing changed, if
+// the level has been replaced since (stairs, load).
+bool rollback_to(const world_mark_t &mark);
+
+// Write barriers: the tile holding (x, y), characters[idx], or the floor
+// object list changed since the last mark.
+void rollback_touch_cell(int x, int y);
+void rollback_touch_character(int idx);
+void rollback_touch_objects();
+
+struct rollback_stats_t {
+    long marks = 0;
+    long rollbacks = 0;
+    long tiles_copied = 0;       // into marks
+    long characters_copied = 0;
+    long tiles_restored = 0;     // out of marks
+    long characters_restored = 0;
+    size_t tile_bytes = 0;       // one tile
+};
+rollback_stats_t rollback_stats();
+
+#endif // ROLLBACK_H
@@ -0,0 +1,44 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <cstdint>
+#include <vector>
+
+// Whole-session save files, format version 1. The file starts with the
+// same marker, version and size as a version 0 dungeon file, then a
+// checksummed run of tagged sections. Each section is an array of
+// fixed-size records in the writer's byte order, laid out so they can be
+// used straight from the read buffer; a header field records that order
+// and a machine of the other one refuses the file. Strings live in one
+// shared string table.
+constexpr int SNAPSHOT_VERSION = 1;
+
+enum class LoadKind {
+    Failed,   // nothing changed; the reason went to stderr
+    Level,    // version 0: terrain and PC position only
+    Session,  // version 1: the whole game, ready to resume
+};
+
+// Serialize the current session into buf / a file. save_snapshot() says
+// nothing itself (the screen may be up); on failure errno tells why.
+void snapshot_build(std::vector<uint8_t> &buf);
+bool save_snapshot(const char* path);
+
+// snapshot_build() in two steps, so the copy can be taken on the game
+// thread and the checksum left to whoever writes it out. capture() also
+// hands back archive_fd (see archive_sync_fd()), which seal() uses to put
+// the levels the snapshot refers to on disk first, and then closes.
+void snapshot_capture(std::vector<uint8_t> &buf, int &archive_fd);
+void snapshot_seal(std::vector<uint8_t> &buf, int archive_fd);
+
+// Read a save file of either version. A session load replaces the level,
+// characters (with their next_time), objects, explored cells and
+// seen_artifacts; the caller rebuilds the event queue from next_time.
+LoadKind load_game(const char* path);
+LoadKind load_game_from(const std::vector<uint8_t> &buf, const char* path);
+
+// The game a session save belongs to (see level_archive.h), or 0 for
+// anything else, or a file that cannot be read.
+uint64_t snapshot_game_id(const char* path);
+
+#endif // SNAPSHOT_H
@@ -0,0 +1,46 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed-size worker pool for data-parallel loops. The calling thread
+// joins in, so a pool of size 1 just runs the loop inline.
+class ThreadPool {
+public:
+    explicit ThreadPool(unsigned threads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Run fn(i) for every i in [0, n); returns once all calls finished.
+    void parallel_for(int n, const std::function<void(int)>& fn);
+
+    unsigned size() const { return static_cast<unsigned>(workers.size()) + 1; }
+
+private:
+    void worker_loop();
+    void run_chunks(const std::function<void(int)>* fn, int n);
+
+    std::vector<std::thread> workers;
+    std::mutex mtx;
+    std::condition_variable work_cv;
+    std::condition_variable done_cv;
+
+    const std::function<void(int)>* job = nullptr;
+    int job_size = 0;
+    std::atomic<int> next_index{0};
+    int busy = 0;
+    unsigned generation = 0;
+    bool stopping = false;
+};
+
+// Shared pool used by the monster decide phase.
+ThreadPool& game_pool();
+
+#endif // THREAD_POOL_H
@@ -0,0 +1,26 @@
+#ifndef TRAVEL_H
+#define TRAVEL_H
+
+#include "character.h"
+
+// Multi-turn movement: walk to a chosen cell, or auto-explore toward the
+// nearest cell next to unexplored ground. While a trip is on, the PC's
+// turns come from the trip instead of the keyboard and nothing is drawn;
+// it stops when a monster comes into view, an interrupting message is
+// posted, a key is pressed, or the goal is reached.
+
+// Start a trip; false (with a message) when there is no known way.
+bool travel_to(int x, int y);
+bool travel_explore();
+
+bool travel_active();
+void travel_stop(const std::string &why);
+
+// Take the PC's turn from the current trip. Returns false once the trip
+// has ended; the turn is then the player's.
+bool travel_step(character_t &pc);
+
+// Nearest remembered staircase ('<' or '>') to the PC.
+bool nearest_known_stairs(char which, int &x, int &y);
+
+#endif // TRAVEL_H
@@ -5,18 +5,26 @@
 #include "character.h"
 #include <string>
 
-void init_curses();
-void end_curses();
+void init_screen();
+void end_screen();
 
-void display_message(const std::string &msg);
+void display_message(const std::string &msg, bool interrupts = true);
 void display_dungeon();
+// What display_dungeon() does before drawing: field of view and explored
+// cells. Replays call it alone, since the explored cells are game state.
+void update_view();
+int update_fog_map();
+void forget_level();
 void display_monster_list();
+void display_message_log();
+void display_metrics();
 
 void handle_magic_spell_mode(character_t &pc);
 void handle_ranged_attack_mode(character_t &pc);
 
 bool pc_can_walk_on(char cell);
 void handle_pc_input(character_t &pc);
+bool input_pending();
 
 int get_color_pair(const std::vector<std::string>& colors);
 
@@ -0,0 +1,48 @@
+#ifndef ZOBRIST_H
+#define ZOBRIST_H
+
+#include "global.h"
+#include "object_instance.h"
+#include <cstdint>
+
+// 64-bit fingerprint of the game state: terrain, rooms and stairs, every
+// character's position, hp and whether it lives, floor objects, what the
+// PC carries and the random streams' positions. The map and entity parts
+// are kept up to date by the code that changes them, one key in and one
+// out per change, so reading the hash never walks the level.
+//
+// Keys are not tables but a 64-bit mix of (kind, where, what), so any map
+// size or hardness value has one. Terrain and characters combine with XOR;
+// floor objects are added, so two identical objects on one cell do not
+// cancel out. The PC's pack and the random streams are small and change
+// all the time, so they are folded in when the hash is read.
+
+// Start over from the current level; call whenever characters or
+// object_instances are replaced wholesale (new level, load).
+void zobrist_rehash();
+
+// The fingerprint as maintained, and as computed from scratch; the two
+// differ only if some change skipped its hook.
+uint64_t zobrist_hash();
+uint64_t zobrist_full();
+
+// The maintained part of the hash, for code that puts the whole level back
+// at once instead of going through the hooks (rollback.h).
+struct zobrist_state_t {
+    uint64_t level = 0;       // rooms and stairs; fixed for a level
+    uint64_t terrain = 0;     // hardness
+    uint64_t characters = 0;  // position, hp and life by characters[] index
+    uint64_t floor = 0;       // floor objects, summed
+};
+zobrist_state_t zobrist_save();
+void zobrist_restore(const zobrist_state_t &z);
+
+// Hooks for the code that changes state.
+void zobrist_terrain(int x, int y, int old_hardness, int new_hardness);
+void zobrist_moved(int idx, int ox, int oy, int nx, int ny);
+void zobrist_hp(int idx, int old_hp, int new_hp);
+void zobrist_died(int idx);
+void zobrist_object_added(const ObjectInstance &o);
+void zobrist_object_removed(const ObjectInstance &o);
+
+#endif // ZOBRIST_H
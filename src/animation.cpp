@@ -0,0 +1,71 @@
+#include "animation.h"
+#include "render.h"
+#include <algorithm>
+#include <chrono>
+#include "renderer.h"
+
+struct anim_cell_t {
+    int x, y;
+    char glyph;
+    int pair;
+};
+
+struct anim_frame_t {
+    int hold_ms;
+    std::vector<anim_cell_t> cells;
+};
+
+static std::vector<anim_frame_t> timeline;
+static bool anim_enabled = true;
+
+static const int FRAME_MS = 1000 / ANIM_MAX_FPS;
+
+void anim_frame(int hold_ms) {
+    timeline.push_back({std::max(hold_ms, FRAME_MS), {}});
+}
+
+void anim_cell(int x, int y, char glyph, int pair) {
+    if (timeline.empty())
+        anim_frame(FRAME_MS);
+    timeline.back().cells.push_back({x, y, glyph, pair});
+}
+
+void anim_cells(const std::vector<std::pair<int, int>> &cells, char glyph, int pair) {
+    for (const auto &cell : cells)
+        anim_cell(cell.first, cell.second, glyph, pair);
+}
+
+void anim_play() {
+    if (!anim_enabled) {
+        timeline.clear();
+        return;
+    }
+
+    // Deadlines are kept on an absolute clock so drawing time is not
+    // added on top of each frame's hold.
+    using clock = std::chrono::steady_clock;
+    auto deadline = clock::now();
+    for (const anim_frame_t &frame : timeline) {
+        render_present();  // takes back the previous frame's overlays
+        for (const anim_cell_t &cell : frame.cells)
+            render_overlay(cell.x, cell.y, cell.glyph, cell.pair);
+        screen_refresh();
+
+        deadline += std::chrono::milliseconds(frame.hold_ms);
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+            deadline - clock::now()).count();
+        if (left <= 0)
+            continue;
+        int ch = renderer().get_key(static_cast<int>(left));
+        if (ch != SCREEN_KEY_NONE) {
+            renderer().unget_key(ch);
+            break;
+        }
+    }
+    timeline.clear();
+    render_present();
+}
+
+void anim_set_enabled(bool enabled) {
+    anim_enabled = enabled;
+}
@@ -0,0 +1,69 @@
+#include "aoe.h"
+#include "character.h"
+#include "occupancy.h"
+#include "los.h"
+#include "ui.h"
+#include "rng.h"
+#include <algorithm>
+#include <cstdlib>
+
+aoe_hits_t aoe_query(int cx, int cy, const aoe_area_t &area) {
+    aoe_hits_t hits;
+    los_sync();
+
+    auto visit = [&](int x, int y) {
+        if (x < 0 || x >= WIDTH || y < 0 || y >= HEIGHT)
+            return;
+        if (area.stop_at_walls && !(x == cx && y == cy) &&
+            (!bit_test(walkable, x, y) || !los_clear(cx, cy, x, y)))
+            return;
+        hits.cells.emplace_back(x, y);
+        int idx = char_map[y][x];
+        if (idx >= 0 && monster_at(x, y))
+            hits.ids.push_back(idx);
+    };
+
+    if (area.shape == AoeShape::Disc && area.radius <= MAX_BLAST_RADIUS) {
+        ray_t disc = los_disc(area.radius);
+        for (int i = 0; i < disc.len; i++)
+            visit(cx + disc.steps[i].dx, cy + disc.steps[i].dy);
+    } else {
+        int r = area.radius;
+        for (int dy = -r; dy <= r; dy++)
+            for (int dx = -r; dx <= r; dx++)
+                if (area.shape == AoeShape::Square || dx*dx + dy*dy <= r*r)
+                    visit(cx + dx, cy + dy);
+    }
+
+    std::sort(hits.ids.begin(), hits.ids.end());
+    return hits;
+}
+
+aoe_result_t aoe_apply_damage(const aoe_hits_t &hits, int base, int spread,
+                              const std::string &spell) {
+    aoe_result_t res{0, 0};
+    for (int id : hits.ids) {
+        character_t &m = characters[id];
+        set_hp(m, m.hp - base - (spread > 0 ? rng_below(RngStream::Combat, spread) : 0));
+        res.hit++;
+    }
+    // Death sweep after all damage is in, so the map changes once.
+    for (int id : hits.ids) {
+        character_t &m = characters[id];
+        if (m.alive && m.hp <= 0) {
+            kill_character(m);
+            res.killed++;
+        }
+    }
+
+    if (res.hit == 0) {
+        display_message(spell + " explodes harmlessly.");
+    } else {
+        std::string msg = spell + " explodes! " + std::to_string(res.hit) +
+                          (res.hit == 1 ? " monster hit" : " monsters hit");
+        if (res.killed > 0)
+            msg += ", " + std::to_string(res.killed) + " killed";
+        display_message(msg + ".");
+    }
+    return res;
+}
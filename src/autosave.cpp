@@ -0,0 +1,148 @@
+#include "autosave.h"
+#include "snapshot.h"
+#include "fileio.h"
+#include "metrics.h"
+#include "ui.h"
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using save_clock = std::chrono::steady_clock;
+
+struct autosave_state_t {
+    std::string path;
+    int every = 0;
+    bool running = false;
+    std::thread writer;
+
+    // back belongs to the game thread, front to the writer; pending is
+    // handed between them under the lock, with the archive descriptor
+    // snapshot_seal() takes.
+    std::mutex lock;
+    std::condition_variable wake;
+    std::vector<uint8_t> back, pending, front;
+    int pending_fd = -1;
+    bool has_pending = false, writing = false, stop = false;
+    save_clock::time_point pending_since;
+
+    // Results waiting for the game thread to pick up.
+    std::vector<double> done_us;
+    int failed_errno = 0;
+};
+
+static autosave_state_t state;
+
+static void writer_loop() {
+    std::unique_lock<std::mutex> guard(state.lock);
+    for (;;) {
+        state.wake.wait(guard, []() { return state.has_pending || state.stop; });
+        if (!state.has_pending)
+            break;
+        std::swap(state.front, state.pending);
+        int archive_fd = state.pending_fd;
+        state.pending_fd = -1;
+        state.has_pending = false;
+        state.writing = true;
+        save_clock::time_point since = state.pending_since;
+        guard.unlock();
+
+        snapshot_seal(state.front, archive_fd);
+        bool ok = write_file_atomic(state.path.c_str(), state.front);
+        int err = ok ? 0 : errno;
+        double us = std::chrono::duration<double, std::micro>(save_clock::now() - since).count();
+
+        guard.lock();
+        state.writing = false;
+        state.done_us.push_back(us);
+        if (!ok)
+            state.failed_errno = err;
+    }
+}
+
+// Move finished saves into the metrics and report the latest failure.
+static void collect() {
+    std::vector<double> done;
+    int err;
+    {
+        std::lock_guard<std::mutex> guard(state.lock);
+        done.swap(state.done_us);
+        err = state.failed_errno;
+        state.failed_errno = 0;
+    }
+    for (double us : done)
+        metrics_record(MetricSeries::SaveUs, us);
+    if (err)
+        display_message(std::string("Autosave failed: ") + strerror(err));
+}
+
+void autosave_start(const std::string &path, int every_turns) {
+    if (state.running)
+        autosave_stop();
+    state.path = path;
+    state.every = every_turns;
+    state.stop = false;
+    state.running = true;
+    state.writer = std::thread(writer_loop);
+    // A thread still joinable at exit would abort the process.
+    static bool registered = false;
+    if (!registered) {
+        std::atexit(autosave_stop);
+        registered = true;
+    }
+}
+
+void autosave_stop() {
+    if (!state.running)
+        return;
+    {
+        std::lock_guard<std::mutex> guard(state.lock);
+        state.stop = true;
+    }
+    state.wake.notify_one();
+    state.writer.join();
+    state.running = false;
+}
+
+bool autosave_enabled() {
+    return state.running;
+}
+
+void autosave_now() {
+    if (!state.running)
+        return;
+    collect();
+    save_clock::time_point t0 = save_clock::now();
+    int archive_fd;
+    snapshot_capture(state.back, archive_fd);
+    metrics_record(MetricSeries::CaptureUs,
+                   std::chrono::duration<double, std::micro>(save_clock::now() - t0).count());
+    int depth;
+    {
+        std::lock_guard<std::mutex> guard(state.lock);
+        depth = state.has_pending + state.writing;
+        // A save the writer has not started on is replaced.
+        if (state.pending_fd >= 0)
+            close(state.pending_fd);
+        state.pending_fd = archive_fd;
+        std::swap(state.back, state.pending);
+        state.has_pending = true;
+        state.pending_since = t0;
+    }
+    state.wake.notify_one();
+    metrics_record(MetricSeries::SaveQueue, depth);
+}
+
+void autosave_turn(int pc_turn) {
+    if (!state.running)
+        return;
+    if (state.every > 0 && pc_turn > 0 && pc_turn % state.every == 0)
+        autosave_now();
+    else
+        collect();
+}
@@ -5,13 +5,26 @@
 #include "ui.h"
 #include "monster_template.h"
 #include "object_generator.h"
+#include "thread_pool.h"
+#include "occupancy.h"
+#include "fov.h"
+#include "los.h"
+#include "renderer.h"
+#include "rng.h"
+#include "level_cache.h"
+#include "metrics.h"
+#include "rollback.h"
+#include <chrono>
+#include <algorithm>
 #include <cstdlib>
 #include <climits>
+#include <cerrno>
+#include <cstring>
 #include <unordered_set>
-#include <ncurses.h>
 
 std::vector<character_t> characters;
 bool pc_is_alive = true;
+int monsters_alive = 0;
 
 
 void create_pc() {
@@ -33,9 +46,12 @@ void create_pc() {
 
     pc.mana = 10;
     pc.max_mana = 10; 
+    pc.pc_seen_x = pc.pc_seen_y = -1;
+    pc.next_time = 0;
 
     characters.push_back(pc);
     dungeon[pc_y][pc_x] = '@';
+    char_map[pc_y][pc_x] = static_cast<int>(characters.size()) - 1;
 }
 
 
@@ -46,8 +62,8 @@ void create_monster() {
     MonsterTemplate selected;
     bool found = false;
     for (int attempt = 0; attempt < 1000; ++attempt) {
-        const auto& cand = monster_templates[rand() % monster_templates.size()];
-        if ((rand() % 100) < cand.rarity) {
+        const auto& cand = monster_templates[rng_below(RngStream::Level, monster_templates.size())];
+        if (rng_below(RngStream::Level, 100) < cand.rarity) {
             selected = cand;
             found = true;
             break;
@@ -55,12 +71,26 @@ void create_monster() {
     }
     if (!found) return;
 
-    // Find spawn location
-    int rx, ry;
-    do {
-        rx = rand() % WIDTH;
-        ry = rand() % HEIGHT;
-    } while (dungeon[ry][rx] != '.');
+    // Find spawn location. Random probes are cheap while the level is
+    // sparse; on crowded levels fall back to a scan from a random cell so
+    // spawning never spins forever.
+    int rx = 0, ry = 0;
+    bool placed = false;
+    for (int attempt = 0; attempt < 100 && !placed; ++attempt) {
+        rx = rng_below(RngStream::Level, WIDTH);
+        ry = rng_below(RngStream::Level, HEIGHT);
+        placed = (dungeon[ry][rx] == '.');
+    }
+    if (!placed) {
+        int start = rng_below(RngStream::Level, WIDTH * HEIGHT);
+        for (int k = 0; k < WIDTH * HEIGHT && !placed; ++k) {
+            int cell = (start + k) % (WIDTH * HEIGHT);
+            rx = cell % WIDTH;
+            ry = cell / WIDTH;
+            placed = (dungeon[ry][rx] == '.');
+        }
+    }
+    if (!placed) return;
 
     character_t m;
     m.type = CharType::Monster;
@@ -69,10 +99,13 @@ void create_monster() {
     m.y = ry;
     m.speed = selected.speed.roll();
     m.hp = selected.hp.roll();
+    m.base_damage = selected.damage;
     m.turn = 0;
     m.symbol = selected.symbol;
     m.color = selected.colors;
     m.monster_btype = 0;  
+    m.pc_seen_x = m.pc_seen_y = -1;
+    m.next_time = 0;
 
     // Example: handle "SMART", "TELE", etc. abilities
     for (const std::string& ab : selected.abilities) {
@@ -84,33 +117,72 @@ void create_monster() {
 
     characters.push_back(m);
     dungeon[ry][rx] = m.symbol;
+    char_map[ry][rx] = static_cast<int>(characters.size()) - 1;
+    monsters_alive++;
 }
 
 
-void do_monster_movement(character_t &m) {
+// Offsets for an erratic step, indexed by a pre-drawn roll in [0, 9).
+static const int ddx[9] = {0, -1, 1, 0, 0, -1, -1, 1, 1};
+static const int ddy[9] = {0, 0, 0, -1, 1, -1, 1, -1, 1};
+
+// Update what a monster knows about the PC's whereabouts. Telepaths always
+// know; everyone else needs a line of sight, which is symmetric with the
+// PC's own field of view.
+void perceive_pc(character_t &m) {
+    bool telepathic = (m.monster_btype & 0x2);
+    if (telepathic || fov_visible(m.x, m.y)) {
+        m.pc_seen_x = pc_x;
+        m.pc_seen_y = pc_y;
+    } else if (m.x == m.pc_seen_x && m.y == m.pc_seen_y) {
+        // Reached the last sighting and the PC is gone; lose the trail.
+        m.pc_seen_x = m.pc_seen_y = -1;
+    }
+}
+
+// Whether a monster at its position could shoot the PC: in range and with
+// nothing but open floor between them. Table lookups only, so it is safe
+// in the decide phase.
+bool monster_has_shot(const character_t &m) {
+    int dx = pc_x - m.x, dy = pc_y - m.y;
+    if (std::abs(dx) > MAX_TARGET_RANGE || std::abs(dy) > MAX_TARGET_RANGE)
+        return false;
+    return los_clear(m.x, m.y, pc_x, pc_y);
+}
+
+// Draw the random numbers a monster's decision needs. Done serially, in
+// id order, so the random sequence does not depend on thread scheduling.
+int roll_monster_move(const character_t &m) {
+    bool erratic = (m.monster_btype & 0x8);
+    if (erratic && rng_below(RngStream::Monsters, 2) == 0)
+        return rng_below(RngStream::Monsters, 9);
+    return -1;
+}
+
+// Decide phase: only reads the dungeon, distance maps and PC position, so
+// any number of these can run at once.
+monster_move_t decide_monster_move(const character_t &m, int roll) {
+    monster_move_t mv;
+    mv.x = m.x;
+    mv.y = m.y;
     if (!m.alive)
-        return;
-    int oldx = m.x, oldy = m.y;
+        return mv;
     bool intelligence = (m.monster_btype & 0x1);
     bool tunneling = (m.monster_btype & 0x4);
-    bool erratic = (m.monster_btype & 0x8);
-    
-    bool do_random = false;
-    if (erratic && (rand() % 2 == 0))
-        do_random = true;
-    
-    int bestx = m.x, besty = m.y;
-    if (do_random) {
-        int rr = rand() % 9;
-        int ddx[9] = {0, -1, 1, 0, 0, -1, -1, 1, 1};
-        int ddy[9] = {0, 0, 0, -1, 1, -1, 1, -1, 1};
-        bestx = m.x + ddx[rr];
-        besty = m.y + ddy[rr];
-    } else if (!intelligence) {
-        int dx = (pc_x > m.x) ? 1 : ((pc_x < m.x) ? -1 : 0);
-        int dy = (pc_y > m.y) ? 1 : ((pc_y < m.y) ? -1 : 0);
-        bestx = m.x + dx;
-        besty = m.y + dy;
+    // The distance maps lead to where the PC is now, so only use them when
+    // that is also where the monster believes the PC to be.
+    bool knows_pc = (m.pc_seen_x == pc_x && m.pc_seen_y == pc_y);
+
+    if (roll >= 0) {
+        mv.x = m.x + ddx[roll];
+        mv.y = m.y + ddy[roll];
+    } else if (m.pc_seen_x < 0) {
+        // Unaware of the PC: stay put.
+    } else if (!intelligence || !knows_pc) {
+        int dx = (m.pc_seen_x > m.x) ? 1 : ((m.pc_seen_x < m.x) ? -1 : 0);
+        int dy = (m.pc_seen_y > m.y) ? 1 : ((m.pc_seen_y < m.y) ? -1 : 0);
+        mv.x = m.x + dx;
+        mv.y = m.y + dy;
     } else {
         int bestDist = INT_MAX;
         for (int i = -1; i <= 1; i++) {
@@ -122,39 +194,114 @@ void do_monster_movement(character_t &m) {
                     int d = tunneling ? disTunneling[ny][nx] : disNonTunneling[ny][nx];
                     if (d < bestDist) {
                         bestDist = d;
-                        bestx = nx;
-                        besty = ny;
+                        mv.x = nx;
+                        mv.y = ny;
                     }
                 }
             }
         }
     }
-    
+    return mv;
+}
+
+// Apply phase: performs the dig, attack or step chosen by the decide
+// phase against the current state, which earlier monsters in the same
+// tick may already have changed.
+void apply_monster_move(character_t &m, const monster_move_t &mv) {
+    if (!m.alive)
+        return;
+    int oldx = m.x, oldy = m.y;
+    int bestx = mv.x, besty = mv.y;
+    bool tunneling = (m.monster_btype & 0x4);
+
+    if (bestx < 0 || bestx >= WIDTH || besty < 0 || besty >= HEIGHT)
+        return;
+    if (bestx == oldx && besty == oldy)
+        return;
+    if (hardness[besty][bestx] == 255)
+        return;
+
     // If tunneling and encountering a wall.
-    if (tunneling && hardness[besty][bestx] > 0 && hardness[besty][bestx] < 255) {
-        hardness[besty][bestx] -= 85;
+    if (hardness[besty][bestx] > 0) {
+        if (!tunneling)
+            return;
+        set_hardness(bestx, besty, hardness[besty][bestx] - 85);
+        pathfinding_terrain_changed();
         if (hardness[besty][bestx] > 0)
             return;
-        dungeon[besty][bestx] = '#';
-        base_map[besty][bestx] = '#';
+        carve_corridor(bestx, besty);
     }
-    
+
     if (dungeon[besty][bestx] == '@') {
-        character_t &pc = characters[0]; 
+        character_t &pc = characters[0];
         perform_attack(m, pc);
         return;
     }
-    
-    
-    dungeon[oldy][oldx] = base_map[oldy][oldx];
-    m.x = bestx;
-    m.y = besty;
-    if (m.alive)
-        dungeon[besty][bestx] = m.symbol;
+
+    // Another monster got here first this tick; wait instead of stacking.
+    if (char_map[besty][bestx] >= 0)
+        return;
+
+    move_character(m, bestx, besty);
+}
+
+void do_monster_movement(character_t &m) {
+    if (!m.alive)
+        return;
+    fov_update();
+    perceive_pc(m);
+    apply_monster_move(m, decide_monster_move(m, roll_monster_move(m)));
+}
+
+// Below this many monsters the pool costs more than it saves.
+static const size_t PARALLEL_DECIDE_MIN = 256;
+
+void do_monster_turns(std::vector<character_t*> &batch) {
+    // characters is contiguous, so pointer order is id order.
+    std::sort(batch.begin(), batch.end());
+    // Everyone in the batch takes a turn, so all of them change.
+    for (character_t* m : batch)
+        rollback_touch_character(static_cast<int>(m - characters.data()));
+
+    fov_update();
+    los_sync();
+    std::vector<int> rolls(batch.size());
+    bool need_tunnel = false, need_non_tunnel = false;
+    for (size_t i = 0; i < batch.size(); i++) {
+        character_t &m = *batch[i];
+        if (!m.alive) {
+            rolls[i] = -1;
+            continue;
+        }
+        perceive_pc(m);
+        rolls[i] = roll_monster_move(m);
+        // Only smart monsters that know where the PC is follow the maps.
+        if (rolls[i] < 0 && (m.monster_btype & 0x1) &&
+            m.pc_seen_x == pc_x && m.pc_seen_y == pc_y) {
+            if (m.monster_btype & 0x4)
+                need_tunnel = true;
+            else
+                need_non_tunnel = true;
+        }
+    }
+    ensure_distance_maps(need_tunnel, need_non_tunnel);
+
+    std::vector<monster_move_t> moves(batch.size());
+    auto decide = [&](int i) { moves[i] = decide_monster_move(*batch[i], rolls[i]); };
+    if (batch.size() >= PARALLEL_DECIDE_MIN) {
+        game_pool().parallel_for(static_cast<int>(batch.size()), decide);
+    } else {
+        for (size_t i = 0; i < batch.size(); i++)
+            decide(static_cast<int>(i));
+    }
+
+    for (size_t i = 0; i < batch.size() && pc_is_alive; i++)
+        apply_monster_move(*batch[i], moves[i]);
 }
 
 void new_level(int nummon) {
     characters.clear();
+    monsters_alive = 0;
     // Create new dungeon level.
     initializeDungeon();
     generateRooms();
@@ -169,16 +316,30 @@ void new_level(int nummon) {
         pc_y = 1;
     }
     base_map = dungeon;
+    terrain_generation++;
+    forget_level();
     placePC(pc_x, pc_y);
     
-    djikstraForNonTunnel(pc_x, pc_y);
-    djikstraForTunnel(pc_x, pc_y);
-    
+    for (auto &row : char_map)
+        row.fill(-1);
+    characters.reserve(nummon + 1);
     create_pc();
     generate_objects(10);  
     for (int i = 0; i < nummon; i++)
         create_monster();
 
+    level_changed = true;
+}
+
+void change_level(int delta, int nummon) {
+    auto t0 = std::chrono::steady_clock::now();
+    if (!level_cache_leave(dungeon_depth))
+        display_message(std::string("Could not archive a level: ") + strerror(errno), false);
+    dungeon_depth += delta;
+    if (!level_cache_enter(dungeon_depth))
+        new_level(nummon);
+    metrics_record(MetricSeries::LevelUs, std::chrono::duration<double, std::micro>(
+        std::chrono::steady_clock::now() - t0).count());
 }
 
 int calculate_total_damage(const character_t &attacker) {
@@ -195,20 +356,15 @@ int calculate_total_damage(const character_t &attacker) {
             }
         }
     } else {
-        // NPCs use their own damage dice
-        for (const auto &mt : monster_templates) {
-            if (mt.symbol == attacker.symbol) {
-                total += mt.damage.roll();
-                break;
-            }
-        }
+        // NPCs use their template damage dice, copied in at creation
+        total += attacker.base_damage.roll();
     }
     return total;
 }
 
 void perform_attack(character_t &attacker, character_t &defender) {
     int dmg = calculate_total_damage(attacker);
-    defender.hp -= dmg;
+    set_hp(defender, defender.hp - dmg);
 
     if (defender.type == CharType::PC) {
         if (defender.hp <= 0) {
@@ -219,8 +375,7 @@ void perform_attack(character_t &attacker, character_t &defender) {
         }
     } else {
         if (defender.hp <= 0) {
-            defender.alive = false;
-            dungeon[defender.y][defender.x] = base_map[defender.y][defender.x];
+            kill_character(defender);
             display_message("You killed " + std::string(1, defender.symbol));
         } else {
             display_message("Hit enemy for " + std::to_string(dmg) + " damage.");
@@ -228,10 +383,8 @@ void perform_attack(character_t &attacker, character_t &defender) {
     }
     if (!defender.alive && defender.symbol == 'B') {  //boss kill check, end game if monster "B" is defeated
         display_message("You defeated the boss! You win!");
-        getch(); end_curses(); std::exit(0);
+        screen_getch(); end_screen(); std::exit(0);
     }
-    
-    std::cout <<"[ATTACK] Damage: " << dmg << ", Target HP before: " << defender.hp << std::endl;
 }
 
 
@@ -0,0 +1,115 @@
+#include "commands.h"
+#include "renderer.h"
+#include <array>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+static std::array<Action, KEYMAP_SIZE> keymap = [](){
+    std::array<Action, KEYMAP_SIZE> tmp;
+    tmp.fill(Action::None);
+    return tmp;
+}();
+
+static const char* const ACTION_NAMES[ACTION_COUNT] = {
+    "none",
+    "move_nw", "move_n", "move_ne", "move_e", "move_se", "move_s", "move_sw", "move_w",
+    "rest",
+    "stairs_down", "stairs_up",
+    "teleport", "travel", "explore",
+    "inventory", "equipment", "inspect", "wear", "take_off", "drop", "expunge",
+    "toggle_fog", "look", "monster_list", "message_log", "metrics",
+    "ranged", "poison_ball", "fireball",
+    "quit",
+};
+
+Action action_for_key(int key) {
+    if (key < 0 || key >= KEYMAP_SIZE)
+        return Action::None;
+    return keymap[key];
+}
+
+void bind_key(int key, Action a) {
+    if (key >= 0 && key < KEYMAP_SIZE)
+        keymap[key] = a;
+}
+
+const char* action_name(Action a) {
+    return ACTION_NAMES[static_cast<int>(a)];
+}
+
+static void bind_defaults() {
+    keymap.fill(Action::None);
+    const struct { const char* keys; Action a; } defaults[] = {
+        {"7y", Action::MoveNW}, {"8k", Action::MoveN}, {"9u", Action::MoveNE},
+        {"6l", Action::MoveE}, {"3n", Action::MoveSE}, {"2j", Action::MoveS},
+        {"1b", Action::MoveSW}, {"4h", Action::MoveW},
+        {"5. ", Action::Rest},
+        {">", Action::StairsDown}, {"<", Action::StairsUp},
+        {"g", Action::Teleport}, {"G", Action::Travel}, {"o", Action::Explore},
+        {"i", Action::Inventory}, {"e", Action::Equipment}, {"I", Action::Inspect},
+        {"w", Action::Wear}, {"t", Action::TakeOff}, {"d", Action::Drop},
+        {"x", Action::Expunge},
+        {"f", Action::ToggleFog}, {"L", Action::Look}, {"m", Action::MonsterList},
+        {"\x10", Action::MessageLog}, {"M", Action::Metrics},
+        {"a", Action::Ranged}, {"p", Action::PoisonBall}, {"F", Action::Fireball},
+        {"Q", Action::Quit},
+    };
+    for (const auto &d : defaults)
+        for (const char* k = d.keys; *k; k++)
+            bind_key(static_cast<unsigned char>(*k), d.a);
+}
+
+// Key code for a keymap file token, or -1.
+static int parse_key(const std::string &tok) {
+    if (tok.size() == 1)
+        return static_cast<unsigned char>(tok[0]);
+    if (tok.size() == 2 && tok[0] == '^' && tok[1] >= '@' && tok[1] <= '_')
+        return tok[1] - '@';
+    if (tok.size() == 2 && tok[0] == '^' && tok[1] >= 'a' && tok[1] <= 'z')
+        return tok[1] - 'a' + 1;
+    if (tok == "space")
+        return ' ';
+    if (tok == "esc")
+        return 27;
+    if (tok == "up")
+        return SCREEN_KEY_UP;
+    if (tok == "down")
+        return SCREEN_KEY_DOWN;
+    if (tok == "pgup")
+        return SCREEN_KEY_PPAGE;
+    if (tok == "pgdn")
+        return SCREEN_KEY_NPAGE;
+    return -1;
+}
+
+static Action parse_action(const std::string &name) {
+    for (int i = 0; i < ACTION_COUNT; i++)
+        if (name == ACTION_NAMES[i])
+            return static_cast<Action>(i);
+    return Action::COUNT;
+}
+
+void keymap_init(const std::string &path) {
+    bind_defaults();
+    std::ifstream in(path);
+    if (!in)
+        return;
+    std::string line;
+    int lineno = 0;
+    while (std::getline(in, line)) {
+        lineno++;
+        std::istringstream ss(line);
+        std::string key_tok, action_tok;
+        if (!(ss >> key_tok) || key_tok[0] == '#')
+            continue;
+        ss >> action_tok;
+        int key = parse_key(key_tok);
+        Action a = parse_action(action_tok);
+        if (key < 0 || a == Action::COUNT) {
+            std::cerr << path << ":" << lineno << ": ignoring bad binding '" << line << "'\n";
+            continue;
+        }
+        bind_key(key, a);
+    }
+}
@@ -0,0 +1,146 @@
+#include "compositor.h"
+#include "render.h"
+#include "fov.h"
+#include "global.h"
+#include "character.h"
+#include "ui.h"
+#include <cstring>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+template <typename T>
+using layer_t = std::array<std::array<T, FB_STRIDE>, HEIGHT>;
+
+alignas(16) static layer_t<char> terrain_layer;
+alignas(16) static layer_t<uint8_t> visible_layer;
+alignas(16) static layer_t<uint8_t> explored_layer;
+alignas(16) static layer_t<char> object_glyph;
+alignas(16) static layer_t<uint8_t> object_color;
+alignas(16) static layer_t<char> monster_glyph;
+alignas(16) static layer_t<uint8_t> monster_color;
+
+// expand_bits[b] has byte i set to 0xFF when bit i of b is set.
+static const std::array<uint64_t, 256> expand_bits = [](){
+    std::array<uint64_t, 256> tmp{};
+    for (int b = 0; b < 256; b++)
+        for (int i = 0; i < 8; i++)
+            if (b & (1 << i))
+                tmp[b] |= uint64_t(0xFF) << (8 * i);
+    return tmp;
+}();
+
+static void expand_layer(const cell_bits_t &bits, layer_t<uint8_t> &layer) {
+    for (int y = 0; y < HEIGHT; y++) {
+        uint8_t* out = layer[y].data();
+        for (int x = 0; x < FB_STRIDE; x += 8) {
+            uint64_t bytes = 0;
+            if (x < WIDTH) {
+                uint64_t word = bits[y][x >> 6];
+                bytes = expand_bits[(word >> (x & 63)) & 0xFF];
+            }
+            std::memcpy(out + x, &bytes, 8);
+        }
+    }
+}
+
+// With fog off everything is visible and the explored mask is not needed.
+static void build_visibility_layers() {
+    if (fog_toggle) {
+        std::memset(&visible_layer, 0xFF, sizeof(visible_layer));
+        return;
+    }
+    expand_layer(pc_visible, visible_layer);
+    expand_layer(pc_explored, explored_layer);
+}
+
+static void build_overlays() {
+    std::memset(&object_glyph, 0, sizeof(object_glyph));
+    std::memset(&object_color, 0, sizeof(object_color));
+    std::memset(&monster_glyph, 0, sizeof(monster_glyph));
+    std::memset(&monster_color, 0, sizeof(monster_color));
+
+    // On a stacked cell only the object object_map points at shows.
+    for (int i = 0; i < static_cast<int>(object_instances.size()); i++) {
+        const ObjectInstance &obj = object_instances[i];
+        if (object_map[obj.y][obj.x] != i || !visible_layer[obj.y][obj.x])
+            continue;
+        object_glyph[obj.y][obj.x] = obj.symbol;
+        object_color[obj.y][obj.x] = get_color_pair(obj.color);
+    }
+    for (const auto &ch : characters) {
+        if (!ch.alive || !visible_layer[ch.y][ch.x])
+            continue;
+        if (ch.type == CharType::PC) {
+            monster_glyph[ch.y][ch.x] = '@';
+            monster_color[ch.y][ch.x] = 9;  // PC: white on blue
+        } else {
+            monster_glyph[ch.y][ch.x] = ch.symbol;
+            monster_color[ch.y][ch.x] = get_color_pair(ch.color);
+        }
+    }
+}
+
+static void merge_row(int y) {
+    const char* terrain = terrain_layer[y].data();
+    const uint8_t* vis = visible_layer[y].data();
+    const uint8_t* seen = explored_layer[y].data();
+    const char* og = object_glyph[y].data();
+    const uint8_t* oc = object_color[y].data();
+    const char* mg = monster_glyph[y].data();
+    const uint8_t* mc = monster_color[y].data();
+    char* out_g = render_next.glyph[y].data();
+    uint8_t* out_c = render_next.color[y].data();
+
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i blank = _mm_set1_epi8(' ');
+    auto ld = [](const void* p) { return _mm_load_si128(static_cast<const __m128i*>(p)); };
+    auto select = [](__m128i mask, __m128i a, __m128i b) {
+        return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+    };
+    for (int x = 0; x < FB_STRIDE; x += 16) {
+        __m128i v = ld(vis + x);
+        __m128i known = _mm_or_si128(v, ld(seen + x));
+        __m128i g = select(known, ld(terrain + x), blank);
+        __m128i c = zero;
+
+        __m128i obj_g = ld(og + x);
+        __m128i obj_mask = _mm_andnot_si128(_mm_cmpeq_epi8(obj_g, zero), v);
+        g = select(obj_mask, obj_g, g);
+        c = select(obj_mask, ld(oc + x), c);
+
+        __m128i mon_g = ld(mg + x);
+        __m128i mon_mask = _mm_andnot_si128(_mm_cmpeq_epi8(mon_g, zero), v);
+        g = select(mon_mask, mon_g, g);
+        c = select(mon_mask, ld(mc + x), c);
+
+        _mm_store_si128(reinterpret_cast<__m128i*>(out_g + x), g);
+        _mm_store_si128(reinterpret_cast<__m128i*>(out_c + x), c);
+    }
+#else
+    for (int x = 0; x < FB_STRIDE; x++) {
+        uint8_t v = vis[x];
+        uint8_t known = v | seen[x];
+        char g = static_cast<char>((terrain[x] & known) | (' ' & ~known));
+        uint8_t c = 0;
+        uint8_t obj_mask = og[x] ? v : 0;
+        g = static_cast<char>((og[x] & obj_mask) | (g & ~obj_mask));
+        c = static_cast<uint8_t>((oc[x] & obj_mask) | (c & ~obj_mask));
+        uint8_t mon_mask = mg[x] ? v : 0;
+        g = static_cast<char>((mg[x] & mon_mask) | (g & ~mon_mask));
+        c = static_cast<uint8_t>((mc[x] & mon_mask) | (c & ~mon_mask));
+        out_g[x] = g;
+        out_c[x] = c;
+    }
+#endif
+}
+
+void compose_frame() {
+    for (int y = 0; y < HEIGHT; y++)
+        std::memcpy(terrain_layer[y].data(), base_map[y].data(), WIDTH);
+    build_visibility_layers();
+    build_overlays();
+    for (int y = 0; y < HEIGHT; y++)
+        merge_row(y);
+}
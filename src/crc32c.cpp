@@ -0,0 +1,39 @@
+#include "crc32c.h"
+#include <array>
+#include <cstring>
+#if defined(__SSE4_2__)
+#include <nmmintrin.h>
+#endif
+
+#if !defined(__SSE4_2__)
+// Byte-at-a-time table for the reflected polynomial 0x82F63B78.
+static const std::array<uint32_t, 256> crc_table = [](){
+    std::array<uint32_t, 256> tmp{};
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++)
+            c = (c >> 1) ^ (c & 1 ? 0x82F63B78u : 0);
+        tmp[i] = c;
+    }
+    return tmp;
+}();
+#endif
+
+uint32_t crc32c(const void* data, size_t len, uint32_t crc) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    crc = ~crc;
+#if defined(__SSE4_2__)
+    // The CPU does eight bytes per instruction.
+    for (; len >= 8; len -= 8, p += 8) {
+        uint64_t word;
+        std::memcpy(&word, p, 8);
+        crc = static_cast<uint32_t>(_mm_crc32_u64(crc, word));
+    }
+    for (; len > 0; len--, p++)
+        crc = _mm_crc32_u8(crc, *p);
+#else
+    for (; len > 0; len--, p++)
+        crc = crc_table[(crc ^ *p) & 0xFF] ^ (crc >> 8);
+#endif
+    return ~crc;
+}
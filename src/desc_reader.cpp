@@ -0,0 +1,162 @@
+#include "desc_reader.h"
+#include <climits>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+DescReader::DescReader(const std::string& path) : path(path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return;
+    struct stat st;
+    if (fstat(fd, &st) == 0) {
+        size = static_cast<size_t>(st.st_size);
+        if (size == 0) {
+            opened = true;
+        } else {
+            void* p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED) {
+                data = static_cast<const char*>(p);
+                madvise(p, size, MADV_SEQUENTIAL);
+                opened = true;
+            }
+        }
+    }
+    close(fd);
+}
+
+DescReader::~DescReader() {
+    if (data)
+        munmap(const_cast<char*>(data), size);
+}
+
+bool DescReader::next_line(std::string_view& line) {
+    if (!data || pos >= size)
+        return false;
+    const char* start = data + pos;
+    const char* nl = static_cast<const char*>(std::memchr(start, '\n', size - pos));
+    size_t len = nl ? static_cast<size_t>(nl - start) : size - pos;
+    pos += nl ? len + 1 : len;
+    if (len > 0 && start[len - 1] == '\r')
+        len--;
+    line = std::string_view(start, len);
+    line_no++;
+    return true;
+}
+
+void DescReader::error(const std::string& what, int line) const {
+    std::cerr << path << ":" << (line ? line : line_no) << ": " << what << "\n";
+}
+
+static bool is_space(char c) {
+    return c == ' ' || c == '\t';
+}
+
+std::string_view desc_trim(std::string_view rest) {
+    size_t i = 0;
+    while (i < rest.size() && is_space(rest[i]))
+        i++;
+    return rest.substr(i);
+}
+
+std::string_view desc_word(std::string_view& rest) {
+    rest = desc_trim(rest);
+    size_t i = 0;
+    while (i < rest.size() && !is_space(rest[i]))
+        i++;
+    std::string_view word = rest.substr(0, i);
+    rest = rest.substr(i);
+    return word;
+}
+
+bool desc_number(std::string_view& s, int& out) {
+    size_t i = 0;
+    bool negative = i < s.size() && s[i] == '-';
+    if (negative)
+        i++;
+    if (i == s.size() || s[i] < '0' || s[i] > '9')
+        return false;
+    long long v = 0;
+    for (; i < s.size() && s[i] >= '0' && s[i] <= '9'; i++) {
+        v = v * 10 + (s[i] - '0');
+        if (v > INT_MAX)
+            return false;
+    }
+    out = static_cast<int>(negative ? -v : v);
+    s = s.substr(i);
+    return true;
+}
+
+// By length, then first letter, so most words are settled by at most two
+// comparisons.
+DescKey desc_key(std::string_view w) {
+    switch (w.size()) {
+    case 2:
+        if (w == "HP") return KEY_HP;
+        break;
+    case 3:
+        switch (w[0]) {
+        case 'D':
+            if (w == "DAM") return KEY_DAM;
+            if (w == "DEF") return KEY_DEF;
+            break;
+        case 'H': if (w == "HIT") return KEY_HIT; break;
+        case 'V': if (w == "VAL") return KEY_VAL; break;
+        case 'A': if (w == "ART") return KEY_ART; break;
+        }
+        break;
+    case 4:
+        switch (w[0]) {
+        case 'N': if (w == "NAME") return KEY_NAME; break;
+        case 'D': if (w == "DESC") return KEY_DESC; break;
+        case 'S': if (w == "SYMB") return KEY_SYMB; break;
+        case 'R': if (w == "RRTY") return KEY_RRTY; break;
+        case 'T': if (w == "TYPE") return KEY_TYPE; break;
+        case 'A':
+            if (w == "ABIL") return KEY_ABIL;
+            if (w == "ATTR") return KEY_ATTR;
+            break;
+        }
+        break;
+    case 5:
+        switch (w[0]) {
+        case 'C': if (w == "COLOR") return KEY_COLOR; break;
+        case 'S': if (w == "SPEED") return KEY_SPEED; break;
+        case 'D': if (w == "DODGE") return KEY_DODGE; break;
+        }
+        break;
+    case 6:
+        if (w == "WEIGHT") return KEY_WEIGHT;
+        break;
+    }
+    return KEY_UNKNOWN;
+}
+
+const char* desc_key_name(DescKey key) {
+    static const char* names[] = {"NAME", "DESC", "SYMB", "COLOR", "SPEED", "DAM", "RRTY",
+                                  "ABIL", "HP", "TYPE", "HIT", "DODGE", "DEF", "WEIGHT",
+                                  "ATTR", "VAL", "ART", "?"};
+    return names[key];
+}
+
+std::string desc_missing(uint32_t want, uint32_t seen) {
+    std::string what = "missing";
+    for (int k = 0; k < KEY_UNKNOWN; k++) {
+        if ((want & ~seen) >> k & 1) {
+            what += ' ';
+            what += desc_key_name(static_cast<DescKey>(k));
+        }
+    }
+    return what;
+}
+
+void desc_read_text(DescReader& in, std::string& text) {
+    std::string_view line;
+    while (in.next_line(line) && line != ".") {
+        text.append(line);
+        text += '\n';
+    }
+}
@@ -1,22 +1,19 @@
 #include "dungeon.h"
 #include "global.h"
+#include "fov.h"
+#include "los.h"
+#include "fileio.h"
+#include "rng.h"
+#include "occupancy.h"
 #include <cstdlib>
 #include <cstdio>
 #include <cstring>
-#include <fstream>
+#include <cerrno>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
 #include <stdint.h>
-#ifdef __APPLE__
-  #include <libkern/OSByteOrder.h>
-  #define be32toh(x) OSSwapBigToHostInt32(x)
-  #define htobe32(x) OSSwapHostToBigInt32(x)
-  #define be16toh(x) OSSwapBigToHostInt16(x)
-  #define htobe16(x) OSSwapHostToBigInt16(x)
-#else
-  #include <endian.h>
-#endif
+#include <vector>
 
 
 
@@ -51,7 +48,7 @@ void initializeDungeon() {
                 hardness[y][x] = 255;
             } else {
                 dungeon[y][x] = ' ';
-                hardness[y][x] = (rand() % 254) + 1;
+                hardness[y][x] = rng_below(RngStream::Level, 254) + 1;
             }
         }
     }
@@ -61,10 +58,10 @@ void generateRooms() {
     int attempts = 2000;
     int c = 0;
     while (attempts > 0 && c < 6) {
-        int rw = (rand() % 6) + 4;
-        int rh = (rand() % 4) + 3;
-        int rx = (rand() % (WIDTH - rw - 2)) + 1;
-        int ry = (rand() % (HEIGHT - rh - 2)) + 1;
+        int rw = rng_below(RngStream::Level, 6) + 4;
+        int rh = rng_below(RngStream::Level, 4) + 3;
+        int rx = rng_below(RngStream::Level, WIDTH - rw - 2) + 1;
+        int ry = rng_below(RngStream::Level, HEIGHT - rh - 2) + 1;
         if (isValidRoom(rw, rh, rx, ry)) {
             fillRoom(rw, rh, rx, ry);
             room_x[c] = rx; room_y[c] = ry;
@@ -107,8 +104,8 @@ void connectRoomsViaCorridor() {
 void placeStairs() {
     bool flag = true, upFlag = false, downFlag = false;
     while (flag) {
-        int up_x = rand() % WIDTH, up_y = rand() % HEIGHT;
-        int down_x = rand() % WIDTH, down_y = rand() % HEIGHT;
+        int up_x = rng_below(RngStream::Level, WIDTH), up_y = rng_below(RngStream::Level, HEIGHT);
+        int down_x = rng_below(RngStream::Level, WIDTH), down_y = rng_below(RngStream::Level, HEIGHT);
         if ((dungeon[up_y][up_x] == '.' || dungeon[up_y][up_x] == '#') && !upFlag) {
             dungeon[up_y][up_x] = '<';
             up_xCoord = up_x; up_yCoord = up_y;
@@ -129,81 +126,162 @@ void placePC(int x, int y) {
     dungeon[y][x] = '@';
 }
 
-void load_dungeon(const char* path) {
-    std::ifstream in(path, std::ios::binary);
-    if (!in) {
-        std::cerr << "Error opening file: " << path << std::endl;
-        exit(1);
+void carve_corridor(int x, int y) {
+    set_hardness(x, y, 0);
+    dungeon[y][x] = '#';
+    base_map[y][x] = '#';
+    fov_terrain_changed(x, y);
+    los_terrain_changed(x, y);
+}
+
+// Fixed part of the file: marker, version, size, PC position, hardness.
+static const size_t FILE_HEADER_LEN = MARKER_LEN + 4 + 4 + 2 + WIDTH * HEIGHT;
+
+// Bounds-checked cursor over a loaded file. Reads past the end return 0
+// and clear ok, so fields can be read first and checked once at the end.
+struct file_reader_t {
+    const uint8_t* p;
+    size_t left;
+    bool ok = true;
+
+    file_reader_t(const std::vector<uint8_t> &buf) : p(buf.data()), left(buf.size()) {}
+
+    const uint8_t* take(size_t n) {
+        if (!ok || left < n) {
+            ok = false;
+            return nullptr;
+        }
+        const uint8_t* at = p;
+        p += n;
+        left -= n;
+        return at;
+    }
+    uint8_t u8() {
+        const uint8_t* b = take(1);
+        return b ? b[0] : 0;
+    }
+    uint16_t u16() {
+        const uint8_t* b = take(2);
+        return b ? static_cast<uint16_t>(b[0] << 8 | b[1]) : 0;
+    }
+    uint32_t u32() {
+        const uint8_t* b = take(4);
+        return b ? static_cast<uint32_t>(b[0]) << 24 | b[1] << 16 | b[2] << 8 | b[3] : 0;
+    }
+};
+
+static void put_u16(std::vector<uint8_t> &out, uint16_t v) {
+    out.push_back(v >> 8);
+    out.push_back(v & 0xFF);
+}
+
+static void put_u32(std::vector<uint8_t> &out, uint32_t v) {
+    put_u16(out, v >> 16);
+    put_u16(out, v & 0xFFFF);
+}
+
+static bool in_map(int x, int y) {
+    return x >= 0 && x < WIDTH && y >= 0 && y < HEIGHT;
+}
+
+bool load_dungeon(const char* path) {
+    std::vector<uint8_t> buf;
+    if (!read_file(path, buf)) {
+        std::cerr << "Error opening file: " << path << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+    return load_dungeon_from(buf, path);
+}
+
+// Nothing is changed unless the whole file checks out.
+bool load_dungeon_from(const std::vector<uint8_t> &buf, const char* path) {
+    if (buf.size() < FILE_HEADER_LEN) {
+        std::cerr << "Truncated dungeon file: " << path << std::endl;
+        return false;
     }
-    char marker[MARKER_LEN + 1];
-    in.read(marker, MARKER_LEN);
-    marker[MARKER_LEN] = '\0';
-    if (strcmp(marker, FILE_MARKER) != 0) {
+    file_reader_t in(buf);
+    if (memcmp(in.take(MARKER_LEN), FILE_MARKER, MARKER_LEN) != 0) {
         std::cerr << "Invalid marker" << std::endl;
-        in.close();
-        exit(1);
+        return false;
     }
-    uint32_t version;
-    in.read(reinterpret_cast<char*>(&version), sizeof(version));
-    version = be32toh(version);
-    if (version != FILE_VERSION) {
+    if (in.u32() != FILE_VERSION) {
         std::cerr << "Unsupported file version" << std::endl;
-        in.close();
-        exit(1);
+        return false;
     }
-    uint32_t file_size;
-    in.read(reinterpret_cast<char*>(&file_size), sizeof(file_size));
-    file_size = be32toh(file_size);
-    
-    uint8_t pcx, pcy;
-    in.read(reinterpret_cast<char*>(&pcx), 1);
-    in.read(reinterpret_cast<char*>(&pcy), 1);
-    pc_x = pcx; pc_y = pcy;
-    
-    for (int y = 0; y < HEIGHT; y++) {
-        for (int x = 0; x < WIDTH; x++) {
-            uint8_t h;
-            in.read(reinterpret_cast<char*>(&h), 1);
-            hardness[y][x] = h;
+    // Earlier saves left the room count out of the size, so accept that too.
+    uint32_t file_size = in.u32();
+    if (file_size != buf.size() && file_size + 2 != buf.size()) {
+        std::cerr << "File size " << file_size << " does not match " << buf.size()
+                  << " bytes on disk" << std::endl;
+        return false;
+    }
+
+    int pcx = in.u8(), pcy = in.u8();
+    const uint8_t* hard = in.take(WIDTH * HEIGHT);
+
+    int rooms = in.u16();
+    if (rooms > MAX_ROOMS) {
+        std::cerr << "Too many rooms: " << rooms << std::endl;
+        return false;
+    }
+    std::array<uint8_t, MAX_ROOMS * 4> room_bytes{};
+    bool rooms_ok = true;
+    for (int i = 0; i < rooms; i++) {
+        const uint8_t* r = in.take(4);
+        if (!r)
+            break;
+        std::memcpy(&room_bytes[i * 4], r, 4);
+        rooms_ok = rooms_ok && r[2] > 0 && r[3] > 0 &&
+                   in_map(r[0], r[1]) && in_map(r[0] + r[2] - 1, r[1] + r[3] - 1);
+    }
+
+    // The game only has one staircase each way; extra ones are skipped.
+    int stairs[2][3] = {};  // count, x, y for up then down
+    bool stairs_ok = true;
+    for (auto &st : stairs) {
+        st[0] = in.u16();
+        for (int i = 0; i < st[0] && in.ok; i++) {
+            int sx = in.u8(), sy = in.u8();
+            stairs_ok = stairs_ok && in_map(sx, sy);
+            if (i == 0) {
+                st[1] = sx;
+                st[2] = sy;
+            }
         }
     }
-    uint16_t r;
-    in.read(reinterpret_cast<char*>(&r), sizeof(r));
-    r = be16toh(r);
-    room_count = 0;
-    for (int i = 0; i < r && i < MAX_ROOMS; i++) {
-        uint8_t rx, ry, rw, rh;
-        in.read(reinterpret_cast<char*>(&rx), 1);
-        in.read(reinterpret_cast<char*>(&ry), 1);
-        in.read(reinterpret_cast<char*>(&rw), 1);
-        in.read(reinterpret_cast<char*>(&rh), 1);
-        room_x[i] = rx; room_y[i] = ry;
-        room_w[i] = rw; room_h[i] = rh;
-        room_count++;
+
+    if (!in.ok || in.left != 0) {
+        std::cerr << "Malformed dungeon file: " << path << std::endl;
+        return false;
     }
-    uint16_t u;
-    in.read(reinterpret_cast<char*>(&u), sizeof(u));
-    u = be16toh(u);
-    upCount = 0;
-    if (u > 0) {
-        uint8_t sx, sy;
-        in.read(reinterpret_cast<char*>(&sx), 1);
-        in.read(reinterpret_cast<char*>(&sy), 1);
-        upCount = 1; up_xCoord = sx; up_yCoord = sy;
+    if (!in_map(pcx, pcy) || !rooms_ok || !stairs_ok) {
+        std::cerr << "Dungeon file has positions outside the map" << std::endl;
+        return false;
     }
-    uint16_t d;
-    in.read(reinterpret_cast<char*>(&d), sizeof(d));
-    d = be16toh(d);
-    downCount = 0;
-    if (d > 0) {
-        uint8_t sx, sy;
-        in.read(reinterpret_cast<char*>(&sx), 1);
-        in.read(reinterpret_cast<char*>(&sy), 1);
-        downCount = 1; down_xCoord = sx; down_yCoord = sy;
+
+    pc_x = pcx;
+    pc_y = pcy;
+    for (int y = 0; y < HEIGHT; y++)
+        for (int x = 0; x < WIDTH; x++)
+            hardness[y][x] = hard[y * WIDTH + x];
+    room_count = rooms;
+    for (int i = 0; i < rooms; i++) {
+        room_x[i] = room_bytes[i * 4];
+        room_y[i] = room_bytes[i * 4 + 1];
+        room_w[i] = room_bytes[i * 4 + 2];
+        room_h[i] = room_bytes[i * 4 + 3];
     }
-    in.close();
-    
-    // Rebuild dungeon array from hardness and room data.
+    upCount = stairs[0][0] > 0 ? 1 : 0;
+    up_xCoord = stairs[0][1];
+    up_yCoord = stairs[0][2];
+    downCount = stairs[1][0] > 0 ? 1 : 0;
+    down_xCoord = stairs[1][1];
+    down_yCoord = stairs[1][2];
+    rebuild_level_map();
+    return true;
+}
+
+void rebuild_level_map() {
     for (int yy = 0; yy < HEIGHT; yy++) {
         for (int xx = 0; xx < WIDTH; xx++) {
             if (hardness[yy][xx] == 255)
@@ -227,56 +305,45 @@ void load_dungeon(const char* path) {
         dungeon[down_yCoord][down_xCoord] = '>';
 }
 
-void save_dungeon(const char* path) {
-    std::ofstream out(path, std::ios::binary);
-    if (!out) {
-        std::cerr << "Error opening file for writing" << std::endl;
-        return;
-    }
-    out.write(FILE_MARKER, MARKER_LEN);
-    uint32_t version_be = htobe32(FILE_VERSION);
-    out.write(reinterpret_cast<const char*>(&version_be), sizeof(version_be));
-    
+// The file is assembled in memory and written with one write().
+bool save_dungeon(const char* path) {
     uint16_t up_stairs_count = (upCount > 0) ? 1 : 0;
     uint16_t down_stairs_count = (downCount > 0) ? 1 : 0;
-    uint32_t file_size = 1702 + (room_count * 4) + 2 + (up_stairs_count * 2) + 2 + (down_stairs_count * 2);
-    uint32_t file_size_be = htobe32(file_size);
-    out.write(reinterpret_cast<const char*>(&file_size_be), sizeof(file_size_be));
-    
-    uint8_t pcx = pc_x, pcy = pc_y;
-    out.write(reinterpret_cast<const char*>(&pcx), 1);
-    out.write(reinterpret_cast<const char*>(&pcy), 1);
-    
-    for (int y = 0; y < HEIGHT; y++) {
-        for (int x = 0; x < WIDTH; x++) {
-            uint8_t hh = hardness[y][x];
-            out.write(reinterpret_cast<const char*>(&hh), 1);
-        }
-    }
-    uint16_t r_be = htobe16(room_count);
-    out.write(reinterpret_cast<const char*>(&r_be), sizeof(r_be));
+    uint32_t file_size = FILE_HEADER_LEN + 2 + room_count * 4 +
+                         2 + up_stairs_count * 2 + 2 + down_stairs_count * 2;
+
+    std::vector<uint8_t> out(FILE_MARKER, FILE_MARKER + MARKER_LEN);
+    out.reserve(file_size);
+    put_u32(out, FILE_VERSION);
+    put_u32(out, file_size);
+    out.push_back(static_cast<uint8_t>(pc_x));
+    out.push_back(static_cast<uint8_t>(pc_y));
+    for (int y = 0; y < HEIGHT; y++)
+        for (int x = 0; x < WIDTH; x++)
+            out.push_back(static_cast<uint8_t>(hardness[y][x]));
+    put_u16(out, room_count);
     for (int i = 0; i < room_count; i++) {
-        uint8_t rx = room_x[i], ry = room_y[i], rw = room_w[i], rh = room_h[i];
-        out.write(reinterpret_cast<const char*>(&rx), 1);
-        out.write(reinterpret_cast<const char*>(&ry), 1);
-        out.write(reinterpret_cast<const char*>(&rw), 1);
-        out.write(reinterpret_cast<const char*>(&rh), 1);
+        out.push_back(static_cast<uint8_t>(room_x[i]));
+        out.push_back(static_cast<uint8_t>(room_y[i]));
+        out.push_back(static_cast<uint8_t>(room_w[i]));
+        out.push_back(static_cast<uint8_t>(room_h[i]));
     }
-    uint16_t up_be = htobe16(up_stairs_count);
-    out.write(reinterpret_cast<const char*>(&up_be), sizeof(up_be));
+    put_u16(out, up_stairs_count);
     if (up_stairs_count == 1) {
-        uint8_t sx = static_cast<uint8_t>(up_xCoord), sy = static_cast<uint8_t>(up_yCoord);
-        out.write(reinterpret_cast<const char*>(&sx), 1);
-        out.write(reinterpret_cast<const char*>(&sy), 1);
+        out.push_back(static_cast<uint8_t>(up_xCoord));
+        out.push_back(static_cast<uint8_t>(up_yCoord));
+    }
+    put_u16(out, down_stairs_count);
+    if (down_stairs_count == 1) {
+        out.push_back(static_cast<uint8_t>(down_xCoord));
+        out.push_back(static_cast<uint8_t>(down_yCoord));
     }
-    uint16_t down_be = htobe16(downCount > 0 ? 1 : 0);
-    out.write(reinterpret_cast<const char*>(&down_be), sizeof(down_be));
-    if (downCount > 0) {
-        uint8_t sx = static_cast<uint8_t>(down_xCoord), sy = static_cast<uint8_t>(down_yCoord);
-        out.write(reinterpret_cast<const char*>(&sx), 1);
-        out.write(reinterpret_cast<const char*>(&sy), 1);
+
+    if (!write_file(path, out)) {
+        std::cerr << "Error writing " << path << ": " << strerror(errno) << std::endl;
+        return false;
     }
-    out.close();
+    return true;
 }
 
 void checkDir() {
@@ -0,0 +1,79 @@
+#include "fileio.h"
+#include <cerrno>
+#include <cstdio>
+#include <string>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+bool read_file(const char* path, std::vector<uint8_t> &buf) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    bool ok = fstat(fd, &st) == 0;
+    if (ok) {
+        buf.resize(st.st_size);
+        size_t got = 0;
+        while (ok && got < buf.size()) {
+            ssize_t n = read(fd, buf.data() + got, buf.size() - got);
+            if (n < 0 && errno == EINTR)
+                continue;
+            ok = n > 0;
+            if (ok)
+                got += n;
+        }
+    }
+    close(fd);
+    return ok;
+}
+
+bool write_all(int fd, const std::vector<uint8_t> &buf) {
+    size_t put = 0;
+    while (put < buf.size()) {
+        ssize_t n = write(fd, buf.data() + put, buf.size() - put);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        put += n;
+    }
+    return true;
+}
+
+bool write_file(const char* path, const std::vector<uint8_t> &buf) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd < 0)
+        return false;
+    bool ok = write_all(fd, buf);
+    return close(fd) == 0 && ok;
+}
+
+static bool fsync_dir_of(const std::string &path) {
+    size_t slash = path.rfind('/');
+    std::string dir = slash == std::string::npos ? "." : path.substr(0, slash + 1);
+    int fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd < 0)
+        return false;
+    bool ok = fsync(fd) == 0;
+    close(fd);
+    return ok;
+}
+
+bool write_file_atomic(const char* path, const std::vector<uint8_t> &buf) {
+    std::string tmp = std::string(path) + ".tmp";
+    int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd < 0)
+        return false;
+    bool ok = write_all(fd, buf);
+    ok = ok && fsync(fd) == 0;
+    ok = close(fd) == 0 && ok;
+    ok = ok && rename(tmp.c_str(), path) == 0;
+    if (!ok) {
+        int saved = errno;
+        unlink(tmp.c_str());
+        errno = saved;
+        return false;
+    }
+    return fsync_dir_of(path);
+}
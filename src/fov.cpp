@@ -0,0 +1,135 @@
+#include "fov.h"
+#include "global.h"
+#include <vector>
+
+cell_bits_t pc_visible = [](){
+    cell_bits_t tmp;
+    bits_clear_all(tmp);
+    return tmp;
+}();
+
+cell_bits_t pc_explored = [](){
+    cell_bits_t tmp;
+    bits_clear_all(tmp);
+    return tmp;
+}();
+
+// Octant transforms: map (col, row) in octant space to map offsets.
+static const int mult[4][8] = {
+    {1, 0, 0, -1, -1, 0, 0, 1},
+    {0, 1, -1, 0, 0, -1, 1, 0},
+    {0, 1, 1, 0, 0, -1, -1, 0},
+    {1, 0, 0, 1, -1, 0, 0, -1},
+};
+
+struct octant_cache_t {
+    bool valid = false;
+    int ox = -1, oy = -1;
+    unsigned gen = 0;
+    std::vector<int> cells;  // y * WIDTH + x of every lit cell
+};
+
+static std::array<octant_cache_t, 8> octants;
+static int lit_x = -1, lit_y = -1;  // origin pc_visible was built for
+static std::vector<int> lit_cells;  // bits currently set in pc_visible
+
+static bool blocks_light(int x, int y) {
+    if (x < 0 || x >= WIDTH || y < 0 || y >= HEIGHT)
+        return true;
+    return hardness[y][x] > 0;
+}
+
+static void cast_light(int oct, int cx, int cy, int row, float start, float end,
+                       std::vector<int> &out) {
+    if (start < end)
+        return;
+    int xx = mult[0][oct], xy = mult[1][oct], yx = mult[2][oct], yy = mult[3][oct];
+    float new_start = 0.0f;
+    for (int j = row; j <= LIGHT_RADIUS; j++) {
+        int dx = -j - 1, dy = -j;
+        bool blocked = false;
+        while (dx <= 0) {
+            dx++;
+            int mx = cx + dx * xx + dy * xy;
+            int my = cy + dx * yx + dy * yy;
+            float l_slope = (dx - 0.5f) / (dy + 0.5f);
+            float r_slope = (dx + 0.5f) / (dy - 0.5f);
+            if (start < r_slope)
+                continue;
+            if (end > l_slope)
+                break;
+            if (mx >= 0 && mx < WIDTH && my >= 0 && my < HEIGHT)
+                out.push_back(my * WIDTH + mx);
+            bool opaque = blocks_light(mx, my);
+            if (blocked) {
+                if (opaque) {
+                    new_start = r_slope;
+                } else {
+                    blocked = false;
+                    start = new_start;
+                }
+            } else if (opaque && j < LIGHT_RADIUS) {
+                blocked = true;
+                cast_light(oct, cx, cy, j + 1, start, l_slope, out);
+                new_start = r_slope;
+            }
+        }
+        if (blocked)
+            break;
+    }
+}
+
+void fov_update() {
+    bool changed = (lit_x != pc_x || lit_y != pc_y);
+    for (int oct = 0; oct < 8; oct++) {
+        octant_cache_t &c = octants[oct];
+        if (c.valid && c.ox == pc_x && c.oy == pc_y && c.gen == terrain_generation)
+            continue;
+        c.cells.clear();
+        cast_light(oct, pc_x, pc_y, 1, 1.0f, 0.0f, c.cells);
+        c.valid = true;
+        c.ox = pc_x;
+        c.oy = pc_y;
+        c.gen = terrain_generation;
+        changed = true;
+    }
+    if (!changed)
+        return;
+
+    for (int cell : lit_cells)
+        bit_clear(pc_visible, cell % WIDTH, cell / WIDTH);
+    lit_cells.clear();
+    lit_cells.push_back(pc_y * WIDTH + pc_x);
+    for (const auto &c : octants)
+        lit_cells.insert(lit_cells.end(), c.cells.begin(), c.cells.end());
+    for (int cell : lit_cells)
+        bit_set(pc_visible, cell % WIDTH, cell / WIDTH);
+    lit_x = pc_x;
+    lit_y = pc_y;
+}
+
+bool fov_visible(int x, int y) {
+    if (x < 0 || x >= WIDTH || y < 0 || y >= HEIGHT)
+        return false;
+    return bit_test(pc_visible, x, y);
+}
+
+bool pc_can_see(int x, int y) {
+    return fog_toggle || fov_visible(x, y);
+}
+
+void fov_terrain_changed(int x, int y) {
+    for (int oct = 0; oct < 8; oct++) {
+        octant_cache_t &c = octants[oct];
+        if (!c.valid)
+            continue;
+        // Undo the octant transform (it is orthogonal, so the inverse is
+        // the transpose) and check the cell lies in this octant's wedge:
+        // rows 1..LIGHT_RADIUS, columns -row..0.
+        int ox = x - c.ox, oy = y - c.oy;
+        int dx = ox * mult[0][oct] + oy * mult[2][oct];
+        int dy = ox * mult[1][oct] + oy * mult[3][oct];
+        if (dy <= -1 && dy >= -LIGHT_RADIUS && dx >= dy && dx <= 0)
+            c.valid = false;
+    }
+}
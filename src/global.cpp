@@ -5,15 +5,7 @@
 std::array<std::array<char, WIDTH>, HEIGHT> dungeon;
 std::array<std::array<int, WIDTH>, HEIGHT> hardness;
 std::array<std::array<char, WIDTH>, HEIGHT> base_map;
-
-// Initialize fog_map with spaces so that unseen cells display as blank.
-std::array<std::array<char, WIDTH>, HEIGHT> fog_map = [](){
-    std::array<std::array<char, WIDTH>, HEIGHT> tmp;
-    for (int i = 0; i < HEIGHT; i++) {
-        tmp[i].fill(' ');
-    }
-    return tmp;
-}();
+unsigned terrain_generation = 0;
 
 bool fog_toggle = false;  // Fog is active by default
 
@@ -32,6 +24,20 @@ int down_xCoord = 0, down_yCoord = 0;
 
 std::array<std::array<int, WIDTH>, HEIGHT> disTunneling;
 std::array<std::array<int, WIDTH>, HEIGHT> disNonTunneling;
+
+static std::array<std::array<int, WIDTH>, HEIGHT> empty_index_map() {
+    std::array<std::array<int, WIDTH>, HEIGHT> tmp;
+    for (auto &row : tmp)
+        row.fill(-1);
+    return tmp;
+}
+std::array<std::array<int, WIDTH>, HEIGHT> char_map = empty_index_map();
+std::array<std::array<int, WIDTH>, HEIGHT> object_map = empty_index_map();
+
+int dungeon_depth = 0;
+
+bool level_changed = false;
+bool game_quit = false;
 std::vector<MonsterTemplate> monster_templates;
 
 std::vector<ObjectInstance> object_instances;
@@ -0,0 +1,612 @@
+#include "journal.h"
+#include "global.h"
+#include "snapshot.h"
+#include "fileio.h"
+#include "crc32c.h"
+#include "rng.h"
+#include "renderer.h"
+#include "render.h"
+#include "message_log.h"
+#include "metrics.h"
+#include "travel.h"
+#include "ui.h"
+#include "zobrist.h"
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+
+using journal_clock = std::chrono::steady_clock;
+
+static const char JOURNAL_MARKER[] = "RLG327-J2025";
+static const char RECORDING_MARKER[] = "RLG327-R2025";
+// Version 2 adds the state hash to turn records; version 1 files are
+// still read, and checked on the random streams alone.
+static const uint32_t JOURNAL_VERSION = 2;
+
+// Start of a journal or recording file. checkpoint_crc is the crc32c of
+// the whole checkpoint file a journal follows on from, so a journal left
+// behind by an older checkpoint is never replayed onto a newer one.
+// Recordings carry their snapshots inline and leave it 0.
+struct journal_header_t {
+    char marker[MARKER_LEN];
+    uint32_t version;
+    uint32_t checkpoint_crc;
+};
+static_assert(sizeof(journal_header_t) == 20, "journal header layout");
+
+// Each frame is [u32 length][u32 crc32c of payload][payload], and the
+// payload starts with its kind:
+//  'T' turn records, each as varints: PC turn, input count, each input
+//      + 1, then each stream's advance since the previous record; then
+//      (version 2) the 8-byte zobrist_hash() at the end of the turn;
+//  'S' (recordings) a varint PC turn, then a sealed snapshot.
+static const uint8_t FRAME_TURNS = 'T';
+static const uint8_t FRAME_SNAPSHOT = 'S';
+
+struct journal_turn_t {
+    int turn;
+    std::vector<int> inputs;
+    uint64_t rng[RNG_STREAMS];
+    bool hashed;
+    uint64_t state_hash;
+};
+
+struct journal_job_t {
+    uint8_t kind;
+    int turn;
+    bool restart;  // truncate the file first
+    std::vector<uint8_t> data;
+    int archive_fd;  // snapshots: for snapshot_seal()
+};
+
+class JournalTap : public InputTap {
+public:
+    bool replay(int &value) override;
+    void record(int value) override;
+};
+
+struct journal_state_t {
+    JournalTarget target = JournalTarget::None;
+    std::string checkpoint_path, journal_path;
+    bool running = false;
+    JournalTap tap;
+
+    // Game thread: the turn being played and the group being filled.
+    std::vector<int> turn_inputs;
+    uint64_t last_rng[RNG_STREAMS] = {};
+    std::vector<uint8_t> group;
+    int group_turns = 0, since_checkpoint = 0;
+    bool restart_due = false;
+
+    // Replay of what journal_recover() or journal_load_recording() read.
+    // With handover the player takes over when it is done; without, the
+    // game ends there.
+    bool loaded = false, handover = false, replaying = false, finished = false;
+    bool from_recording = false;
+    const char* source = "journal";
+    std::vector<journal_turn_t> replay_turns;
+    size_t replay_next = 0, input_next = 0;
+    int diverged_at = -1;
+    std::unique_ptr<Renderer> live_renderer;
+
+    // Writer thread; jobs are handed over under the lock.
+    std::thread writer;
+    std::mutex lock;
+    std::condition_variable wake;
+    std::deque<journal_job_t> jobs;
+    bool stop = false;
+    int failed_errno = 0;
+    int fd = -1;
+};
+
+static journal_state_t state;
+
+static void put_varint(std::vector<uint8_t> &out, uint64_t v) {
+    while (v >= 0x80) {
+        out.push_back(static_cast<uint8_t>(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(v));
+}
+
+static bool get_varint(const uint8_t* &p, const uint8_t* end, uint64_t &v) {
+    v = 0;
+    for (int shift = 0; shift < 64 && p < end; shift += 7) {
+        uint8_t b = *p++;
+        v |= static_cast<uint64_t>(b & 0x7f) << shift;
+        if (!(b & 0x80))
+            return true;
+    }
+    return false;
+}
+
+// Decode one frame's records onto turns; positions are absolute after.
+static bool decode_turns(const uint8_t* p, const uint8_t* end, uint64_t rng[RNG_STREAMS],
+                         bool hashed, std::vector<journal_turn_t> &turns) {
+    while (p < end) {
+        journal_turn_t t;
+        uint64_t turn, count, v;
+        if (!get_varint(p, end, turn) || !get_varint(p, end, count) ||
+            count > static_cast<uint64_t>(end - p))
+            return false;
+        t.turn = static_cast<int>(turn);
+        t.inputs.reserve(count);
+        for (uint64_t i = 0; i < count; i++) {
+            if (!get_varint(p, end, v))
+                return false;
+            t.inputs.push_back(static_cast<int>(v) - 1);
+        }
+        for (int s = 0; s < RNG_STREAMS; s++) {
+            if (!get_varint(p, end, v))
+                return false;
+            rng[s] += v;
+            t.rng[s] = rng[s];
+        }
+        t.hashed = hashed;
+        t.state_hash = 0;
+        if (hashed) {
+            if (end - p < static_cast<ptrdiff_t>(sizeof t.state_hash))
+                return false;
+            std::memcpy(&t.state_hash, p, sizeof t.state_hash);
+            p += sizeof t.state_hash;
+        }
+        turns.push_back(std::move(t));
+    }
+    return true;
+}
+
+struct frame_ref_t {
+    uint8_t kind;
+    const uint8_t* data;  // after the kind byte
+    const uint8_t* end;
+};
+
+// Frames after the header, up to the first one that is short or fails its
+// check; anything after it was never committed.
+static std::vector<frame_ref_t> read_frames(const std::vector<uint8_t> &buf) {
+    std::vector<frame_ref_t> frames;
+    size_t pos = sizeof(journal_header_t);
+    while (buf.size() - pos >= 8) {
+        uint32_t len, crc;
+        std::memcpy(&len, buf.data() + pos, 4);
+        std::memcpy(&crc, buf.data() + pos + 4, 4);
+        if (len == 0 || len > buf.size() - pos - 8)
+            break;
+        const uint8_t* payload = buf.data() + pos + 8;
+        if (crc32c(payload, len) != crc)
+            break;
+        frames.push_back({payload[0], payload + 1, payload + len});
+        pos += 8 + len;
+    }
+    return frames;
+}
+
+static bool read_header(const std::vector<uint8_t> &buf, const char* marker, journal_header_t &h) {
+    if (buf.size() < sizeof h)
+        return false;
+    std::memcpy(&h, buf.data(), sizeof h);
+    return std::memcmp(h.marker, marker, MARKER_LEN) == 0 && h.version >= 1 && h.version <= JOURNAL_VERSION;
+}
+
+// Writer thread: start the file again with a header.
+static bool open_log(const char* path, const char* marker, uint32_t checkpoint_crc) {
+    if (state.fd >= 0)
+        close(state.fd);
+    state.fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0666);
+    if (state.fd < 0)
+        return false;
+    journal_header_t h;
+    std::memcpy(h.marker, marker, MARKER_LEN);
+    h.version = JOURNAL_VERSION;
+    h.checkpoint_crc = checkpoint_crc;
+    const uint8_t* raw = reinterpret_cast<const uint8_t*>(&h);
+    return write_all(state.fd, std::vector<uint8_t>(raw, raw + sizeof h));
+}
+
+// Writer thread: one frame, with one write.
+static bool append_frame(uint8_t kind, const std::vector<uint8_t> &head, const std::vector<uint8_t> &body) {
+    uint32_t len = 1 + head.size() + body.size();
+    uint32_t crc = crc32c(&kind, 1);
+    crc = crc32c(head.data(), head.size(), crc);
+    crc = crc32c(body.data(), body.size(), crc);
+    std::vector<uint8_t> frame(8);
+    frame.reserve(8 + len);
+    std::memcpy(frame.data(), &len, 4);
+    std::memcpy(frame.data() + 4, &crc, 4);
+    frame.push_back(kind);
+    frame.insert(frame.end(), head.begin(), head.end());
+    frame.insert(frame.end(), body.begin(), body.end());
+    return state.fd >= 0 && write_all(state.fd, frame);
+}
+
+static bool write_job(journal_job_t &job) {
+    bool crash = state.target == JournalTarget::Crash;
+    if (job.kind == FRAME_TURNS)
+        return append_frame(FRAME_TURNS, {}, job.data) && (!crash || fdatasync(state.fd) == 0);
+
+    snapshot_seal(job.data, job.archive_fd);
+    if (crash) {
+        // The old journal stays valid until the new checkpoint is in
+        // place; after that its crc no longer matches, so a crash between
+        // the two steps recovers from the checkpoint alone.
+        return write_file_atomic(state.checkpoint_path.c_str(), job.data) &&
+               open_log(state.journal_path.c_str(), JOURNAL_MARKER,
+                        crc32c(job.data.data(), job.data.size())) &&
+               fdatasync(state.fd) == 0;
+    }
+    if (job.restart && !open_log(state.journal_path.c_str(), RECORDING_MARKER, 0))
+        return false;
+    std::vector<uint8_t> head;
+    put_varint(head, job.turn);
+    return append_frame(FRAME_SNAPSHOT, head, job.data);
+}
+
+static void writer_loop() {
+    std::unique_lock<std::mutex> guard(state.lock);
+    for (;;) {
+        state.wake.wait(guard, []() { return !state.jobs.empty() || state.stop; });
+        if (state.jobs.empty())
+            break;
+        journal_job_t job = std::move(state.jobs.front());
+        state.jobs.pop_front();
+        guard.unlock();
+
+        bool ok = write_job(job);
+        int err = ok ? 0 : errno;
+
+        guard.lock();
+        if (!ok)
+            state.failed_errno = err;
+    }
+    if (state.fd >= 0) {
+        close(state.fd);
+        state.fd = -1;
+    }
+}
+
+static void push_job(uint8_t kind, int turn, bool restart, std::vector<uint8_t> &&data,
+                     int archive_fd = -1) {
+    {
+        std::lock_guard<std::mutex> guard(state.lock);
+        state.jobs.push_back({kind, turn, restart, std::move(data), archive_fd});
+    }
+    state.wake.notify_one();
+}
+
+static void stop_writer() {
+    if (!state.writer.joinable())
+        return;
+    {
+        std::lock_guard<std::mutex> guard(state.lock);
+        state.stop = true;
+    }
+    state.wake.notify_one();
+    state.writer.join();
+}
+
+static void commit_group() {
+    if (state.group.empty())
+        return;
+    push_job(FRAME_TURNS, 0, false, std::move(state.group));
+    state.group.clear();
+    state.group_turns = 0;
+}
+
+// Only ever at a turn boundary with no trip under way: travel is not part
+// of the snapshot, and the records after it must start from a fresh turn.
+// A crash journal starts again from every checkpoint; a recording keeps
+// its records and only starts again after a replay.
+static void checkpoint(int pc_turn) {
+    if (state.target == JournalTarget::Recording && !state.restart_due)
+        commit_group();
+    state.group.clear();
+    state.group_turns = 0;
+    state.since_checkpoint = 0;
+    state.turn_inputs.clear();
+    for (int s = 0; s < RNG_STREAMS; s++)
+        state.last_rng[s] = rng_position(static_cast<RngStream>(s));
+    std::vector<uint8_t> buf;
+    int archive_fd;
+    snapshot_capture(buf, archive_fd);
+    push_job(FRAME_SNAPSHOT, pc_turn, state.restart_due, std::move(buf), archive_fd);
+    state.restart_due = false;
+}
+
+// The replay is over: hand the terminal back, or with nothing to resume,
+// end the game.
+static void end_replay(const std::string &why) {
+    state.replaying = false;
+    swap_renderer(std::move(state.live_renderer));
+    if (!state.handover) {
+        state.finished = true;
+        return;
+    }
+    screen_clear();
+    render_invalidate();
+    messages_invalidate();
+    if (travel_active())
+        travel_stop("");
+    if (!why.empty())
+        display_message(why);
+    state.restart_due = true;
+}
+
+bool JournalTap::replay(int &value) {
+    if (state.finished) {
+        // A replay that ran out: ESC backs out of whatever prompt the game
+        // is waiting at, so it gets back to the main loop and ends there.
+        value = 27;
+        return true;
+    }
+    if (!state.replaying)
+        return false;
+    const journal_turn_t &t = state.replay_turns[state.replay_next];
+    if (state.input_next < t.inputs.size()) {
+        value = t.inputs[state.input_next++];
+        return true;
+    }
+    state.diverged_at = t.turn;
+    end_replay(std::string("The ") + state.source + " ran out of input at turn " +
+               std::to_string(t.turn) + "; play continues from there.");
+    return false;
+}
+
+void JournalTap::record(int value) {
+    if (!state.replaying && state.target != JournalTarget::None)
+        state.turn_inputs.push_back(value);
+}
+
+std::string journal_checkpoint_path(const std::string &dir) {
+    return dir + "/checkpoint";
+}
+
+bool journal_recover(const std::string &dir) {
+    std::string cpath = journal_checkpoint_path(dir), jpath = dir + "/journal";
+    std::vector<uint8_t> buf;
+    if (!read_file(cpath.c_str(), buf)) {
+        std::cerr << "Nothing to recover: " << cpath << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+    if (load_game_from(buf, cpath.c_str()) != LoadKind::Session)
+        return false;
+    uint32_t checkpoint_crc = crc32c(buf.data(), buf.size());
+
+    uint64_t rng[RNG_STREAMS];
+    for (int s = 0; s < RNG_STREAMS; s++)
+        rng[s] = rng_position(static_cast<RngStream>(s));
+    state.replay_turns.clear();
+    state.loaded = state.handover = true;
+    state.from_recording = false;
+    state.source = "journal";
+
+    journal_header_t h;
+    if (!read_file(jpath.c_str(), buf))
+        return true;
+    if (!read_header(buf, JOURNAL_MARKER, h) || h.checkpoint_crc != checkpoint_crc) {
+        std::cerr << jpath << " does not follow the checkpoint; recovering the checkpoint alone."
+                  << std::endl;
+        return true;
+    }
+    // A frame that passes its crc but does not decode is dropped whole,
+    // along with everything after it.
+    for (const frame_ref_t &f : read_frames(buf)) {
+        if (f.kind != FRAME_TURNS)
+            continue;
+        std::vector<journal_turn_t> turns;
+        uint64_t next_rng[RNG_STREAMS];
+        std::memcpy(next_rng, rng, sizeof rng);
+        if (!decode_turns(f.data, f.end, next_rng, h.version >= 2, turns))
+            break;
+        std::memcpy(rng, next_rng, sizeof rng);
+        for (journal_turn_t &t : turns)
+            state.replay_turns.push_back(std::move(t));
+    }
+    return true;
+}
+
+bool journal_load_recording(const std::string &path, int seek_turn) {
+    std::vector<uint8_t> buf;
+    if (!read_file(path.c_str(), buf)) {
+        std::cerr << "Error reading " << path << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+    journal_header_t h;
+    if (!read_header(buf, RECORDING_MARKER, h)) {
+        std::cerr << path << " is not a recording, or is from a newer version." << std::endl;
+        return false;
+    }
+
+    // Start from the last snapshot at or before the turn sought, or the
+    // first one when there is none.
+    std::vector<frame_ref_t> frames = read_frames(buf);
+    size_t start = frames.size();
+    for (size_t i = 0; i < frames.size(); i++) {
+        const uint8_t* p = frames[i].data;
+        uint64_t turn;
+        if (frames[i].kind != FRAME_SNAPSHOT || !get_varint(p, frames[i].end, turn))
+            continue;
+        if (start == frames.size() || (seek_turn >= 0 && turn <= static_cast<uint64_t>(seek_turn)))
+            start = i;
+    }
+    if (start == frames.size()) {
+        std::cerr << path << " holds no snapshot to start from." << std::endl;
+        return false;
+    }
+    const uint8_t* p = frames[start].data;
+    uint64_t turn;
+    get_varint(p, frames[start].end, turn);
+    if (load_game_from(std::vector<uint8_t>(p, frames[start].end), path.c_str()) != LoadKind::Session)
+        return false;
+
+    // Records run on across later snapshots, which are skipped.
+    uint64_t rng[RNG_STREAMS];
+    for (int s = 0; s < RNG_STREAMS; s++)
+        rng[s] = rng_position(static_cast<RngStream>(s));
+    state.replay_turns.clear();
+    for (size_t i = start + 1; i < frames.size(); i++) {
+        if (frames[i].kind == FRAME_TURNS &&
+            !decode_turns(frames[i].data, frames[i].end, rng, h.version >= 2, state.replay_turns))
+            break;
+    }
+    if (seek_turn >= 0) {
+        size_t keep = 0;
+        while (keep < state.replay_turns.size() && state.replay_turns[keep].turn <= seek_turn)
+            keep++;
+        state.replay_turns.resize(keep);
+    }
+    state.loaded = true;
+    state.handover = seek_turn >= 0;
+    state.from_recording = true;
+    state.source = "recording";
+    return true;
+}
+
+void journal_start(JournalTarget target, const std::string &where) {
+    if (target == JournalTarget::None && !state.loaded)
+        return;
+    state.target = target;
+    if (target == JournalTarget::Crash) {
+        state.checkpoint_path = journal_checkpoint_path(where);
+        state.journal_path = where + "/journal";
+    } else {
+        state.journal_path = where;
+    }
+    state.running = true;
+    if (target != JournalTarget::None) {
+        state.stop = false;
+        state.failed_errno = 0;
+        state.writer = std::thread(writer_loop);
+        static bool registered = false;
+        if (!registered) {
+            std::atexit(stop_writer);
+            registered = true;
+        }
+    }
+    set_input_tap(&state.tap);
+
+    if (state.loaded && !state.replay_turns.empty()) {
+        // Replayed turns are not drawn; the terminal comes back when the
+        // last one is done.
+        state.replaying = true;
+        state.replay_next = state.input_next = 0;
+        state.live_renderer = swap_renderer(make_renderer("headless"));
+        return;
+    }
+    if (state.loaded && !state.handover) {
+        state.finished = true;
+        return;
+    }
+    if (state.loaded)
+        display_message(std::string("Nothing to replay after the ") +
+                        (state.from_recording ? "snapshot." : "checkpoint."));
+    if (target != JournalTarget::None) {
+        state.restart_due = true;
+        checkpoint(characters[0].turn);
+    }
+}
+
+void journal_end_turn(const character_t &pc) {
+    if (!state.running)
+        return;
+    journal_clock::time_point t0 = journal_clock::now();
+
+    if (state.replaying) {
+        const journal_turn_t &t = state.replay_turns[state.replay_next];
+        bool same = state.input_next == t.inputs.size() && t.turn == pc.turn;
+        for (int s = 0; s < RNG_STREAMS; s++)
+            same = same && t.rng[s] == rng_position(static_cast<RngStream>(s));
+        same = same && (!t.hashed || t.state_hash == zobrist_hash());
+        state.replay_next++;
+        state.input_next = 0;
+        if (!same) {
+            state.diverged_at = t.turn;
+            end_replay(std::string("The ") + state.source + " diverged at turn " +
+                       std::to_string(t.turn) + "; play continues from there.");
+        } else if (state.replay_next == state.replay_turns.size()) {
+            end_replay(state.from_recording
+                       ? "Replayed to turn " + std::to_string(t.turn) + "."
+                       : "Recovered " + std::to_string(state.replay_next) + " turns from the journal.");
+        }
+        // Handed over at a turn boundary: start the new journal here.
+        if (state.restart_due && state.target != JournalTarget::None)
+            checkpoint(pc.turn);
+        return;
+    }
+    if (state.target == JournalTarget::None)
+        return;
+
+    // After a replay the journal starts over once no trip is under way.
+    if (state.restart_due) {
+        if (!travel_active())
+            checkpoint(pc.turn);
+        state.turn_inputs.clear();
+        return;
+    }
+
+    put_varint(state.group, pc.turn);
+    put_varint(state.group, state.turn_inputs.size());
+    for (int v : state.turn_inputs)
+        put_varint(state.group, static_cast<uint64_t>(v + 1));
+    state.turn_inputs.clear();
+    for (int s = 0; s < RNG_STREAMS; s++) {
+        uint64_t pos = rng_position(static_cast<RngStream>(s));
+        put_varint(state.group, pos - state.last_rng[s]);
+        state.last_rng[s] = pos;
+    }
+    uint64_t hash = zobrist_hash();
+    const uint8_t* raw = reinterpret_cast<const uint8_t*>(&hash);
+    state.group.insert(state.group.end(), raw, raw + sizeof hash);
+    if (++state.group_turns >= JOURNAL_GROUP_TURNS)
+        commit_group();
+    if (++state.since_checkpoint >= JOURNAL_CHECKPOINT_TURNS && !travel_active())
+        checkpoint(pc.turn);
+    metrics_record(MetricSeries::JournalUs,
+                   std::chrono::duration<double, std::micro>(journal_clock::now() - t0).count());
+
+    int err;
+    {
+        std::lock_guard<std::mutex> guard(state.lock);
+        err = state.failed_errno;
+        state.failed_errno = 0;
+    }
+    if (err)
+        display_message(std::string("Journal write failed: ") + strerror(err));
+}
+
+bool journal_replaying() {
+    return state.replaying;
+}
+
+bool journal_replay_finished() {
+    return state.finished;
+}
+
+replay_stats_t journal_replay_stats() {
+    replay_stats_t r;
+    r.played = state.replay_next;
+    r.total = state.replay_turns.size();
+    r.diverged_at = state.diverged_at;
+    return r;
+}
+
+void journal_stop() {
+    if (!state.running)
+        return;
+    if (state.replaying)
+        end_replay("");
+    if (!state.restart_due)
+        commit_group();
+    stop_writer();
+    set_input_tap(nullptr);
+    state.running = false;
+}
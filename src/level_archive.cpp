@@ -0,0 +1,668 @@
+#include "level_archive.h"
+#include "crc32c.h"
+#include "fileio.h"
+#include "record_codec.h"
+#include <algorithm>
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char ARCHIVE_MARKER[] = "RLG327-A2025";
+static const uint32_t ARCHIVE_VERSION = 1;
+static const uint32_t ARCHIVE_BYTE_ORDER = 0x01020304;
+
+struct archive_header_t {
+    char marker[MARKER_LEN];
+    uint32_t version;
+    uint32_t byte_order;
+    uint16_t width, height;
+    uint64_t game_id;
+    uint64_t end;  // bytes in use, header included
+    uint64_t index[ARCHIVE_DEPTHS];  // record offset by depth slot, 0 = none
+};
+
+// Records start on 8-byte boundaries; the payload follows the header.
+struct archive_record_t {
+    int32_t depth;
+    uint32_t bytes;  // payload
+    uint32_t crc;    // crc32c of the payload
+    uint32_t reserved;
+};
+
+// Payload, in order: the level, its rooms, the packed hardness, the explored
+// bits, monsters, floor objects and the strings they refer to. Records
+// are packed and read with memcpy, so nothing in the file needs aligning.
+struct __attribute__((packed)) arch_level_t {
+    uint16_t pc_x, pc_y;
+    uint8_t room_count, up_count, down_count, reserved;
+    uint16_t up_x, up_y, down_x, down_y;
+    uint32_t hardness_bytes, monsters, objects, strings;
+};
+
+struct __attribute__((packed)) arch_room_t {
+    uint16_t x, y, w, h;
+};
+
+struct __attribute__((packed)) arch_dice_t {
+    int32_t base;
+    int16_t dice, sides;
+};
+
+struct __attribute__((packed)) arch_str_t {
+    uint32_t off;
+    uint16_t len;
+};
+
+struct __attribute__((packed)) arch_monster_t {
+    uint16_t x, y;
+    int32_t hp;
+    arch_dice_t base_damage;
+    int16_t speed;
+    uint8_t symbol;
+    int32_t turn, btype;
+    int16_t pc_seen_x, pc_seen_y;
+    arch_str_t color;
+};
+
+struct __attribute__((packed)) arch_object_t {
+    uint16_t x, y;
+    uint8_t symbol, is_artifact;
+    int32_t hit, dodge, defense, weight, speed, attribute, value;
+    arch_dice_t damage;
+    arch_str_t name, color, description;
+};
+
+struct archive_state_t {
+    std::string prefix;
+    bool unlinked = false;  // scratch files, unlinked once open
+    std::string import;  // for the next archive_attach()
+    std::string path;
+    int fd = -1;
+    archive_header_t header;
+    // Read-only view of the file; remapped when it has grown past it.
+    const uint8_t* map = nullptr;
+    size_t map_len = 0;
+    uint64_t attached_id = 0;
+    std::vector<uint8_t> scratch;  // record being built
+    std::vector<uint8_t> cells;    // hardness being unpacked
+};
+
+static archive_state_t state;
+
+static int depth_slot(int depth) {
+    int slot = depth + ARCHIVE_DEPTHS / 2;
+    return slot >= 0 && slot < ARCHIVE_DEPTHS ? slot : -1;
+}
+
+static uint64_t align8(uint64_t n) {
+    return (n + 7) & ~uint64_t(7);
+}
+
+static void unmap() {
+    if (state.map)
+        munmap(const_cast<uint8_t*>(state.map), state.map_len);
+    state.map = nullptr;
+    state.map_len = 0;
+}
+
+static bool map_to(uint64_t end) {
+    if (state.map_len >= end)
+        return true;
+    unmap();
+    void* p = mmap(nullptr, end, PROT_READ, MAP_SHARED, state.fd, 0);
+    if (p == MAP_FAILED)
+        return false;
+    // Records are read one at a time, far apart; read ahead of none.
+    madvise(p, end, MADV_RANDOM);
+    state.map = static_cast<const uint8_t*>(p);
+    state.map_len = end;
+    return true;
+}
+
+static bool write_header() {
+    const archive_header_t &h = state.header;
+    return pwrite(state.fd, &h, sizeof h, 0) == static_cast<ssize_t>(sizeof h);
+}
+
+// Empty the file and give it to game_id.
+static void reset(uint64_t game_id) {
+    unmap();
+    archive_header_t &h = state.header;
+    std::memset(&h, 0, sizeof h);
+    std::memcpy(h.marker, ARCHIVE_MARKER, MARKER_LEN);
+    h.version = ARCHIVE_VERSION;
+    h.byte_order = ARCHIVE_BYTE_ORDER;
+    h.width = WIDTH;
+    h.height = HEIGHT;
+    h.game_id = game_id;
+    h.end = sizeof h;
+    state.attached_id = game_id;
+    if (ftruncate(state.fd, 0) != 0 || !write_header())
+        std::cerr << "Level archive: " << strerror(errno) << std::endl;
+}
+
+static std::string file_for(uint64_t game_id) {
+    char name[32];
+    std::snprintf(name, sizeof name, "%016" PRIx64 ".levels", game_id);
+    return state.prefix + name;
+}
+
+static uint64_t new_id() {
+    std::random_device rd;
+    return (uint64_t(rd()) << 32) | rd();
+}
+
+// Open game_id's file, creating it if need be (or only creating it, with
+// fresh, which fails if it exists).
+static bool open_file(uint64_t game_id, bool fresh) {
+    archive_close();
+    state.attached_id = game_id;
+    if (state.prefix.empty())
+        return false;
+    state.path = file_for(game_id);
+    state.fd = open(state.path.c_str(), O_RDWR | O_CREAT | (fresh ? O_EXCL : 0), 0666);
+    if (state.fd < 0) {
+        if (!fresh || errno != EEXIST)
+            std::cerr << "Error opening " << state.path << ": " << strerror(errno)
+                      << "; levels left will not be kept." << std::endl;
+        state.path.clear();
+        return false;
+    }
+    if (state.unlinked)
+        unlink(state.path.c_str());
+    return true;
+}
+
+// Whether the open file has a header this build can use.
+static bool header_ok() {
+    archive_header_t &h = state.header;
+    struct stat st;
+    return fstat(state.fd, &st) == 0 && pread(state.fd, &h, sizeof h, 0) == static_cast<ssize_t>(sizeof h) &&
+           std::memcmp(h.marker, ARCHIVE_MARKER, MARKER_LEN) == 0 && h.version == ARCHIVE_VERSION &&
+           h.byte_order == ARCHIVE_BYTE_ORDER && h.width == WIDTH && h.height == HEIGHT &&
+           h.end >= sizeof h && h.end <= static_cast<uint64_t>(st.st_size);
+}
+
+void archive_set_prefix(const std::string &prefix, bool scratch) {
+    archive_close();
+    state.prefix = prefix;
+    state.unlinked = scratch;
+}
+
+void archive_close() {
+    unmap();
+    if (state.fd >= 0)
+        close(state.fd);
+    state.fd = -1;
+    state.path.clear();
+}
+
+bool archive_is_open() {
+    return state.fd >= 0;
+}
+
+std::string archive_path() {
+    return state.path;
+}
+
+void archive_new_game() {
+    // A clash of ids would take another game's file; a fresh one is drawn
+    // until the file is new.
+    for (int tries = 0; tries < 8; tries++) {
+        uint64_t id = new_id();
+        if (open_file(id, true)) {
+            reset(id);
+            return;
+        }
+        if (state.prefix.empty() || errno != EEXIST)
+            return;
+    }
+}
+
+void archive_import(const std::string &path) {
+    state.import = path;
+}
+
+void archive_attach(uint64_t game_id, uint64_t mark) {
+    std::string from = state.import;
+    state.import.clear();
+    if (from.empty() && !state.prefix.empty())
+        from = file_for(game_id);
+    // The session goes on as a new game with a copy of the levels, so
+    // nothing it stores (recorded, journaled or not) reaches the file the
+    // save refers to. header_ok() below checks the copy belongs to game_id.
+    std::vector<uint8_t> levels;
+    if (from.empty() || !read_file(from.c_str(), levels))
+        levels.clear();
+    archive_new_game();
+    if (!archive_is_open()) {
+        state.attached_id = game_id;
+        return;
+    }
+    if (!levels.empty() && (ftruncate(state.fd, 0) != 0 || !write_all(state.fd, levels)))
+        std::cerr << "Level archive: " << strerror(errno) << std::endl;
+    uint64_t id = state.attached_id;
+    archive_header_t &h = state.header;
+    if (!header_ok() || h.game_id != game_id || mark < sizeof h) {
+        if (mark > sizeof h)
+            std::cerr << "The level archive for this save is missing or damaged; levels left before "
+                         "it will be generated again." << std::endl;
+        reset(id);
+        return;
+    }
+    h.game_id = id;
+    state.attached_id = id;
+    if (mark > h.end)
+        std::cerr << "The level archive is shorter than this save expects; some levels will be "
+                     "generated again." << std::endl;
+
+    // Rebuild the index from the records before the mark.
+    uint64_t end = std::min(mark, h.end);
+    std::memset(h.index, 0, sizeof h.index);
+    uint64_t off = sizeof h;
+    if (map_to(h.end)) {
+        while (end - off >= sizeof(archive_record_t)) {
+            archive_record_t r;
+            std::memcpy(&r, state.map + off, sizeof r);
+            uint64_t next = align8(off + sizeof r + r.bytes);
+            if (next > end)
+                break;
+            int slot = depth_slot(r.depth);
+            if (slot >= 0)
+                h.index[slot] = off;
+            off = next;
+        }
+    }
+    unmap();
+    h.end = off;
+    if (ftruncate(state.fd, off) != 0 || !write_header())
+        std::cerr << "Level archive: " << strerror(errno) << std::endl;
+}
+
+uint64_t archive_game_id() {
+    return state.attached_id;
+}
+
+uint64_t archive_mark() {
+    return state.fd >= 0 ? state.header.end : 0;
+}
+
+void archive_prune(const std::vector<uint64_t> &keep) {
+    if (state.prefix.empty() || state.unlinked)
+        return;
+    size_t slash = state.prefix.rfind('/');
+    std::string dir = slash == std::string::npos ? "." : slash == 0 ? "/" : state.prefix.substr(0, slash);
+    std::string base = state.prefix.substr(slash == std::string::npos ? 0 : slash + 1);
+    static const char SUFFIX[] = ".levels";
+    DIR* d = opendir(dir.c_str());
+    if (!d)
+        return;
+    while (dirent* e = readdir(d)) {
+        std::string name = e->d_name;
+        if (name.size() != base.size() + 16 + sizeof SUFFIX - 1 || name.compare(0, base.size(), base) != 0 ||
+            name.compare(base.size() + 16, std::string::npos, SUFFIX) != 0)
+            continue;
+        std::string hex = name.substr(base.size(), 16);
+        if (hex.find_first_not_of("0123456789abcdef") != std::string::npos)
+            continue;
+        uint64_t id = std::strtoull(hex.c_str(), nullptr, 16);
+        if (std::find(keep.begin(), keep.end(), id) == keep.end() &&
+            !(state.fd >= 0 && id == state.attached_id))
+            unlink(file_for(id).c_str());
+    }
+    closedir(d);
+}
+
+// --- Storing ---
+
+template <typename T>
+static void put(std::vector<uint8_t> &out, const T &v) {
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(&v);
+    out.insert(out.end(), p, p + sizeof v);
+}
+
+// Hardness in row-major order, run-length encoded: a control byte c < 128
+// is followed by c + 1 literal cells, c >= 128 by one value repeated
+// c - 126 times. Floors and corridors collapse into runs; the rock, whose
+// hardness varies cell to cell, costs a byte a cell plus one in 128.
+static const int PACK_LITERALS = 128;
+static const int PACK_REPEAT = 129;
+
+static void pack_hardness(std::vector<uint8_t> &out, const stored_level_t &level) {
+    const int cells = WIDTH * HEIGHT;
+    auto at = [&level](int i) { return level.hardness[i / WIDTH][i % WIDTH]; };
+    int i = 0;
+    while (i < cells) {
+        int n = 1;
+        while (n < PACK_REPEAT && i + n < cells && at(i + n) == at(i))
+            n++;
+        if (n >= 2) {
+            out.push_back(static_cast<uint8_t>(n + 126));
+            out.push_back(at(i));
+            i += n;
+            continue;
+        }
+        // Literals run up to the next pair of equal cells.
+        int start = i;
+        while (i < cells && i - start < PACK_LITERALS && !(i + 1 < cells && at(i + 1) == at(i)))
+            i++;
+        if (i == start)
+            i++;
+        out.push_back(static_cast<uint8_t>(i - start - 1));
+        for (int k = start; k < i; k++)
+            out.push_back(at(k));
+    }
+}
+
+// Exactly WIDTH * HEIGHT cells, or false.
+static bool unpack_hardness(const uint8_t* p, size_t len, std::vector<uint8_t> &cells) {
+    const size_t want = WIDTH * HEIGHT;
+    cells.clear();
+    const uint8_t* end = p + len;
+    while (p < end) {
+        uint8_t c = *p++;
+        if (c < PACK_LITERALS) {
+            size_t n = c + 1;
+            if (static_cast<size_t>(end - p) < n || cells.size() + n > want)
+                return false;
+            cells.insert(cells.end(), p, p + n);
+            p += n;
+        } else {
+            size_t n = c - 126;
+            if (p == end || cells.size() + n > want)
+                return false;
+            cells.insert(cells.end(), n, *p++);
+        }
+    }
+    return cells.size() == want;
+}
+
+static void encode_level(std::vector<uint8_t> &out, const stored_level_t &level) {
+    std::vector<uint8_t> packed;
+    pack_hardness(packed, level);
+
+    string_table_t<arch_str_t> strings;
+    std::vector<arch_monster_t> monsters;
+    for (const character_t &c : level.monsters) {
+        arch_monster_t m;
+        m.x = c.x;
+        m.y = c.y;
+        m.hp = c.hp;
+        m.base_damage = dice_record<arch_dice_t>(c.base_damage);
+        m.speed = c.speed;
+        m.symbol = c.symbol;
+        m.turn = c.turn;
+        m.btype = c.monster_btype;
+        m.pc_seen_x = c.pc_seen_x;
+        m.pc_seen_y = c.pc_seen_y;
+        m.color = strings.add_colors(c.color);
+        monsters.push_back(m);
+    }
+    std::vector<arch_object_t> objects;
+    for (const ObjectInstance &o : level.objects) {
+        arch_object_t r;
+        r.x = o.x;
+        r.y = o.y;
+        r.symbol = o.symbol;
+        r.is_artifact = o.is_artifact;
+        r.hit = o.hit;
+        r.dodge = o.dodge;
+        r.defense = o.defense;
+        r.weight = o.weight;
+        r.speed = o.speed;
+        r.attribute = o.attribute;
+        r.value = o.value;
+        r.damage = dice_record<arch_dice_t>(o.damage);
+        r.name = strings.add(o.name);
+        r.color = strings.add_colors(o.color);
+        r.description = strings.add(o.description);
+        objects.push_back(r);
+    }
+
+    arch_level_t lv;
+    lv.pc_x = level.pc_x;
+    lv.pc_y = level.pc_y;
+    lv.room_count = level.room_count;
+    lv.up_count = level.up_count > 0;
+    lv.down_count = level.down_count > 0;
+    lv.reserved = 0;
+    lv.up_x = level.up_x;
+    lv.up_y = level.up_y;
+    lv.down_x = level.down_x;
+    lv.down_y = level.down_y;
+    lv.hardness_bytes = packed.size();
+    lv.monsters = monsters.size();
+    lv.objects = objects.size();
+    lv.strings = strings.bytes.size();
+    put(out, lv);
+    for (int i = 0; i < level.room_count; i++)
+        put(out, arch_room_t{static_cast<uint16_t>(level.room_x[i]), static_cast<uint16_t>(level.room_y[i]),
+                             static_cast<uint16_t>(level.room_w[i]), static_cast<uint16_t>(level.room_h[i])});
+    out.insert(out.end(), packed.begin(), packed.end());
+    for (int y = 0; y < HEIGHT; y++)
+        for (int w = 0; w < ROW_WORDS; w++)
+            put(out, level.explored[y][w]);
+    for (const arch_monster_t &m : monsters)
+        put(out, m);
+    for (const arch_object_t &o : objects)
+        put(out, o);
+    out.insert(out.end(), strings.bytes.begin(), strings.bytes.end());
+}
+
+bool archive_store(int depth, const stored_level_t &level) {
+    int slot = depth_slot(depth);
+    if (state.fd < 0 || slot < 0)
+        return true;
+    std::vector<uint8_t> &buf = state.scratch;
+    buf.assign(sizeof(archive_record_t), 0);
+    encode_level(buf, level);
+    archive_record_t r = {};
+    r.depth = depth;
+    r.bytes = buf.size() - sizeof r;
+    r.crc = crc32c(buf.data() + sizeof r, r.bytes);
+    std::memcpy(buf.data(), &r, sizeof r);
+    buf.resize(align8(buf.size()), 0);
+
+    // The record goes in before the index points at it.
+    archive_header_t &h = state.header;
+    if (pwrite(state.fd, buf.data(), buf.size(), h.end) != static_cast<ssize_t>(buf.size()))
+        return false;
+    h.index[slot] = h.end;
+    h.end += buf.size();
+    return write_header();
+}
+
+// --- Loading ---
+
+// Bounds-checked reads from a record's payload.
+struct arch_reader_t {
+    const uint8_t* p;
+    const uint8_t* end;
+
+    template <typename T>
+    bool get(T &v) {
+        if (static_cast<size_t>(end - p) < sizeof v)
+            return false;
+        std::memcpy(&v, p, sizeof v);
+        p += sizeof v;
+        return true;
+    }
+
+    // n records of T, left in place.
+    template <typename T>
+    const uint8_t* skip(uint64_t n) {
+        if (n > static_cast<uint64_t>(end - p) / sizeof(T))
+            return nullptr;
+        const uint8_t* at = p;
+        p += n * sizeof(T);
+        return at;
+    }
+};
+
+// The record at off, checked throughout before level is filled in.
+static bool decode_level(uint64_t off, int depth, stored_level_t &level) {
+    archive_record_t r;
+    std::memcpy(&r, state.map + off, sizeof r);
+    if (r.depth != depth || r.bytes > state.header.end - off - sizeof r)
+        return false;
+    const uint8_t* payload = state.map + off + sizeof r;
+    if (crc32c(payload, r.bytes) != r.crc)
+        return false;
+
+    arch_reader_t in = {payload, payload + r.bytes};
+    arch_level_t lv;
+    if (!in.get(lv) || lv.room_count > MAX_ROOMS || !in_map(lv.pc_x, lv.pc_y))
+        return false;
+    const uint8_t* rooms = in.skip<arch_room_t>(lv.room_count);
+    const uint8_t* packed = in.skip<uint8_t>(lv.hardness_bytes);
+    const uint8_t* explored = in.skip<uint64_t>(HEIGHT * ROW_WORDS);
+    const uint8_t* monsters = in.skip<arch_monster_t>(lv.monsters);
+    const uint8_t* objects = in.skip<arch_object_t>(lv.objects);
+    const uint8_t* strings = in.skip<char>(lv.strings);
+    if (!rooms || !packed || !explored || !monsters || !objects || !strings || in.p != in.end)
+        return false;
+    for (int i = 0; i < lv.room_count; i++) {
+        arch_room_t rm = record_at<arch_room_t>(rooms, i);
+        if (rm.w == 0 || rm.h == 0 || !in_map(rm.x + rm.w - 1, rm.y + rm.h - 1))
+            return false;
+    }
+    if ((lv.up_count && !in_map(lv.up_x, lv.up_y)) || (lv.down_count && !in_map(lv.down_x, lv.down_y)))
+        return false;
+    if (!unpack_hardness(packed, lv.hardness_bytes, state.cells))
+        return false;
+    for (uint32_t i = 0; i < lv.monsters; i++) {
+        arch_monster_t m = record_at<arch_monster_t>(monsters, i);
+        if (!in_map(m.x, m.y) || m.speed <= 0 || !ref_ok(m.color, lv.strings))
+            return false;
+    }
+    for (uint32_t i = 0; i < lv.objects; i++) {
+        arch_object_t o = record_at<arch_object_t>(objects, i);
+        if (!in_map(o.x, o.y) || !ref_ok(o.name, lv.strings) || !ref_ok(o.color, lv.strings) ||
+            !ref_ok(o.description, lv.strings))
+            return false;
+    }
+    auto str = [&](const arch_str_t &s) {
+        return std::string(reinterpret_cast<const char*>(strings) + s.off, s.len);
+    };
+
+    for (int y = 0; y < HEIGHT; y++)
+        for (int x = 0; x < WIDTH; x++)
+            level.hardness[y][x] = state.cells[y * WIDTH + x];
+    level.room_count = lv.room_count;
+    for (int i = 0; i < lv.room_count; i++) {
+        arch_room_t rm = record_at<arch_room_t>(rooms, i);
+        level.room_x[i] = rm.x;
+        level.room_y[i] = rm.y;
+        level.room_w[i] = rm.w;
+        level.room_h[i] = rm.h;
+    }
+    level.up_count = lv.up_count;
+    level.up_x = lv.up_x;
+    level.up_y = lv.up_y;
+    level.down_count = lv.down_count;
+    level.down_x = lv.down_x;
+    level.down_y = lv.down_y;
+    for (int y = 0; y < HEIGHT; y++)
+        for (int w = 0; w < ROW_WORDS; w++)
+            level.explored[y][w] = record_at<uint64_t>(explored, y * ROW_WORDS + w);
+    level.pc_x = lv.pc_x;
+    level.pc_y = lv.pc_y;
+
+    level.monsters.clear();
+    level.monsters.reserve(lv.monsters);
+    for (uint32_t i = 0; i < lv.monsters; i++) {
+        arch_monster_t m = record_at<arch_monster_t>(monsters, i);
+        character_t c;
+        c.type = CharType::Monster;
+        c.alive = true;
+        c.x = m.x;
+        c.y = m.y;
+        c.hp = m.hp;
+        c.base_damage = dice_from(m.base_damage);
+        c.speed = m.speed;
+        c.turn = m.turn;
+        c.monster_btype = m.btype;
+        c.symbol = static_cast<char>(m.symbol);
+        c.color = split_colors(str(m.color));
+        c.mana = c.max_mana = 0;
+        c.pc_seen_x = m.pc_seen_x;
+        c.pc_seen_y = m.pc_seen_y;
+        c.next_time = 0;
+        level.monsters.push_back(std::move(c));
+    }
+
+    level.objects.clear();
+    level.objects.reserve(lv.objects);
+    for (uint32_t i = 0; i < lv.objects; i++) {
+        arch_object_t r = record_at<arch_object_t>(objects, i);
+        ObjectInstance o;
+        o.name = str(r.name);
+        o.symbol = static_cast<char>(r.symbol);
+        o.color = split_colors(str(r.color));
+        o.hit = r.hit;
+        o.dodge = r.dodge;
+        o.defense = r.defense;
+        o.weight = r.weight;
+        o.speed = r.speed;
+        o.attribute = r.attribute;
+        o.value = r.value;
+        o.damage = dice_from(r.damage);
+        o.is_artifact = r.is_artifact != 0;
+        o.description = str(r.description);
+        o.x = r.x;
+        o.y = r.y;
+        level.objects.push_back(std::move(o));
+    }
+    return true;
+}
+
+bool archive_load(int depth, stored_level_t &level) {
+    int slot = depth_slot(depth);
+    if (state.fd < 0 || slot < 0 || state.header.index[slot] == 0)
+        return false;
+    uint64_t off = state.header.index[slot];
+    if (off > state.header.end - sizeof(archive_record_t) || !map_to(state.header.end))
+        return false;
+    bool ok = decode_level(off, depth, level);
+
+    // The record is read once; hand its pages back rather than let every
+    // level visited stay resident. Faults map in neighbouring pages too
+    // (64 KiB around each by default), so those go as well.
+    archive_record_t r;
+    std::memcpy(&r, state.map + off, sizeof r);
+    const uint64_t around = 64 * 1024;
+    uint64_t first = off & ~(around - 1);
+    uint64_t last = std::min<uint64_t>((off + sizeof r + r.bytes + 2 * around - 1) & ~(around - 1),
+                                       state.map_len);
+    madvise(const_cast<uint8_t*>(state.map) + first, last - first, MADV_DONTNEED);
+    return ok;
+}
+
+int archive_sync_fd() {
+    return state.fd >= 0 ? dup(state.fd) : -1;
+}
+
+void archive_sync(int fd) {
+    if (fd < 0)
+        return;
+    fdatasync(fd);
+    close(fd);
+}
+
+archive_stats_t archive_stats() {
+    archive_stats_t s = {0, archive_mark()};
+    if (state.fd >= 0)
+        for (uint64_t off : state.header.index)
+            s.levels += off != 0;
+    return s;
+}
@@ -0,0 +1,191 @@
+#include "level_cache.h"
+#include "global.h"
+#include "character.h"
+#include "dungeon.h"
+#include "occupancy.h"
+#include "fov.h"
+#include <list>
+#include <unordered_map>
+
+struct cache_entry_t {
+    int depth;
+    size_t bytes;
+    stored_level_t level;
+};
+
+struct level_cache_t {
+    size_t budget = size_t(LEVEL_CACHE_DEFAULT_MB) << 20;
+    // Most recently left first.
+    std::list<cache_entry_t> lru;
+    std::unordered_map<int, std::list<cache_entry_t>::iterator> by_depth;
+    level_cache_stats_t stats;
+};
+
+static level_cache_t cache;
+
+// --- Moving levels on and off the map ---
+
+void level_capture(stored_level_t &level) {
+    for (int y = 0; y < HEIGHT; y++)
+        for (int x = 0; x < WIDTH; x++)
+            level.hardness[y][x] = static_cast<uint8_t>(hardness[y][x]);
+    level.room_count = room_count;
+    level.room_x = room_x;
+    level.room_y = room_y;
+    level.room_w = room_w;
+    level.room_h = room_h;
+    level.up_count = upCount;
+    level.down_count = downCount;
+    level.up_x = up_xCoord;
+    level.up_y = up_yCoord;
+    level.down_x = down_xCoord;
+    level.down_y = down_yCoord;
+    level.explored = pc_explored;
+    level.pc_x = pc_x;
+    level.pc_y = pc_y;
+
+    // Kept exactly as the archive would give them back, so a level comes
+    // back the same whichever of the two it was in.
+    level.monsters.clear();
+    level.monsters.reserve(monsters_alive);
+    for (character_t &c : characters) {
+        if (c.type != CharType::Monster || !c.alive)
+            continue;
+        for (auto &slot : c.inventory) slot.reset();
+        for (auto &slot : c.equipment) slot.reset();
+        c.mana = c.max_mana = 0;
+        c.next_time = 0;
+        level.monsters.push_back(std::move(c));
+    }
+    level.objects = std::move(object_instances);
+    object_instances.clear();
+}
+
+// Terrain as new_level() would leave it, then the PC where it left (the
+// stairs it took), then the rest of the population.
+void level_apply(stored_level_t &level) {
+    characters.clear();
+    monsters_alive = 0;
+    for (int y = 0; y < HEIGHT; y++)
+        for (int x = 0; x < WIDTH; x++)
+            hardness[y][x] = level.hardness[y][x];
+    room_count = level.room_count;
+    room_x = level.room_x;
+    room_y = level.room_y;
+    room_w = level.room_w;
+    room_h = level.room_h;
+    upCount = level.up_count;
+    downCount = level.down_count;
+    up_xCoord = level.up_x;
+    up_yCoord = level.up_y;
+    down_xCoord = level.down_x;
+    down_yCoord = level.down_y;
+    rebuild_level_map();
+    base_map = dungeon;
+    terrain_generation++;
+    pc_explored = level.explored;
+
+    pc_x = level.pc_x;
+    pc_y = level.pc_y;
+    placePC(pc_x, pc_y);
+    for (auto &row : char_map)
+        row.fill(-1);
+    characters.reserve(level.monsters.size() + 1);
+    create_pc();
+    for (character_t &c : level.monsters) {
+        dungeon[c.y][c.x] = c.symbol;
+        characters.push_back(std::move(c));
+        monsters_alive++;
+    }
+    level.monsters.clear();
+    object_instances = std::move(level.objects);
+    level.objects.clear();
+    rebuild_char_map();
+    rebuild_object_map();
+    level_changed = true;
+}
+
+// --- The cache ---
+
+// Heap behind a string, beyond the short strings kept inline.
+static size_t heap_bytes(const std::string &s) {
+    return s.capacity() > 15 ? s.capacity() + 1 : 0;
+}
+
+static size_t heap_bytes(const std::vector<std::string> &v) {
+    size_t n = v.capacity() * sizeof(std::string);
+    for (const std::string &s : v)
+        n += heap_bytes(s);
+    return n;
+}
+
+static size_t level_bytes(const stored_level_t &level) {
+    size_t n = sizeof(cache_entry_t) + level.monsters.capacity() * sizeof(character_t) +
+               level.objects.capacity() * sizeof(ObjectInstance);
+    for (const character_t &c : level.monsters)
+        n += heap_bytes(c.color);
+    for (const ObjectInstance &o : level.objects)
+        n += heap_bytes(o.name) + heap_bytes(o.color) + heap_bytes(o.description);
+    return n;
+}
+
+static void drop(std::list<cache_entry_t>::iterator it) {
+    cache.stats.bytes -= it->bytes;
+    cache.stats.levels--;
+    cache.by_depth.erase(it->depth);
+    cache.lru.erase(it);
+}
+
+void level_cache_set_budget(size_t bytes) {
+    cache.budget = bytes;
+}
+
+bool level_cache_leave(int depth) {
+    auto old = cache.by_depth.find(depth);
+    if (old != cache.by_depth.end())
+        drop(old->second);
+
+    cache.lru.emplace_front();
+    cache_entry_t &e = cache.lru.front();
+    e.depth = depth;
+    level_capture(e.level);
+    e.bytes = level_bytes(e.level);
+    cache.by_depth[depth] = cache.lru.begin();
+    cache.stats.bytes += e.bytes;
+    cache.stats.levels++;
+
+    bool ok = archive_store(depth, e.level);
+    while (cache.stats.bytes > cache.budget && !cache.lru.empty()) {
+        cache.stats.evictions++;
+        drop(std::prev(cache.lru.end()));
+    }
+    return ok;
+}
+
+bool level_cache_enter(int depth) {
+    auto it = cache.by_depth.find(depth);
+    if (it != cache.by_depth.end()) {
+        cache.stats.hits++;
+        level_apply(it->second->level);
+        drop(it->second);
+        return true;
+    }
+    cache.stats.misses++;
+    stored_level_t level;
+    if (!archive_load(depth, level))
+        return false;
+    cache.stats.archive_loads++;
+    level_apply(level);
+    return true;
+}
+
+void level_cache_clear() {
+    cache.lru.clear();
+    cache.by_depth.clear();
+    cache.stats.levels = 0;
+    cache.stats.bytes = 0;
+}
+
+level_cache_stats_t level_cache_stats() {
+    return cache.stats;
+}
@@ -0,0 +1,142 @@
+#include "los.h"
+#include "global.h"
+#include "occupancy.h"
+#include <cstdlib>
+#include <vector>
+
+cell_bits_t walkable;
+
+static const int RAY_SIDE = 2 * MAX_TARGET_RANGE + 1;
+
+static std::vector<ray_step_t> ray_steps;           // all rays, back to back
+static std::vector<int> ray_start;                  // RAY_SIDE^2 entries
+static std::vector<ray_step_t> disc_steps[MAX_BLAST_RADIUS + 1];
+static bool tables_built = false;
+static unsigned walkable_gen = ~0u;
+
+static void trace_line(int dx, int dy, std::vector<ray_step_t> &out) {
+    int adx = std::abs(dx), ady = std::abs(dy);
+    int sx = (dx > 0) ? 1 : -1, sy = (dy > 0) ? 1 : -1;
+    int x = 0, y = 0;
+    int err = adx - ady;
+    while (x != dx || y != dy) {
+        int e2 = 2 * err;
+        if (e2 > -ady) { err -= ady; x += sx; }
+        if (e2 < adx)  { err += adx; y += sy; }
+        out.push_back({static_cast<int8_t>(x), static_cast<int8_t>(y)});
+    }
+}
+
+void los_init() {
+    if (tables_built)
+        return;
+    ray_start.resize(RAY_SIDE * RAY_SIDE + 1);
+    for (int dy = -MAX_TARGET_RANGE; dy <= MAX_TARGET_RANGE; dy++) {
+        for (int dx = -MAX_TARGET_RANGE; dx <= MAX_TARGET_RANGE; dx++) {
+            ray_start[(dy + MAX_TARGET_RANGE) * RAY_SIDE + (dx + MAX_TARGET_RANGE)] =
+                static_cast<int>(ray_steps.size());
+            trace_line(dx, dy, ray_steps);
+        }
+    }
+    ray_start[RAY_SIDE * RAY_SIDE] = static_cast<int>(ray_steps.size());
+
+    for (int r = 0; r <= MAX_BLAST_RADIUS; r++) {
+        disc_steps[r].push_back({0, 0});
+        for (int dy = -r; dy <= r; dy++)
+            for (int dx = -r; dx <= r; dx++)
+                if ((dx || dy) && dx*dx + dy*dy <= r*r)
+                    disc_steps[r].push_back({static_cast<int8_t>(dx), static_cast<int8_t>(dy)});
+    }
+    tables_built = true;
+}
+
+ray_t los_ray(int dx, int dy) {
+    if (std::abs(dx) > MAX_TARGET_RANGE || std::abs(dy) > MAX_TARGET_RANGE)
+        return {nullptr, 0};
+    int idx = (dy + MAX_TARGET_RANGE) * RAY_SIDE + (dx + MAX_TARGET_RANGE);
+    return {ray_steps.data() + ray_start[idx], ray_start[idx + 1] - ray_start[idx]};
+}
+
+ray_t los_disc(int radius) {
+    if (radius < 0)
+        radius = 0;
+    if (radius > MAX_BLAST_RADIUS)
+        radius = MAX_BLAST_RADIUS;
+    return {disc_steps[radius].data(), static_cast<int>(disc_steps[radius].size())};
+}
+
+// Walk the line from (x0,y0) to (x1,y1), calling visit(x, y, is_last) for
+// each cell after the origin until it returns false.
+template <typename Visit>
+static bool walk_line(int x0, int y0, int x1, int y1, Visit visit) {
+    int dx = x1 - x0, dy = y1 - y0;
+    if (std::abs(dx) <= MAX_TARGET_RANGE && std::abs(dy) <= MAX_TARGET_RANGE) {
+        ray_t ray = los_ray(dx, dy);
+        for (int i = 0; i < ray.len; i++)
+            if (!visit(x0 + ray.steps[i].dx, y0 + ray.steps[i].dy, i == ray.len - 1))
+                return false;
+        return true;
+    }
+    // Off the table: same Bresenham, directly in map coordinates.
+    int adx = std::abs(dx), ady = std::abs(dy);
+    int sx = (dx > 0) ? 1 : -1, sy = (dy > 0) ? 1 : -1;
+    int x = x0, y = y0, err = adx - ady;
+    while (x != x1 || y != y1) {
+        int e2 = 2 * err;
+        if (e2 > -ady) { err -= ady; x += sx; }
+        if (e2 < adx)  { err += adx; y += sy; }
+        if (!visit(x, y, x == x1 && y == y1))
+            return false;
+    }
+    return true;
+}
+
+bool los_clear(int x0, int y0, int x1, int y1) {
+    return walk_line(x0, y0, x1, y1, [](int x, int y, bool last) {
+        return last || bit_test(walkable, x, y);
+    });
+}
+
+bool los_trace(int x0, int y0, int x1, int y1, int &hx, int &hy) {
+    bool hit_monster = false;
+    hx = x0;
+    hy = y0;
+    walk_line(x0, y0, x1, y1, [&](int x, int y, bool) {
+        hx = x;
+        hy = y;
+        if (char_map[y][x] >= 0 && monster_at(x, y)) {
+            hit_monster = true;
+            return false;
+        }
+        return bit_test(walkable, x, y);
+    });
+    return hit_monster;
+}
+
+std::vector<std::pair<int, int>> los_line(int x0, int y0, int x1, int y1) {
+    std::vector<std::pair<int, int>> out;
+    walk_line(x0, y0, x1, y1, [&](int x, int y, bool) {
+        out.emplace_back(x, y);
+        return true;
+    });
+    return out;
+}
+
+void los_terrain_changed(int x, int y) {
+    if (hardness[y][x] == 0)
+        bit_set(walkable, x, y);
+    else
+        bit_clear(walkable, x, y);
+}
+
+void los_sync() {
+    los_init();
+    if (walkable_gen == terrain_generation)
+        return;
+    bits_clear_all(walkable);
+    for (int y = 0; y < HEIGHT; y++)
+        for (int x = 0; x < WIDTH; x++)
+            if (hardness[y][x] == 0)
+                bit_set(walkable, x, y);
+    walkable_gen = terrain_generation;
+}
@@ -5,13 +5,27 @@
 #include "ui.h"
 #include "monster_template.h"
 #include "object_generator.h"
+#include "animation.h"
+#include "renderer.h"
+#include "metrics.h"
+#include "travel.h"
+#include "commands.h"
+#include "snapshot.h"
+#include "autosave.h"
+#include "journal.h"
+#include "rng.h"
+#include "level_cache.h"
+#include "zobrist.h"
+#include "fileio.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
 #include <cstring>
 #include <cstdlib>
 #include <ctime>
 #include <iostream>
 #include <queue>
-#include <curses.h>
 
 
 #ifdef __APPLE__
@@ -24,18 +38,28 @@
   #include <endian.h>
 #endif
 
-// Comparator for the event queue (min-heap based on event time)
+// Comparator for the event queue (min-heap based on event time). Ties go
+// to the lower character index, so the order depends only on what is
+// queued and not on how: a queue rebuilt from next_time after a restore
+// runs turns in the same order as the original.
 struct EventComparator {
     bool operator()(const event_t &a, const event_t &b) const {
-        return a.time > b.time;
+        if (a.time != b.time)
+            return a.time > b.time;
+        return a.c > b.c;
     }
 };
 
 int main(int argc, char* argv[]) {
-    srand(time(nullptr));
+    rng_seed(time(nullptr));
     
-    bool load = false, save = false, parse_mode = false;
+    bool load = false, save = false, parse_mode = false, dump_metrics = false;
+    bool journal = false, recover = false;
+    std::string record_path, replay_path;
+    int seek_turn = -1;
     int local_num_mon = DEFAULT_NUMMON;
+    int autosave_turns = 0;
+    int level_cache_mb = LEVEL_CACHE_DEFAULT_MB;
     for (int i = 1; i < argc; i++) {
         if (strcmp(argv[i], "--load") == 0)
             load = true;
@@ -43,11 +67,62 @@ int main(int argc, char* argv[]) {
             save = true;
         else if (strcmp(argv[i], "--nummon") == 0 && i + 1 < argc)
             local_num_mon = std::atoi(argv[++i]);
+        else if (strcmp(argv[i], "--renderer") == 0 && i + 1 < argc) {
+            std::string name = argv[++i];
+            // Headless has no keyboard, so it is only for tools and benches.
+            std::unique_ptr<Renderer> r = name == "headless" ? nullptr : make_renderer(name);
+            if (!r) {
+                std::cerr << "Unknown renderer '" << name << "' (ncurses, ansi).\n";
+                return 1;
+            }
+            set_renderer(std::move(r));
+        }
+        else if (strcmp(argv[i], "--metrics") == 0)
+            dump_metrics = true;
+        else if (strcmp(argv[i], "--autosave") == 0 && i + 1 < argc)
+            autosave_turns = std::atoi(argv[++i]);
+        else if (strcmp(argv[i], "--level-cache") == 0 && i + 1 < argc)
+            level_cache_mb = std::max(0, std::atoi(argv[++i]));
+        else if (strcmp(argv[i], "--journal") == 0)
+            journal = true;
+        else if (strcmp(argv[i], "--recover") == 0)
+            recover = journal = true;
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+            rng_seed(std::strtoull(argv[++i], nullptr, 10));
+        else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+            record_path = argv[++i];
+        else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc)
+            replay_path = argv[++i];
+        else if (strcmp(argv[i], "--seek") == 0 && i + 1 < argc)
+            seek_turn = std::atoi(argv[++i]);
+        else if (strcmp(argv[i], "--no-anim") == 0)
+            anim_set_enabled(false);
         else if (strcmp(argv[i], "--parse") == 0) {
                 parse_mode = true;
         }
     }
     
+    // A replay without --seek runs to the end of the recording with nothing
+    // drawn and reports how long it took; with --seek the game carries on
+    // from that turn, and can be recorded afresh.
+    bool replay_only = !replay_path.empty() && seek_turn < 0;
+    if (journal && (!record_path.empty() || !replay_path.empty())) {
+        std::cerr << "--journal and --recover do not combine with --record or --replay.\n";
+        return 1;
+    }
+    if (seek_turn >= 0 && replay_path.empty()) {
+        std::cerr << "--seek needs --replay.\n";
+        return 1;
+    }
+    if (replay_only && !record_path.empty()) {
+        std::cerr << "--record with --replay needs --seek.\n";
+        return 1;
+    }
+    if (replay_only) {
+        set_renderer(make_renderer("headless"));
+        anim_set_enabled(false);
+    }
+
     // setup dungeon: check directory, get file path, load or generate dungeon.
     checkDir();
     char path[1024];
@@ -61,6 +136,8 @@ int main(int argc, char* argv[]) {
         std::cerr << "Warning: No valid monster templates loaded.\n";
     }
 
+    keymap_init(std::string(home) + "/.rlg327/keymap.txt");
+
     std::string opath = std::string(home) + "/.rlg327/object_desc.txt";
     object_templates = parse_objects(opath);
     std::cout << "Loaded " << object_templates.size() << " object templates.\n";
@@ -78,8 +155,29 @@ int main(int argc, char* argv[]) {
     }
     
     
-    if (load) {
-        load_dungeon(path);
+    // Levels left by the stairs go next to the save, in a file for each
+    // game, where that game's snapshots find them again; a recording gets
+    // a copy when the session ends. A replay goes on from a copy of the
+    // recording's as a game of its own; with nothing to keep afterwards,
+    // an unlinked one.
+    level_cache_set_budget(size_t(level_cache_mb) << 20);
+    archive_set_prefix(std::string(path) + ".", replay_only);
+    if (!replay_path.empty())
+        archive_import(replay_path + ".levels");
+
+    // A version 1 save brings back the whole session; a version 0 file
+    // only the level, which is then populated as usual.
+    // --recover does the same from the journal's checkpoint.
+    LoadKind loaded = LoadKind::Failed;
+    std::string journal_dir = std::string(home) + "/.rlg327";
+    if (recover || !replay_path.empty()) {
+        if (recover ? !journal_recover(journal_dir) : !journal_load_recording(replay_path, seek_turn))
+            return 1;
+        loaded = LoadKind::Session;
+    } else if (load) {
+        loaded = load_game(path);
+        if (loaded == LoadKind::Failed)
+            return 1;
     } else {
         initializeDungeon();
         generateRooms();
@@ -93,40 +191,64 @@ int main(int argc, char* argv[]) {
             pc_y = 1;
         }
     }
-    base_map = dungeon;  // save a copy of the current dungeon.
-    placePC(pc_x, pc_y);
-    generate_objects(10);  // generate some objects in the dungeon.
+    if (loaded != LoadKind::Session) {
+        dungeon_depth = 0;
+        archive_new_game();
+        base_map = dungeon;  // save a copy of the current dungeon.
+        placePC(pc_x, pc_y);
+        generate_objects(10);  // generate some objects in the dungeon.
+    }
     
     if (save) {
-        save_dungeon(path);
+        if (loaded == LoadKind::Session) {
+            if (!save_snapshot(path))
+                std::cerr << "Error writing " << path << ": " << strerror(errno) << std::endl;
+        } else
+            save_dungeon(path);
     }
     
-    // compute initial distances for monsters.
-    djikstraForNonTunnel(pc_x, pc_y);
-    djikstraForTunnel(pc_x, pc_y);
-    
     // create the player character and monsters.
-    characters.clear();
-    create_pc();
-    for (int i = 0; i < local_num_mon; i++) {
-        create_monster();
+    if (loaded != LoadKind::Session) {
+        characters.clear();
+        characters.reserve(local_num_mon + 1);
+        create_pc();
+        for (int i = 0; i < local_num_mon; i++) {
+            create_monster();
+        }
     }
     
-    // build a priority event queue for scheduling actions.
+    // build a priority event queue for scheduling actions. Each character
+    // keeps its slot in next_time so a saved session resumes on schedule.
     std::priority_queue<event_t, std::vector<event_t>, EventComparator> eventQueue;
+    auto schedule = [&eventQueue](character_t &ch, int time) {
+        ch.next_time = time;
+        eventQueue.push({time, &ch});
+    };
     for (auto &ch : characters) {
-        event_t e;
-        e.time = 0;
-        e.c = &ch;
-        eventQueue.push(e);
+        if (ch.alive)
+            schedule(ch, ch.next_time);
     }
+    zobrist_rehash();
     
-    init_curses();
-    int current_time = 0;
-    int aliveMonsters = local_num_mon;
+    // Report after the screen is torn down, whichever way the game ends.
+    if (dump_metrics)
+        std::atexit([]() { metrics_dump(stderr); });
+    if (autosave_turns > 0)
+        autosave_start(path, autosave_turns);
+    init_screen();
+    auto replay_start = std::chrono::steady_clock::now();
+    if (journal)
+        journal_start(JournalTarget::Crash, journal_dir);
+    else if (!record_path.empty())
+        journal_start(JournalTarget::Recording, record_path);
+    else
+        journal_start(JournalTarget::None, "");
+    int current_time = characters[0].next_time;
+    std::vector<character_t*> batch;
     
     // main game loop: process events until the PC dies or all monsters are dead.
-    while (!eventQueue.empty() && pc_is_alive && aliveMonsters > 0) {
+    while (!eventQueue.empty() && pc_is_alive && monsters_alive > 0 && !game_quit &&
+           !journal_replay_finished()) {
         event_t e = eventQueue.top();
         eventQueue.pop();
         current_time = e.time;
@@ -136,52 +258,122 @@ int main(int argc, char* argv[]) {
             continue;
         
         if (c->type == CharType::PC) {
-            display_dungeon();
-            handle_pc_input(*c);
+            // A trip in progress plays the turn without drawing; the map is
+            // only shown again once it stops. Typed-ahead keys are likewise
+            // handled without a frame each.
+            if (!travel_step(*c)) {
+                if (!input_pending()) {
+                    if (journal_replaying())
+                        update_view();
+                    else
+                        display_dungeon();
+                }
+                handle_pc_input(*c);
+            }
+            if (game_quit) {
+                // Saved before the turn is counted, so the PC moves first
+                // when the game is resumed.
+                autosave_stop();
+                if (save_snapshot(path))
+                    display_message("Game saved. Resume with --load.");
+                else
+                    display_message(std::string("Could not save: ") + strerror(errno));
+                break;
+            }
+            if (level_changed) {
+                // new_level() rebuilt characters, so every queued pointer is
+                // stale; restart the schedule from the new roster.
+                level_changed = false;
+                eventQueue = {};
+                for (auto &ch : characters)
+                    schedule(ch, current_time);
+                zobrist_rehash();
+                autosave_now();
+                // The PC was made anew and characters may have moved.
+                journal_end_turn(characters[0]);
+                continue;
+            }
             if (c->type == CharType::PC) {
                 if (c->turn % 5 == 0 && c->mana < c->max_mana) { // every 5 turns
                     c->mana++;
-                    display_message("You feel your mana slowly returning...");
+                    display_message("You feel your mana slowly returning...", false);
                 }
             }            
-            if (pc_is_alive) {
-                // recompute distances after PC moves.
-                pc_x = c->x;
-                pc_y = c->y;
-                djikstraForNonTunnel(pc_x, pc_y);
-                djikstraForTunnel(pc_x, pc_y);
-            }
             c->turn++;
-        } else {  // monster turn.
-            do_monster_movement(*c);
-            c->turn++;
-            if (!pc_is_alive)
-                break;
-            if (!c->alive)
-                aliveMonsters--;
+            if (c->alive) {
+                schedule(*c, current_time + (1000 / c->speed));
+            }
+            autosave_turn(c->turn);
+            journal_end_turn(*c);
+            continue;
         }
-        
-        if (c->alive) {
-            int next_time = current_time + (1000 / c->speed);
-            event_t ne;
-            ne.time = next_time;
-            ne.c = c;
-            eventQueue.push(ne);
+
+        // monster turn: gather every monster due on this tick, decide their
+        // moves together and apply them in id order.
+        batch.clear();
+        batch.push_back(c);
+        while (!eventQueue.empty() && eventQueue.top().time == current_time &&
+               eventQueue.top().c->type == CharType::Monster) {
+            if (eventQueue.top().c->alive)
+                batch.push_back(eventQueue.top().c);
+            eventQueue.pop();
         }
+        do_monster_turns(batch);
+        if (!pc_is_alive)
+            break;
+        for (character_t* m : batch) {
+            m->turn++;
+            if (m->alive)
+                schedule(*m, current_time + (1000 / m->speed));
+        }
+    }
+    journal_stop();
+
+    if (replay_only) {
+        end_screen();
+        archive_close();
+        double ms = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - replay_start).count();
+        replay_stats_t r = journal_replay_stats();
+        std::printf("Replayed %d of %d turns in %.1f ms (%.0f turns/s)\n", r.played, r.total, ms,
+                    ms > 0 ? r.played * 1000.0 / ms : 0.0);
+        if (r.diverged_at >= 0) {
+            std::printf("Diverged from the recording at turn %d\n", r.diverged_at);
+            return 1;
+        }
+        if (r.played < r.total) {
+            std::printf("The game ended before the recording did\n");
+            return 1;
+        }
+        return 0;
     }
     
-    if (!pc_is_alive) {
+    if (game_quit) {
+        display_dungeon();
+    } else if (!pc_is_alive) {
         display_dungeon();
         display_message("You lose! The PC has been killed.");
-    } else if (aliveMonsters == 0) {
+    } else if (monsters_alive == 0) {
         display_dungeon();
         display_message("You win! All monsters have been slain.");
     } else {
         display_message("Simulation ended early (queue empty?).");
     }
     
-    getch();
-    end_curses();
+    screen_getch();
+    autosave_stop();
+    std::string archive_file = archive_path();
+    archive_close();
+    end_screen();
+    if (!record_path.empty() && !archive_file.empty()) {
+        std::vector<uint8_t> levels;
+        std::string copy = record_path + ".levels";
+        if (!read_file(archive_file.c_str(), levels) || !write_file(copy.c_str(), levels))
+            std::cerr << "Error writing " << copy << ": " << strerror(errno) << std::endl;
+    }
+    // Levels of games no save refers to any more are of no use.
+    archive_prune({snapshot_game_id(path),
+                   snapshot_game_id(journal_checkpoint_path(journal_dir).c_str())});
     
     return 0;
 }
@@ -0,0 +1,94 @@
+#include "message_log.h"
+#include "global.h"
+#include "renderer.h"
+#include "metrics.h"
+#include <algorithm>
+#include <array>
+
+static std::array<log_entry_t, MESSAGE_LOG_SIZE> ring;
+static long next_seq = 0;       // entry n lives in ring[n % MESSAGE_LOG_SIZE]
+static long unshown_from = 0;   // first entry not yet on the message line
+static std::string line_text;   // what the message line shows
+static bool line_valid = false;
+static long interrupts_posted = 0;
+
+void message_log_add(const std::string &msg, bool interrupts) {
+    if (interrupts)
+        interrupts_posted++;
+    if (next_seq > 0) {
+        log_entry_t &last = ring[(next_seq - 1) % MESSAGE_LOG_SIZE];
+        if (last.text == msg) {
+            last.count++;
+            unshown_from = std::min(unshown_from, next_seq - 1);
+            return;
+        }
+    }
+    ring[next_seq % MESSAGE_LOG_SIZE] = {msg, 1};
+    next_seq++;
+    unshown_from = std::max(unshown_from, next_seq - MESSAGE_LOG_SIZE);
+}
+
+long message_log_interrupts() {
+    return interrupts_posted;
+}
+
+int message_log_size() {
+    return static_cast<int>(std::min<long>(next_seq, MESSAGE_LOG_SIZE));
+}
+
+const log_entry_t& message_log_entry(int i) {
+    long first = next_seq - message_log_size();
+    return ring[(first + i) % MESSAGE_LOG_SIZE];
+}
+
+std::string message_log_format(const log_entry_t &e) {
+    if (e.count > 1)
+        return e.text + " (x" + std::to_string(e.count) + ")";
+    return e.text;
+}
+
+// Newest messages that fit on one line; older ones are counted in a
+// "[+N]" prefix and can be read in the scrollback view.
+static std::string compose_line() {
+    const int width = WIDTH;
+    std::string line;
+    long seq = next_seq - 1;
+    for (; seq >= unshown_from; seq--) {
+        std::string msg = message_log_format(ring[seq % MESSAGE_LOG_SIZE]);
+        int needed = static_cast<int>(msg.size() + (line.empty() ? 0 : 2));
+        if (!line.empty() && static_cast<int>(line.size()) + needed > width - 6)
+            break;
+        line = line.empty() ? msg : msg + "  " + line;
+    }
+    long hidden = seq - unshown_from + 1;
+    if (hidden > 0)
+        line = "[+" + std::to_string(hidden) + "] " + line;
+    if (static_cast<int>(line.size()) > width)
+        line.resize(width);
+    return line;
+}
+
+void messages_draw() {
+    if (unshown_from < next_seq) {
+        line_text = compose_line();
+        unshown_from = next_seq;
+        line_valid = false;
+    }
+    if (line_valid)
+        return;
+    renderer().clear_line(0);
+    renderer().put(0, 0, line_text.data(), static_cast<int>(line_text.size()), 0);
+    line_valid = true;
+}
+
+void messages_flush() {
+    if (unshown_from >= next_seq)
+        return;
+    metrics_frame_begin();
+    messages_draw();
+    screen_refresh();
+}
+
+void messages_invalidate() {
+    line_valid = false;
+}
@@ -0,0 +1,114 @@
+#include "metrics.h"
+#include "renderer.h"
+#include "level_cache.h"
+#include <algorithm>
+#include <chrono>
+
+using metrics_clock = std::chrono::steady_clock;
+
+static RollingHistogram series[static_cast<int>(MetricSeries::COUNT)];
+static const char* const SERIES_NAMES[] = {
+    "build us", "flush us", "bytes", "writes",
+    "capture us", "save us", "save queue",
+    "journal us", "level us",
+};
+
+static bool building = false;
+static metrics_clock::time_point build_start, flush_start;
+static io_counts_t io_before;
+
+void RollingHistogram::add(double v) {
+    if (static_cast<int>(samples.size()) < METRICS_WINDOW) {
+        samples.push_back(v);
+    } else {
+        samples[next] = v;
+        next = (next + 1) % METRICS_WINDOW;
+    }
+    total++;
+}
+
+double RollingHistogram::percentile(double p) const {
+    if (samples.empty())
+        return 0;
+    std::vector<double> sorted(samples);
+    size_t k = static_cast<size_t>(p / 100.0 * (sorted.size() - 1) + 0.5);
+    std::nth_element(sorted.begin(), sorted.begin() + k, sorted.end());
+    return sorted[k];
+}
+
+double RollingHistogram::max() const {
+    return samples.empty() ? 0 : *std::max_element(samples.begin(), samples.end());
+}
+
+void RollingHistogram::reset() {
+    samples.clear();
+    next = 0;
+    total = 0;
+}
+
+static RollingHistogram& get(MetricSeries s) {
+    return series[static_cast<int>(s)];
+}
+
+static double us_between(metrics_clock::time_point a, metrics_clock::time_point b) {
+    return std::chrono::duration<double, std::micro>(b - a).count();
+}
+
+void metrics_frame_begin() {
+    if (!building) {
+        building = true;
+        build_start = metrics_clock::now();
+    }
+}
+
+void metrics_flush_begin() {
+    flush_start = metrics_clock::now();
+    if (building)
+        get(MetricSeries::BuildUs).add(us_between(build_start, flush_start));
+    building = false;
+    io_before = renderer().io_counts();
+}
+
+void metrics_flush_end() {
+    get(MetricSeries::FlushUs).add(us_between(flush_start, metrics_clock::now()));
+    io_counts_t io = renderer().io_counts();
+    get(MetricSeries::Bytes).add(static_cast<double>(io.bytes - io_before.bytes));
+    get(MetricSeries::Writes).add(static_cast<double>(io.writes - io_before.writes));
+}
+
+void metrics_record(MetricSeries s, double v) {
+    get(s).add(v);
+}
+
+const RollingHistogram& metrics_series(MetricSeries s) {
+    return series[static_cast<int>(s)];
+}
+
+void metrics_reset() {
+    for (auto &h : series)
+        h.reset();
+    building = false;
+}
+
+std::vector<std::string> metrics_report() {
+    std::vector<std::string> lines;
+    char buf[128];
+    snprintf(buf, sizeof(buf), "%-10s %8s %10s %10s %10s", "series", "samples", "p50", "p99", "max");
+    lines.push_back(buf);
+    for (int i = 0; i < static_cast<int>(MetricSeries::COUNT); i++) {
+        const RollingHistogram &h = series[i];
+        snprintf(buf, sizeof(buf), "%-10s %8ld %10.1f %10.1f %10.1f", SERIES_NAMES[i],
+                 h.count(), h.percentile(50), h.percentile(99), h.max());
+        lines.push_back(buf);
+    }
+    level_cache_stats_t c = level_cache_stats();
+    snprintf(buf, sizeof(buf), "levels: %ld hits, %ld misses (%ld archived), %ld evicted, %d held in %zu KiB",
+             c.hits, c.misses, c.archive_loads, c.evictions, c.levels, c.bytes >> 10);
+    lines.push_back(buf);
+    return lines;
+}
+
+void metrics_dump(FILE* out) {
+    for (const std::string &line : metrics_report())
+        fprintf(out, "%s\n", line.c_str());
+}
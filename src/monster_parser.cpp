@@ -1,27 +1,27 @@
 #include "monster_template.h"
-#include <fstream>
+#include "rng.h"
+#include "desc_reader.h"
+#include <cstdint>
 #include <iostream>
-#include <sstream>
-#include <regex>
-#include <unordered_set>
 
-Dice Dice::parse(const std::string& s) {
-    std::regex dice_regex(R"((-?\d+)\+(\d+)d(\d+))");
-    std::smatch match;
-    if (std::regex_match(s, match, dice_regex)) {
-        return Dice{ std::stoi(match[1]), std::stoi(match[2]), std::stoi(match[3]) };
-    } else {
-        throw std::runtime_error("Invalid dice format: " + s);
-    }
+bool Dice::parse(std::string_view s, Dice& out) {
+    Dice d;
+    if (!desc_number(s, d.base) || s.empty() || s[0] != '+')
+        return false;
+    s.remove_prefix(1);
+    if (s.empty() || s[0] == '-' || !desc_number(s, d.dice) || s.empty() || s[0] != 'd')
+        return false;
+    s.remove_prefix(1);
+    if (s.empty() || s[0] == '-' || !desc_number(s, d.sides) || !s.empty())
+        return false;
+    out = d;
+    return true;
 }
 
 int Dice::roll() const {
-    static std::random_device rd;
-    static std::mt19937 rng(rd());
     int total = base;
-    for (int i = 0; i < dice; ++i) {
-        std::uniform_int_distribution<int> dist(1, sides);
-        total += dist(rng);
+    for (int i = 0; i < dice && sides > 0; ++i) {
+        total += rng_below(RngStream::Combat, sides) + 1;
     }
     return total;
 }
@@ -30,88 +30,90 @@ std::string Dice::to_string() const {
     return std::to_string(base) + "+" + std::to_string(dice) + "d" + std::to_string(sides);
 }
 
+static const uint32_t MONSTER_FIELDS =
+    1u << KEY_NAME | 1u << KEY_DESC | 1u << KEY_SYMB | 1u << KEY_COLOR | 1u << KEY_SPEED |
+    1u << KEY_ABIL | 1u << KEY_HP | 1u << KEY_DAM | 1u << KEY_RRTY;
 
+// Entries with an error are reported with their line and skipped.
 std::vector<MonsterTemplate> parse_monsters(const std::string& filepath) {
-    std::ifstream in(filepath);
     std::vector<MonsterTemplate> monsters;
-    std::string line;
+    DescReader in(filepath);
+    std::string_view line;
 
-    if (!in || !std::getline(in, line) || line != "RLG327 MONSTER DESCRIPTION 1") {
+    if (!in.is_open() || !in.next_line(line) || line != "RLG327 MONSTER DESCRIPTION 1") {
         std::cerr << "Invalid monster file header.\n";
         return monsters;
     }
 
-    while (std::getline(in, line)) {
+    while (in.next_line(line)) {
         if (line != "BEGIN MONSTER") continue;
 
+        int begin = in.line_number();
         MonsterTemplate m;
-        std::unordered_set<std::string> fields;
+        uint32_t seen = 0;
         bool error = false;
 
-        while (std::getline(in, line) && line != "END") {
-            std::istringstream iss(line);
-            std::string keyword;
-            iss >> keyword;
+        while (!error && in.next_line(line) && line != "END") {
+            std::string_view rest = line, keyword = desc_word(rest), word;
+            DescKey key = desc_key(keyword);
+            if (key != KEY_UNKNOWN && (seen >> key & 1)) {
+                in.error(std::string(keyword) + " given twice");
+                error = true;
+                break;
+            }
+            seen |= 1u << key;
 
-            if (keyword == "NAME") {
-                if (!std::getline(iss >> std::ws, m.name) || fields.count("NAME")) { error = true; break; }
-                fields.insert("NAME");
-            } else if (keyword == "DESC") {
-                std::string desc, tmp;
-                while (std::getline(in, tmp) && tmp != ".") {
-                    desc += tmp + "\n";
-                }
-                if (fields.count("DESC")) { error = true; break; }
-                m.description = desc;
-                fields.insert("DESC");
-            } else if (keyword == "SYMB") {
-                char c;
-                if (!(iss >> c) || fields.count("SYMB")) { error = true; break; }
-                m.symbol = c;
-                fields.insert("SYMB");
-            } else if (keyword == "COLOR") {
-                std::string color;
-                while (iss >> color)
-                    m.colors.push_back(color);
-                if (fields.count("COLOR") || m.colors.empty()) { error = true; break; }
-                fields.insert("COLOR");
-            } else if (keyword == "SPEED") {
-                std::string dice_str;
-                iss >> dice_str;
-                try { m.speed = Dice::parse(dice_str); }
-                catch (...) { error = true; break; }
-                fields.insert("SPEED");
-            } else if (keyword == "ABIL") {
-                std::string abil;
-                while (iss >> abil)
-                    m.abilities.push_back(abil);
-                if (fields.count("ABIL") || m.abilities.empty()) { error = true; break; }
-                fields.insert("ABIL");
-            } else if (keyword == "HP") {
-                std::string dice_str;
-                iss >> dice_str;
-                try { m.hp = Dice::parse(dice_str); }
-                catch (...) { error = true; break; }
-                fields.insert("HP");
-            } else if (keyword == "DAM") {
-                std::string dice_str;
-                iss >> dice_str;
-                try { m.damage = Dice::parse(dice_str); }
-                catch (...) { error = true; break; }
-                fields.insert("DAM");
-            } else if (keyword == "RRTY") {
-                int val;
-                if (!(iss >> val) || fields.count("RRTY")) { error = true; break; }
-                m.rarity = val;
-                fields.insert("RRTY");
-            } else {
+            switch (key) {
+            case KEY_NAME:
+                rest = desc_trim(rest);
+                m.name.assign(rest);
+                error = rest.empty();
+                break;
+            case KEY_DESC:
+                desc_read_text(in, m.description);
+                break;
+            case KEY_SYMB:
+                rest = desc_trim(rest);
+                error = rest.empty();
+                if (!error)
+                    m.symbol = rest[0];
+                break;
+            case KEY_COLOR:
+                while (!(word = desc_word(rest)).empty())
+                    m.colors.emplace_back(word);
+                error = m.colors.empty();
+                break;
+            case KEY_ABIL:
+                while (!(word = desc_word(rest)).empty())
+                    m.abilities.emplace_back(word);
+                error = m.abilities.empty();
+                break;
+            case KEY_SPEED:
+                error = !Dice::parse(desc_word(rest), m.speed);
+                break;
+            case KEY_HP:
+                error = !Dice::parse(desc_word(rest), m.hp);
+                break;
+            case KEY_DAM:
+                error = !Dice::parse(desc_word(rest), m.damage);
+                break;
+            case KEY_RRTY:
+                word = desc_word(rest);
+                error = !desc_number(word, m.rarity) || !word.empty();
+                break;
+            default:
+                in.error("unknown monster field '" + std::string(keyword) + "'");
                 error = true;
                 break;
             }
+            if (error && (MONSTER_FIELDS >> key & 1))
+                in.error("bad " + std::string(keyword) + " line '" + std::string(line) + "'");
         }
 
-        if (!error && fields.size() == 9)
-            monsters.push_back(m);
+        if (!error && seen != MONSTER_FIELDS)
+            in.error("monster is " + desc_missing(MONSTER_FIELDS, seen), begin);
+        else if (!error)
+            monsters.push_back(std::move(m));
     }
 
     return monsters;
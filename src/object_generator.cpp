@@ -2,37 +2,30 @@
 #include "object_template.h"
 #include "object_instance.h"
 #include "global.h"
+#include "rng.h"
 #include <cstdlib>
 #include <vector> // Include vector for characters
 #include "character.h" // Include the header where characters are defined
+#include "occupancy.h"
 
 
 bool cell_is_occupied(int x, int y) {
     if (dungeon[y][x] != '.') return true;
-
-    for (const auto& ch : characters) {
-        if (ch.alive && ch.x == x && ch.y == y)
-            return true;
-    }
-
-    for (const auto& obj : object_instances) {
-        if (obj.x == x && obj.y == y)
-            return true;
-    }
-
-    return false;
+    return char_map[y][x] >= 0 || object_map[y][x] >= 0;
 }
 
 void generate_objects(int count) {
     object_instances.clear();
+    rebuild_object_map();
+    if (object_templates.empty()) return;
 
     for (int i = 0; i < count; ) {
         const ObjectTemplate* chosen = nullptr;
 
         for (int attempt = 0; attempt < 1000; ++attempt) {
-            const auto& candidate = object_templates[rand() % object_templates.size()];
+            const auto& candidate = object_templates[rng_below(RngStream::Level, object_templates.size())];
             if (candidate.artifact && seen_artifacts.count(candidate.name)) continue;
-            if ((rand() % 100) < candidate.rarity) {
+            if (rng_below(RngStream::Level, 100) < candidate.rarity) {
                 chosen = &candidate;
                 break;
             }
@@ -45,8 +38,8 @@ void generate_objects(int count) {
         // Find a safe, unoccupied floor tile
         int rx, ry, attempts = 0;
         do {
-            rx = rand() % WIDTH;
-            ry = rand() % HEIGHT;
+            rx = rng_below(RngStream::Level, WIDTH);
+            ry = rng_below(RngStream::Level, HEIGHT);
             attempts++;
         } while (cell_is_occupied(rx, ry) && attempts < 1000);
 
@@ -59,7 +52,7 @@ void generate_objects(int count) {
             seen_artifacts.insert(obj.name);
 
         object_instances.push_back(obj);
-        std::cout << "Placed " << object_instances.size() << " objects in the dungeon." << std::endl;
+        object_map[ry][rx] = static_cast<int>(object_instances.size()) - 1;
         ++i;
     }
 }
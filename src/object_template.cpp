@@ -1,11 +1,9 @@
 #include "object_template.h"
-#include <fstream>
-#include <sstream>
+#include "desc_reader.h"
+#include <cstdint>
 #include <iostream>
-#include <unordered_set>
-#include <regex>
 
-ObjectType parse_type(const std::string& type_str) {
+ObjectType parse_type(std::string_view type_str) {
     if (type_str == "WEAPON") return ObjectType::WEAPON;
     if (type_str == "OFFHAND") return ObjectType::OFFHAND;
     if (type_str == "RANGED") return ObjectType::RANGED;
@@ -48,80 +46,108 @@ ObjectInstance ObjectTemplate::generate_instance() const {
     return obj;
 }
 
+static const uint32_t OBJECT_FIELDS =
+    1u << KEY_NAME | 1u << KEY_DESC | 1u << KEY_TYPE | 1u << KEY_SYMB | 1u << KEY_COLOR |
+    1u << KEY_HIT | 1u << KEY_DODGE | 1u << KEY_DEF | 1u << KEY_WEIGHT | 1u << KEY_SPEED |
+    1u << KEY_ATTR | 1u << KEY_VAL | 1u << KEY_DAM | 1u << KEY_ART | 1u << KEY_RRTY;
+// Up to two fields may be left out.
+static const int OBJECT_MIN_FIELDS = 13;
+
+// Entries with an error are reported with their line and skipped.
 std::vector<ObjectTemplate> parse_objects(const std::string& filepath) {
-    std::ifstream in(filepath);
     std::vector<ObjectTemplate> objects;
-    std::string line;
+    DescReader in(filepath);
+    std::string_view line;
 
-    if (!in || !std::getline(in, line) || line != "RLG327 OBJECT DESCRIPTION 1") {
+    if (!in.is_open() || !in.next_line(line) || line != "RLG327 OBJECT DESCRIPTION 1") {
         std::cerr << "Invalid object file header.\n";
         return objects;
     }
 
-    while (std::getline(in, line)) {
+    while (in.next_line(line)) {
         if (line != "BEGIN OBJECT") continue;
 
+        int begin = in.line_number();
         ObjectTemplate obj;
-        std::unordered_set<std::string> fields;
+        uint32_t seen = 0;
         bool error = false;
 
-        while (std::getline(in, line) && line != "END") {
-            std::istringstream iss(line);
-            std::string keyword;
-            iss >> keyword;
+        while (!error && in.next_line(line) && line != "END") {
+            std::string_view rest = line, keyword = desc_word(rest), word;
+            DescKey key = desc_key(keyword);
+            if (key != KEY_UNKNOWN && (seen >> key & 1)) {
+                in.error(std::string(keyword) + " given twice");
+                error = true;
+                break;
+            }
+            seen |= 1u << key;
 
-            if (keyword == "NAME") {
-                if (!std::getline(iss >> std::ws, obj.name) || fields.count("NAME")) { error = true; break; }
-                fields.insert("NAME");
-            } else if (keyword == "DESC") {
-                std::string desc, tmp;
-                while (std::getline(in, tmp) && tmp != ".") desc += tmp + "\n";
-                if (fields.count("DESC")) { error = true; break; }
-                obj.description = desc;
-                fields.insert("DESC");
-            } else if (keyword == "TYPE") {
-                std::string type_str;
-                iss >> type_str;
-                obj.type = parse_type(type_str);
-                fields.insert("TYPE");
-            } else if (keyword == "SYMB") {
-                char c;
-                if (!(iss >> c)) { error = true; break; }
-                obj.symbol = c;
-                fields.insert("SYMB");
-            } else if (keyword == "COLOR") {
-                std::string c;
-                while (iss >> c) obj.colors.push_back(c);
-                fields.insert("COLOR");
-            } else if (keyword == "HIT") {
-                std::string s; iss >> s; obj.hit = Dice::parse(s); fields.insert("HIT");
-            } else if (keyword == "DODGE") {
-                std::string s; iss >> s; obj.dodge = Dice::parse(s); fields.insert("DODGE");
-            } else if (keyword == "DEF") {
-                std::string s; iss >> s; obj.defense = Dice::parse(s); fields.insert("DEF");
-            } else if (keyword == "WEIGHT") {
-                std::string s; iss >> s; obj.weight = Dice::parse(s); fields.insert("WEIGHT");
-            } else if (keyword == "SPEED") {
-                std::string s; iss >> s; obj.speed = Dice::parse(s); fields.insert("SPEED");
-            } else if (keyword == "ATTR") {
-                std::string s; iss >> s; obj.attribute = Dice::parse(s); fields.insert("ATTR");
-            } else if (keyword == "VAL") {
-                std::string s; iss >> s; obj.value = Dice::parse(s); fields.insert("VAL");
-            } else if (keyword == "DAM") {
-                std::string s; iss >> s; obj.damage = Dice::parse(s); fields.insert("DAM");
-            } else if (keyword == "ART") {
-                std::string a; iss >> a;
-                obj.artifact = (a == "TRUE");
-                fields.insert("ART");
-            } else if (keyword == "RRTY") {
-                int r; iss >> r; obj.rarity = r; fields.insert("RRTY");
-            } else {
+            switch (key) {
+            case KEY_NAME:
+                rest = desc_trim(rest);
+                obj.name.assign(rest);
+                error = rest.empty();
+                break;
+            case KEY_DESC:
+                desc_read_text(in, obj.description);
+                break;
+            case KEY_TYPE:
+                obj.type = parse_type(desc_word(rest));
+                break;
+            case KEY_SYMB:
+                rest = desc_trim(rest);
+                error = rest.empty();
+                if (!error)
+                    obj.symbol = rest[0];
+                break;
+            case KEY_COLOR:
+                while (!(word = desc_word(rest)).empty())
+                    obj.colors.emplace_back(word);
+                break;
+            case KEY_HIT:
+                error = !Dice::parse(desc_word(rest), obj.hit);
+                break;
+            case KEY_DODGE:
+                error = !Dice::parse(desc_word(rest), obj.dodge);
+                break;
+            case KEY_DEF:
+                error = !Dice::parse(desc_word(rest), obj.defense);
+                break;
+            case KEY_WEIGHT:
+                error = !Dice::parse(desc_word(rest), obj.weight);
+                break;
+            case KEY_SPEED:
+                error = !Dice::parse(desc_word(rest), obj.speed);
+                break;
+            case KEY_ATTR:
+                error = !Dice::parse(desc_word(rest), obj.attribute);
+                break;
+            case KEY_VAL:
+                error = !Dice::parse(desc_word(rest), obj.value);
+                break;
+            case KEY_DAM:
+                error = !Dice::parse(desc_word(rest), obj.damage);
+                break;
+            case KEY_ART:
+                obj.artifact = desc_word(rest) == "TRUE";
+                break;
+            case KEY_RRTY:
+                word = desc_word(rest);
+                error = !desc_number(word, obj.rarity) || !word.empty();
+                break;
+            default:
+                in.error("unknown object field '" + std::string(keyword) + "'");
                 error = true;
                 break;
             }
+            if (error && (OBJECT_FIELDS >> key & 1))
+                in.error("bad " + std::string(keyword) + " line '" + std::string(line) + "'");
         }
 
-        if (!error && fields.size() >= 13) objects.push_back(obj);
+        if (!error && __builtin_popcount(seen) < OBJECT_MIN_FIELDS)
+            in.error("object is " + desc_missing(OBJECT_FIELDS, seen), begin);
+        else if (!error)
+            objects.push_back(std::move(obj));
     }
 
     return objects;
@@ -0,0 +1,149 @@
+#include "occupancy.h"
+#include "global.h"
+#include "character.h"
+#include "fov.h"
+#include "zobrist.h"
+#include "rollback.h"
+
+void rebuild_char_map() {
+    for (auto &row : char_map)
+        row.fill(-1);
+    for (size_t i = 0; i < characters.size(); i++) {
+        const character_t &c = characters[i];
+        if (c.alive)
+            char_map[c.y][c.x] = static_cast<int>(i);
+    }
+}
+
+void rebuild_object_map() {
+    for (auto &row : object_map)
+        row.fill(-1);
+    // Walk backwards so the first object on a stacked cell wins, matching
+    // the old front-to-back scans.
+    for (int i = static_cast<int>(object_instances.size()) - 1; i >= 0; i--) {
+        const ObjectInstance &o = object_instances[i];
+        if (o.x >= 0 && o.y >= 0)
+            object_map[o.y][o.x] = i;
+    }
+}
+
+character_t* monster_at(int x, int y) {
+    if (x < 0 || x >= WIDTH || y < 0 || y >= HEIGHT)
+        return nullptr;
+    int idx = char_map[y][x];
+    if (idx < 0)
+        return nullptr;
+    character_t &c = characters[idx];
+    if (!c.alive || c.type != CharType::Monster)
+        return nullptr;
+    return &c;
+}
+
+void monsters_in_view(std::vector<int> &out) {
+    out.clear();
+    if (fog_toggle) {
+        for (size_t i = 0; i < characters.size(); i++) {
+            const character_t &c = characters[i];
+            if (c.alive && c.type == CharType::Monster)
+                out.push_back(static_cast<int>(i));
+        }
+        return;
+    }
+    for (int y = pc_y - LIGHT_RADIUS; y <= pc_y + LIGHT_RADIUS; y++) {
+        for (int x = pc_x - LIGHT_RADIUS; x <= pc_x + LIGHT_RADIUS; x++) {
+            if (!fov_visible(x, y))
+                continue;
+            if (monster_at(x, y))
+                out.push_back(char_map[y][x]);
+        }
+    }
+}
+
+int object_at(int x, int y) {
+    if (x < 0 || x >= WIDTH || y < 0 || y >= HEIGHT)
+        return -1;
+    return object_map[y][x];
+}
+
+void move_character(character_t &c, int nx, int ny) {
+    int idx = static_cast<int>(&c - characters.data());
+    rollback_touch_character(idx);
+    rollback_touch_cell(c.x, c.y);
+    rollback_touch_cell(nx, ny);
+    dungeon[c.y][c.x] = base_map[c.y][c.x];
+    if (char_map[c.y][c.x] == idx)
+        char_map[c.y][c.x] = -1;
+    zobrist_moved(idx, c.x, c.y, nx, ny);
+    c.x = nx;
+    c.y = ny;
+    if (c.type == CharType::PC) {
+        pc_x = nx;
+        pc_y = ny;
+    }
+    dungeon[ny][nx] = (c.type == CharType::PC) ? '@' : c.symbol;
+    char_map[ny][nx] = idx;
+}
+
+void kill_character(character_t &c) {
+    if (!c.alive)
+        return;
+    int idx = static_cast<int>(&c - characters.data());
+    c.alive = false;
+    zobrist_died(idx);
+    rollback_touch_character(idx);
+    rollback_touch_cell(c.x, c.y);
+    dungeon[c.y][c.x] = base_map[c.y][c.x];
+    if (char_map[c.y][c.x] == idx)
+        char_map[c.y][c.x] = -1;
+    if (c.type == CharType::Monster)
+        monsters_alive--;
+}
+
+void set_hp(character_t &c, int hp) {
+    int idx = static_cast<int>(&c - characters.data());
+    zobrist_hp(idx, c.hp, hp);
+    rollback_touch_character(idx);
+    c.hp = hp;
+}
+
+void set_hardness(int x, int y, int h) {
+    zobrist_terrain(x, y, hardness[y][x], h);
+    rollback_touch_cell(x, y);
+    hardness[y][x] = h;
+}
+
+void place_object(const ObjectInstance &o) {
+    object_instances.push_back(o);
+    zobrist_object_added(o);
+    rollback_touch_objects();
+    rollback_touch_cell(o.x, o.y);
+    if (object_map[o.y][o.x] < 0)
+        object_map[o.y][o.x] = static_cast<int>(object_instances.size()) - 1;
+}
+
+void remove_object(int idx) {
+    zobrist_object_removed(object_instances[idx]);
+    rollback_touch_objects();
+    int last = static_cast<int>(object_instances.size()) - 1;
+    int ox = object_instances[idx].x, oy = object_instances[idx].y;
+    rollback_touch_cell(ox, oy);
+    if (idx != last) {
+        object_instances[idx] = std::move(object_instances[last]);
+        const ObjectInstance &moved = object_instances[idx];
+        rollback_touch_cell(moved.x, moved.y);
+        if (object_map[moved.y][moved.x] == last)
+            object_map[moved.y][moved.x] = idx;
+    }
+    object_instances.pop_back();
+
+    if (object_map[oy][ox] == idx || object_map[oy][ox] == last) {
+        // Another object may still be stacked on the vacated cell.
+        object_map[oy][ox] = -1;
+        for (size_t i = 0; i < object_instances.size(); i++) {
+            if (object_instances[i].x == ox && object_instances[i].y == oy) {
+                object_map[oy][ox] = static_cast<int>(i);
+                break;
+            }
+        }
+    }
+}
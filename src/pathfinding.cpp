@@ -74,3 +74,39 @@ void djikstraForNonTunnel(int sx, int sy) {
         }
     }
 }
+
+// Origin and level each map was last built for.
+struct map_stamp_t {
+    bool valid = false;
+    int x = -1, y = -1;
+    unsigned gen = 0;
+};
+
+static map_stamp_t tunnel_stamp, non_tunnel_stamp;
+
+static bool stamp_current(const map_stamp_t &s) {
+    return s.valid && s.x == pc_x && s.y == pc_y && s.gen == terrain_generation;
+}
+
+static void stamp(map_stamp_t &s) {
+    s.valid = true;
+    s.x = pc_x;
+    s.y = pc_y;
+    s.gen = terrain_generation;
+}
+
+void ensure_distance_maps(bool tunnel, bool non_tunnel) {
+    if (tunnel && !stamp_current(tunnel_stamp)) {
+        djikstraForTunnel(pc_x, pc_y);
+        stamp(tunnel_stamp);
+    }
+    if (non_tunnel && !stamp_current(non_tunnel_stamp)) {
+        djikstraForNonTunnel(pc_x, pc_y);
+        stamp(non_tunnel_stamp);
+    }
+}
+
+void pathfinding_terrain_changed() {
+    tunnel_stamp.valid = false;
+    non_tunnel_stamp.valid = false;
+}
@@ -0,0 +1,26 @@
+#include "record_codec.h"
+#include "global.h"
+
+bool in_map(int x, int y) {
+    return x >= 0 && x < WIDTH && y >= 0 && y < HEIGHT;
+}
+
+std::string join_colors(const std::vector<std::string> &colors) {
+    std::string joined;
+    for (const std::string &c : colors)
+        joined += (joined.empty() ? "" : " ") + c;
+    return joined;
+}
+
+std::vector<std::string> split_colors(const std::string &s) {
+    std::vector<std::string> out;
+    size_t start = 0;
+    while (start < s.size()) {
+        size_t end = s.find(' ', start);
+        if (end == std::string::npos)
+            end = s.size();
+        out.push_back(s.substr(start, end - start));
+        start = end + 1;
+    }
+    return out;
+}
@@ -0,0 +1,66 @@
+#include "render.h"
+#include "global.h"
+#include "renderer.h"
+
+frame_t render_next;
+
+// What the terminal currently shows for the map area.
+static frame_t render_shown;
+static bool shown_valid = false;
+
+// Unchanged cells shorter than this between two changed runs of the same
+// colour are re-sent rather than paying for a cursor move.
+static const int RUN_MERGE_GAP = 3;
+
+static void emit_run(int y, int x0, int x1, int pair) {
+    renderer().put(y + 1, x0, &render_next.glyph[y][x0], x1 - x0, pair);  // offset for message line
+}
+
+void render_present() {
+    for (int y = 0; y < HEIGHT; y++) {
+        const auto &ng = render_next.glyph[y];
+        const auto &nc = render_next.color[y];
+        auto &sg = render_shown.glyph[y];
+        auto &sc = render_shown.color[y];
+
+        int x = 0;
+        while (x < WIDTH) {
+            if (shown_valid && ng[x] == sg[x] && nc[x] == sc[x]) {
+                x++;
+                continue;
+            }
+            // Start of a dirty run; extend it while the colour holds,
+            // swallowing short clean gaps.
+            int pair = nc[x];
+            int end = x + 1;
+            int scan = end;
+            while (scan < WIDTH && nc[scan] == pair) {
+                if (!shown_valid || ng[scan] != sg[scan] || nc[scan] != sc[scan])
+                    end = scan + 1;
+                else if (scan - end >= RUN_MERGE_GAP)
+                    break;
+                scan++;
+            }
+            emit_run(y, x, end, pair);
+            for (int i = x; i < end; i++) {
+                sg[i] = ng[i];
+                sc[i] = nc[i];
+            }
+            x = end;
+        }
+    }
+    shown_valid = true;
+    screen_refresh();
+}
+
+void render_overlay(int x, int y, char glyph, int pair) {
+    if (x < 0 || x >= WIDTH || y < 0 || y >= HEIGHT)
+        return;
+    renderer().put(y + 1, x, &glyph, 1, pair);  // offset for message line
+    render_shown.glyph[y][x] = glyph;
+    render_shown.color[y][x] = static_cast<uint8_t>(pair);
+}
+
+void render_invalidate() {
+    shown_valid = false;
+}
@@ -0,0 +1,149 @@
+#include "renderer.h"
+#include "global.h"
+#include "metrics.h"
+#include "message_log.h"
+#include <algorithm>
+#include <cstdarg>
+
+static std::unique_ptr<Renderer> current;
+static InputTap* input_tap = nullptr;
+
+std::unique_ptr<Renderer> make_renderer(const std::string &name) {
+    if (name == "ncurses")
+        return std::unique_ptr<Renderer>(new NcursesRenderer());
+    if (name == "ansi")
+        return std::unique_ptr<Renderer>(new AnsiRenderer());
+    if (name == "headless")
+        // Message line, the map, and room below for the status screens.
+        return std::unique_ptr<Renderer>(new HeadlessRenderer(HEIGHT + 3, std::max(WIDTH, 80)));
+    return nullptr;
+}
+
+Renderer& renderer() {
+    if (!current)
+        current.reset(new NcursesRenderer());
+    return *current;
+}
+
+void set_renderer(std::unique_ptr<Renderer> r) {
+    current = std::move(r);
+}
+
+std::unique_ptr<Renderer> swap_renderer(std::unique_ptr<Renderer> r) {
+    std::swap(current, r);
+    return r;
+}
+
+void set_input_tap(InputTap* tap) {
+    input_tap = tap;
+}
+
+void screen_printf(int y, int x, const char* fmt, ...) {
+    char buf[512];
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+    if (n < 0)
+        return;
+    renderer().put(y, x, buf, std::min(n, static_cast<int>(sizeof(buf)) - 1), 0);
+}
+
+void screen_clear() {
+    renderer().clear();
+}
+
+void screen_refresh() {
+    metrics_flush_begin();
+    renderer().flush();
+    metrics_flush_end();
+}
+
+// Input through the tap, if any; live() reads the backend.
+template <typename F>
+static int tapped(F live) {
+    int value;
+    if (!input_tap || !input_tap->replay(value))
+        value = live();
+    if (input_tap)
+        input_tap->record(value);
+    return value;
+}
+
+int screen_getch() {
+    // Whatever was said since the last frame is shown before waiting.
+    messages_flush();
+    return tapped([]() { return renderer().get_key(-1); });
+}
+
+int screen_poll_key() {
+    return tapped([]() { return renderer().get_key(0); });
+}
+
+bool screen_key_waiting() {
+    return tapped([]() {
+        int ch = renderer().get_key(0);
+        if (ch == SCREEN_KEY_NONE)
+            return 0;
+        renderer().unget_key(ch);
+        return 1;
+    }) != 0;
+}
+
+// --- headless ---
+
+HeadlessRenderer::HeadlessRenderer(int rows, int cols)
+    : rows(rows), cols(cols), glyphs(rows * cols, ' '), pairs(rows * cols, 0) {}
+
+void HeadlessRenderer::clear() {
+    std::fill(glyphs.begin(), glyphs.end(), ' ');
+    std::fill(pairs.begin(), pairs.end(), 0);
+}
+
+void HeadlessRenderer::clear_line(int y) {
+    if (y < 0 || y >= rows)
+        return;
+    std::fill(glyphs.begin() + y * cols, glyphs.begin() + (y + 1) * cols, ' ');
+    std::fill(pairs.begin() + y * cols, pairs.begin() + (y + 1) * cols, 0);
+}
+
+void HeadlessRenderer::put(int y, int x, const char* text, int n, int pair) {
+    if (y < 0 || y >= rows || x < 0)
+        return;
+    n = std::min(n, cols - x);
+    for (int i = 0; i < n; i++) {
+        glyphs[y * cols + x + i] = text[i];
+        pairs[y * cols + x + i] = static_cast<unsigned char>(pair);
+    }
+}
+
+int HeadlessRenderer::get_key(int) {
+    if (keys.empty())
+        return SCREEN_KEY_NONE;
+    int ch = keys.front();
+    keys.pop_front();
+    return ch;
+}
+
+void HeadlessRenderer::push_keys(const std::string &script) {
+    for (char c : script)
+        keys.push_back(static_cast<unsigned char>(c));
+}
+
+char HeadlessRenderer::glyph_at(int y, int x) const {
+    if (y < 0 || y >= rows || x < 0 || x >= cols)
+        return ' ';
+    return glyphs[y * cols + x];
+}
+
+int HeadlessRenderer::pair_at(int y, int x) const {
+    if (y < 0 || y >= rows || x < 0 || x >= cols)
+        return 0;
+    return pairs[y * cols + x];
+}
+
+std::string HeadlessRenderer::row_text(int y) const {
+    if (y < 0 || y >= rows)
+        return std::string();
+    return std::string(glyphs.begin() + y * cols, glyphs.begin() + (y + 1) * cols);
+}
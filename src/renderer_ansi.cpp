@@ -0,0 +1,150 @@
+#include "renderer.h"
+#include <cerrno>
+#include <poll.h>
+#include <unistd.h>
+
+// SGR for each colour pair, matching the ncurses init_pair table.
+static const char* const PAIR_SGR[] = {
+    "\x1b[0m",            // 0: default
+    "\x1b[0;31;40m",      // 1: red
+    "\x1b[0;32;40m",      // 2: green
+    "\x1b[0;34;40m",      // 3: blue
+    "\x1b[0;36;40m",      // 4: cyan
+    "\x1b[0;35;40m",      // 5: magenta
+    "\x1b[0;33;40m",      // 6: yellow
+    "\x1b[0;37;40m",      // 7: white
+    "\x1b[0;30;40m",      // 8: black
+    "\x1b[0;37;44m",      // 9: PC, white on blue
+};
+static const int NUM_PAIRS = sizeof(PAIR_SGR) / sizeof(PAIR_SGR[0]);
+
+// How long a lone ESC waits for the rest of an arrow-key sequence.
+static const int ESC_WAIT_MS = 25;
+
+void AnsiRenderer::begin() {
+    if (isatty(in_fd) && tcgetattr(in_fd, &saved_termios) == 0) {
+        struct termios t = saved_termios;
+        t.c_lflag &= ~(ICANON | ECHO);
+        t.c_iflag &= ~(IXON | ICRNL);
+        t.c_cc[VMIN] = 1;
+        t.c_cc[VTIME] = 0;
+        raw = tcsetattr(in_fd, TCSAFLUSH, &t) == 0;
+    }
+    buf += "\x1b[?1049h\x1b[?25l\x1b[0m\x1b[2J";
+    cur_pair = 0;
+    flush();
+}
+
+void AnsiRenderer::end() {
+    buf += "\x1b[0m\x1b[?25h\x1b[?1049l";
+    flush();
+    if (raw) {
+        tcsetattr(in_fd, TCSAFLUSH, &saved_termios);
+        raw = false;
+    }
+}
+
+void AnsiRenderer::set_pair(int pair) {
+    if (pair == cur_pair)
+        return;
+    buf += PAIR_SGR[pair >= 0 && pair < NUM_PAIRS ? pair : 0];
+    cur_pair = pair;
+}
+
+void AnsiRenderer::clear() {
+    set_pair(0);
+    buf += "\x1b[2J";
+}
+
+void AnsiRenderer::clear_line(int y) {
+    char seq[32];
+    int n = snprintf(seq, sizeof(seq), "\x1b[%d;1H", y + 1);
+    buf.append(seq, n);
+    set_pair(0);
+    buf += "\x1b[2K";
+}
+
+void AnsiRenderer::put(int y, int x, const char* text, int n, int pair) {
+    char seq[32];
+    int len = snprintf(seq, sizeof(seq), "\x1b[%d;%dH", y + 1, x + 1);
+    buf.append(seq, len);
+    set_pair(pair);
+    buf.append(text, n);
+}
+
+void AnsiRenderer::flush() {
+    const char* p = buf.data();
+    size_t left = buf.size();
+    while (left > 0) {
+        ssize_t w = write(out_fd, p, left);
+        if (w < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        p += w;
+        left -= w;
+        written.bytes += w;
+        written.writes++;
+    }
+    buf.clear();
+}
+
+int AnsiRenderer::read_byte(int timeout_ms) {
+    struct pollfd pfd = {in_fd, POLLIN, 0};
+    int r;
+    do {
+        r = poll(&pfd, 1, timeout_ms);
+    } while (r < 0 && errno == EINTR);
+    if (r <= 0)
+        return SCREEN_KEY_NONE;
+    unsigned char c;
+    if (read(in_fd, &c, 1) != 1)
+        return SCREEN_KEY_NONE;
+    return c;
+}
+
+int AnsiRenderer::get_key(int timeout_ms) {
+    // Like curses, reading a key shows what was drawn first.
+    if (!buf.empty())
+        flush();
+    if (!pending.empty()) {
+        int ch = pending.front();
+        pending.pop_front();
+        return ch;
+    }
+    int ch = read_byte(timeout_ms);
+    if (ch != 27)
+        return ch;
+
+    int next = read_byte(ESC_WAIT_MS);
+    if (next == SCREEN_KEY_NONE)
+        return 27;
+    if (next == '[' || next == 'O') {
+        int code = read_byte(ESC_WAIT_MS);
+        if (code == 'A')
+            return SCREEN_KEY_UP;
+        if (code == 'B')
+            return SCREEN_KEY_DOWN;
+        if (next == '[' && (code == '5' || code == '6')) {
+            int tilde = read_byte(ESC_WAIT_MS);
+            if (tilde == '~')
+                return code == '5' ? SCREEN_KEY_PPAGE : SCREEN_KEY_NPAGE;
+            pending.push_back(next);
+            pending.push_back(code);
+            if (tilde != SCREEN_KEY_NONE)
+                pending.push_back(tilde);
+            return 27;
+        }
+        pending.push_back(next);
+        if (code != SCREEN_KEY_NONE)
+            pending.push_back(code);
+        return 27;
+    }
+    pending.push_back(next);
+    return 27;
+}
+
+void AnsiRenderer::unget_key(int ch) {
+    pending.push_front(ch);
+}
@@ -0,0 +1,101 @@
+#define NCURSES_NOMACROS
+#include "renderer.h"
+#include <ncurses.h>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+static_assert(SCREEN_KEY_UP == KEY_UP && SCREEN_KEY_DOWN == KEY_DOWN,
+              "screen key codes follow ncurses");
+static_assert(SCREEN_KEY_NPAGE == KEY_NPAGE && SCREEN_KEY_PPAGE == KEY_PPAGE,
+              "screen key codes follow ncurses");
+static_assert(SCREEN_KEY_NONE == ERR, "screen key codes follow ncurses");
+
+void NcursesRenderer::begin() {
+    if (out)
+        screen = newterm(nullptr, out, stdin);
+    else
+        initscr();
+    cbreak();
+    noecho();
+    keypad(stdscr, TRUE);
+    curs_set(0);
+    start_color();
+
+    init_pair(1, COLOR_RED,     COLOR_BLACK);
+    init_pair(2, COLOR_GREEN,   COLOR_BLACK);
+    init_pair(3, COLOR_BLUE,    COLOR_BLACK);
+    init_pair(4, COLOR_CYAN,    COLOR_BLACK);
+    init_pair(5, COLOR_MAGENTA, COLOR_BLACK);
+    init_pair(6, COLOR_YELLOW,  COLOR_BLACK);
+    init_pair(7, COLOR_WHITE,   COLOR_BLACK);
+    init_pair(8, COLOR_BLACK,   COLOR_BLACK);
+    init_pair(9, COLOR_WHITE, COLOR_BLUE); // PC color
+
+#ifdef __linux__
+    proc_io_fd = open("/proc/thread-self/io", O_RDONLY | O_CLOEXEC);
+#endif
+}
+
+void NcursesRenderer::end() {
+    endwin();
+    if (proc_io_fd >= 0) {
+        close(proc_io_fd);
+        proc_io_fd = -1;
+    }
+    if (screen) {
+        delscreen(static_cast<SCREEN*>(screen));
+        screen = nullptr;
+    }
+}
+
+void NcursesRenderer::clear() {
+    ::clear();
+}
+
+void NcursesRenderer::clear_line(int y) {
+    ::move(y, 0);
+    clrtoeol();
+}
+
+void NcursesRenderer::put(int y, int x, const char* text, int n, int pair) {
+    ::move(y, x);
+    if (pair)
+        attron(COLOR_PAIR(pair));
+    addnstr(text, n);
+    if (pair)
+        attroff(COLOR_PAIR(pair));
+}
+
+void NcursesRenderer::flush() {
+    refresh();
+}
+
+int NcursesRenderer::get_key(int timeout_ms) {
+    timeout(timeout_ms);
+    int ch = getch();
+    if (timeout_ms >= 0)
+        timeout(-1);
+    return ch;
+}
+
+void NcursesRenderer::unget_key(int ch) {
+    ungetch(ch);
+}
+
+io_counts_t NcursesRenderer::io_counts() const {
+    io_counts_t io = {0, 0};
+    if (proc_io_fd < 0)
+        return io;
+    char buf[512];
+    ssize_t n = pread(proc_io_fd, buf, sizeof(buf) - 1, 0);
+    if (n <= 0)
+        return io;
+    buf[n] = '\0';
+    if (const char* p = strstr(buf, "wchar:"))
+        io.bytes = strtol(p + 6, nullptr, 10);
+    if (const char* p = strstr(buf, "syscw:"))
+        io.writes = strtol(p + 6, nullptr, 10);
+    return io;
+}
@@ -0,0 +1,39 @@
+#include "rng.h"
+
+static uint64_t seed_value = 0;
+static uint64_t positions[RNG_STREAMS] = {};
+
+// splitmix64's output function.
+static uint64_t mix(uint64_t z) {
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+void rng_seed(uint64_t seed) {
+    seed_value = seed;
+    for (uint64_t &p : positions)
+        p = 0;
+}
+
+uint64_t rng_get_seed() {
+    return seed_value;
+}
+
+uint64_t rng_next(RngStream s) {
+    int i = static_cast<int>(s);
+    uint64_t key = mix(seed_value + 0x9E3779B97F4A7C15ull * (i + 1));
+    return mix(key + 0x9E3779B97F4A7C15ull * ++positions[i]);
+}
+
+int rng_below(RngStream s, int n) {
+    return static_cast<int>((static_cast<unsigned __int128>(rng_next(s)) * n) >> 64);
+}
+
+uint64_t rng_position(RngStream s) {
+    return positions[static_cast<int>(s)];
+}
+
+void rng_set_position(RngStream s, uint64_t pos) {
+    positions[static_cast<int>(s)] = pos;
+}
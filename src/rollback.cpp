@@ -0,0 +1,292 @@
+#include "rollback.h"
+#include "global.h"
+#include "character.h"
+#include "bitgrid.h"
+#include "fov.h"
+#include "los.h"
+#include "pathfinding.h"
+#include "rng.h"
+#include "zobrist.h"
+#include <algorithm>
+#include <array>
+#include <vector>
+
+// A tile is one word of explored bits wide.
+constexpr int TILE_W = 64;
+constexpr int TILE_H = 8;
+constexpr int TILES_X = ROW_WORDS;
+constexpr int TILES_Y = (HEIGHT + TILE_H - 1) / TILE_H;
+constexpr int TILES = TILES_X * TILES_Y;
+// Entries to a shared block of pointers.
+constexpr int BLOCK = 64;
+
+struct tile_t {
+    std::array<std::array<int, TILE_W>, TILE_H> hardness;
+    std::array<std::array<int, TILE_W>, TILE_H> char_map;
+    std::array<std::array<int, TILE_W>, TILE_H> object_map;
+    std::array<std::array<char, TILE_W>, TILE_H> dungeon;
+    std::array<std::array<char, TILE_W>, TILE_H> base_map;
+    std::array<uint64_t, TILE_H> explored;
+};
+
+// An array whose versions share blocks of entries until one of the
+// block's entries changes.
+template <typename T>
+struct persistent_t {
+    using block_t = std::array<std::shared_ptr<const T>, BLOCK>;
+    std::vector<std::shared_ptr<const block_t>> blocks;
+    size_t size = 0;
+
+    const std::shared_ptr<const T> &at(int i) const {
+        return (*blocks[i / BLOCK])[i % BLOCK];
+    }
+};
+
+struct world_state_t {
+    unsigned generation = 0;
+    persistent_t<tile_t> tiles;
+    persistent_t<character_t> characters;
+    std::shared_ptr<const std::vector<ObjectInstance>> objects;
+    int pc_x = 0, pc_y = 0;
+    int monsters_alive = 0;
+    bool pc_is_alive = false;
+    std::array<uint64_t, RNG_STREAMS> rng{};
+    zobrist_state_t hash;
+};
+
+struct rollback_t {
+    world_mark_t current;  // the last mark taken or gone back to
+    // What changed since current, as flags and as lists.
+    std::array<uint8_t, TILES> tile_dirty{};
+    std::vector<uint8_t> char_dirty;
+    std::vector<int> dirty_tiles, dirty_chars;
+    bool objects_dirty = false;
+    rollback_stats_t stats;
+};
+
+static rollback_t rb;
+
+// Whether current describes the level on the map, so only the changes
+// since it need looking at.
+static bool current_valid() {
+    return rb.current && rb.current->generation == terrain_generation &&
+           rb.current->characters.size == characters.size();
+}
+
+template <typename T>
+static void reset(persistent_t<T> &v, size_t n) {
+    v.size = n;
+    v.blocks.assign((n + BLOCK - 1) / BLOCK,
+                    std::make_shared<const typename persistent_t<T>::block_t>());
+}
+
+// Point entries idx (ascending) at make(i), copying each block touched once.
+template <typename T, typename Make>
+static void update(persistent_t<T> &v, const std::vector<int> &idx, Make make) {
+    std::shared_ptr<typename persistent_t<T>::block_t> block;
+    int block_no = -1;
+    for (int i : idx) {
+        if (i / BLOCK != block_no) {
+            block_no = i / BLOCK;
+            block = std::make_shared<typename persistent_t<T>::block_t>(*v.blocks[block_no]);
+            v.blocks[block_no] = block;
+        }
+        (*block)[i % BLOCK] = make(i);
+    }
+}
+
+// --- Tiles ---
+
+static void tile_origin(int t, int &x0, int &y0, int &w, int &h) {
+    x0 = (t % TILES_X) * TILE_W;
+    y0 = (t / TILES_X) * TILE_H;
+    w = std::min(TILE_W, WIDTH - x0);
+    h = std::min(TILE_H, HEIGHT - y0);
+}
+
+static std::shared_ptr<const tile_t> capture_tile(int t) {
+    auto tile = std::make_shared<tile_t>();
+    int x0, y0, w, h;
+    tile_origin(t, x0, y0, w, h);
+    for (int r = 0; r < h; r++) {
+        int y = y0 + r;
+        std::copy_n(&hardness[y][x0], w, tile->hardness[r].begin());
+        std::copy_n(&char_map[y][x0], w, tile->char_map[r].begin());
+        std::copy_n(&object_map[y][x0], w, tile->object_map[r].begin());
+        std::copy_n(&dungeon[y][x0], w, tile->dungeon[r].begin());
+        std::copy_n(&base_map[y][x0], w, tile->base_map[r].begin());
+        tile->explored[r] = pc_explored[y][t % TILES_X];
+    }
+    return tile;
+}
+
+// Returns whether any hardness changed; the terrain caches are told per
+// cell.
+static bool restore_tile(int t, const tile_t &tile) {
+    bool dug = false;
+    int x0, y0, w, h;
+    tile_origin(t, x0, y0, w, h);
+    for (int r = 0; r < h; r++) {
+        int y = y0 + r;
+        for (int c = 0; c < w; c++) {
+            if (hardness[y][x0 + c] == tile.hardness[r][c])
+                continue;
+            hardness[y][x0 + c] = tile.hardness[r][c];
+            los_terrain_changed(x0 + c, y);
+            fov_terrain_changed(x0 + c, y);
+            dug = true;
+        }
+        std::copy_n(tile.char_map[r].begin(), w, &char_map[y][x0]);
+        std::copy_n(tile.object_map[r].begin(), w, &object_map[y][x0]);
+        std::copy_n(tile.dungeon[r].begin(), w, &dungeon[y][x0]);
+        std::copy_n(tile.base_map[r].begin(), w, &base_map[y][x0]);
+        pc_explored[y][t % TILES_X] = tile.explored[r];
+    }
+    return dug;
+}
+
+// --- Marks ---
+
+static void clear_dirty() {
+    for (int t : rb.dirty_tiles)
+        rb.tile_dirty[t] = 0;
+    for (int i : rb.dirty_chars)
+        rb.char_dirty[i] = 0;
+    rb.dirty_tiles.clear();
+    rb.dirty_chars.clear();
+    rb.objects_dirty = false;
+}
+
+world_mark_t rollback_mark() {
+    auto s = std::make_shared<world_state_t>();
+    if (current_valid()) {
+        *s = *rb.current;
+        if (!characters.empty())
+            rollback_touch_character(0);
+    } else {
+        clear_dirty();
+        reset(s->tiles, TILES);
+        reset(s->characters, characters.size());
+        rb.char_dirty.assign(characters.size(), 0);
+        for (int t = 0; t < TILES; t++)
+            rollback_touch_cell((t % TILES_X) * TILE_W, (t / TILES_X) * TILE_H);
+        for (size_t i = 0; i < characters.size(); i++)
+            rollback_touch_character(static_cast<int>(i));
+        rb.objects_dirty = true;
+    }
+
+    std::sort(rb.dirty_tiles.begin(), rb.dirty_tiles.end());
+    std::sort(rb.dirty_chars.begin(), rb.dirty_chars.end());
+    update(s->tiles, rb.dirty_tiles, capture_tile);
+    update(s->characters, rb.dirty_chars,
+           [](int i) { return std::make_shared<const character_t>(characters[i]); });
+    if (rb.objects_dirty || !s->objects)
+        s->objects = std::make_shared<const std::vector<ObjectInstance>>(object_instances);
+    s->generation = terrain_generation;
+    s->pc_x = pc_x;
+    s->pc_y = pc_y;
+    s->monsters_alive = monsters_alive;
+    s->pc_is_alive = pc_is_alive;
+    for (int i = 0; i < RNG_STREAMS; i++)
+        s->rng[i] = rng_position(static_cast<RngStream>(i));
+    s->hash = zobrist_save();
+
+    rb.stats.marks++;
+    rb.stats.tiles_copied += rb.dirty_tiles.size();
+    rb.stats.characters_copied += rb.dirty_chars.size();
+    clear_dirty();
+    rb.current = s;
+    return rb.current;
+}
+
+bool rollback_to(const world_mark_t &mark) {
+    if (!mark || !current_valid() || mark->generation != terrain_generation ||
+        mark->characters.size != characters.size())
+        return false;
+    const world_state_t &from = *rb.current, &to = *mark;
+    if (!characters.empty())
+        rollback_touch_character(0);
+
+    // What was written since the last mark, then whatever the last mark and
+    // the target do not share.
+    bool dug = false;
+    long tiles = 0, chars = 0;
+    for (int t : rb.dirty_tiles) {
+        dug |= restore_tile(t, *to.tiles.at(t));
+        tiles++;
+    }
+    for (size_t b = 0; b < to.tiles.blocks.size(); b++) {
+        if (to.tiles.blocks[b] == from.tiles.blocks[b])
+            continue;
+        for (int t = b * BLOCK; t < std::min<int>(TILES, (b + 1) * BLOCK); t++) {
+            if (!rb.tile_dirty[t] && to.tiles.at(t) != from.tiles.at(t)) {
+                dug |= restore_tile(t, *to.tiles.at(t));
+                tiles++;
+            }
+        }
+    }
+    for (int i : rb.dirty_chars) {
+        characters[i] = *to.characters.at(i);
+        chars++;
+    }
+    int n = static_cast<int>(characters.size());
+    for (size_t b = 0; b < to.characters.blocks.size(); b++) {
+        if (to.characters.blocks[b] == from.characters.blocks[b])
+            continue;
+        for (int i = b * BLOCK; i < std::min<int>(n, (b + 1) * BLOCK); i++) {
+            if (!rb.char_dirty[i] && to.characters.at(i) != from.characters.at(i)) {
+                characters[i] = *to.characters.at(i);
+                chars++;
+            }
+        }
+    }
+    if (rb.objects_dirty || to.objects != from.objects)
+        object_instances = *to.objects;
+
+    pc_x = to.pc_x;
+    pc_y = to.pc_y;
+    monsters_alive = to.monsters_alive;
+    pc_is_alive = to.pc_is_alive;
+    for (int i = 0; i < RNG_STREAMS; i++)
+        rng_set_position(static_cast<RngStream>(i), to.rng[i]);
+    zobrist_restore(to.hash);
+    if (dug)
+        pathfinding_terrain_changed();
+    fov_update();
+
+    rb.stats.rollbacks++;
+    rb.stats.tiles_restored += tiles;
+    rb.stats.characters_restored += chars;
+    clear_dirty();
+    rb.current = mark;
+    return true;
+}
+
+// --- Write barriers ---
+
+void rollback_touch_cell(int x, int y) {
+    int t = (y / TILE_H) * TILES_X + x / TILE_W;
+    if (rb.tile_dirty[t])
+        return;
+    rb.tile_dirty[t] = 1;
+    rb.dirty_tiles.push_back(t);
+}
+
+void rollback_touch_character(int idx) {
+    // Past the end only when the level was replaced since the last mark,
+    // and then the next mark captures everything anyway.
+    if (idx >= static_cast<int>(rb.char_dirty.size()) || rb.char_dirty[idx])
+        return;
+    rb.char_dirty[idx] = 1;
+    rb.dirty_chars.push_back(idx);
+}
+
+void rollback_touch_objects() {
+    rb.objects_dirty = true;
+}
+
+rollback_stats_t rollback_stats() {
+    rollback_stats_t s = rb.stats;
+    s.tile_bytes = sizeof(tile_t);
+    return s;
+}
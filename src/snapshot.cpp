@@ -0,0 +1,538 @@
+#include "snapshot.h"
+#include "global.h"
+#include "character.h"
+#include "dungeon.h"
+#include "occupancy.h"
+#include "fov.h"
+#include "fileio.h"
+#include "crc32c.h"
+#include "rng.h"
+#include "level_cache.h"
+#include "record_codec.h"
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#ifdef __APPLE__
+  #include <libkern/OSByteOrder.h>
+  #define be32toh(x) OSSwapBigToHostInt32(x)
+  #define htobe32(x) OSSwapHostToBigInt32(x)
+#else
+  #include <endian.h>
+#endif
+
+// Checks that the reader shares the writer's byte order.
+static const uint32_t SNAP_BYTE_ORDER = 0x01020304;
+
+struct snap_header_t {
+    char marker[MARKER_LEN];
+    uint32_t version_be;   // big-endian, where version 0 readers look
+    uint32_t size_be;      // whole file, big-endian
+    uint32_t byte_order;   // SNAP_BYTE_ORDER as written
+    uint32_t crc;          // crc32c of everything after the header
+    uint16_t width, height;
+    uint32_t sections;
+    uint32_t reserved;
+};
+static_assert(sizeof(snap_header_t) == 40, "snapshot header layout");
+
+// Each section is followed by count * record_size bytes of records,
+// padded to 8 so the next header and its records stay aligned.
+struct snap_section_t {
+    uint32_t tag, count, record_size, bytes;
+};
+
+constexpr uint32_t snap_tag(const char (&s)[5]) {
+    return uint32_t(uint8_t(s[0])) | uint32_t(uint8_t(s[1])) << 8 |
+           uint32_t(uint8_t(s[2])) << 16 | uint32_t(uint8_t(s[3])) << 24;
+}
+
+static const uint32_t TAG_LEVEL     = snap_tag("LEVL");
+static const uint32_t TAG_HARDNESS  = snap_tag("HARD");
+static const uint32_t TAG_EXPLORED  = snap_tag("EXPL");
+static const uint32_t TAG_CHARS     = snap_tag("CHAR");
+static const uint32_t TAG_ITEMS     = snap_tag("ITEM");
+static const uint32_t TAG_ARTIFACTS = snap_tag("ARTF");
+static const uint32_t TAG_STRINGS   = snap_tag("STRS");
+static const uint32_t TAG_RNG       = snap_tag("RNG ");
+static const uint32_t TAG_DEPTH     = snap_tag("DPTH");
+
+// Offset and length into the string table.
+struct str_ref_t {
+    uint32_t off, len;
+};
+
+struct snap_level_t {
+    int32_t pc_x, pc_y;
+    int32_t room_count;
+    int32_t rooms[MAX_ROOMS][4];  // x, y, w, h
+    int32_t up_count, up_x, up_y;
+    int32_t down_count, down_x, down_y;
+    int32_t fog_toggle;
+};
+
+struct snap_dice_t {
+    int32_t base, dice, sides;
+};
+
+struct snap_char_t {
+    int32_t type, alive, x, y, hp;
+    snap_dice_t base_damage;
+    int32_t speed, turn, monster_btype, symbol;
+    str_ref_t color;  // colour names separated by spaces
+    int32_t mana, max_mana;
+    int32_t pc_seen_x, pc_seen_y;
+    int32_t next_time;
+};
+
+// Objects on the floor have owner -1; carried ones name the character
+// and either an inventory slot or MAX_CARRY + an equipment slot.
+struct snap_item_t {
+    str_ref_t name, color, description;
+    int32_t symbol;
+    int32_t hit, dodge, defense, weight, speed, attribute, value;
+    snap_dice_t damage;
+    int32_t is_artifact;
+    int32_t x, y;
+    int32_t owner, slot;
+};
+
+struct snap_rng_t {
+    uint64_t seed;
+    uint64_t positions[RNG_STREAMS];
+};
+
+// Where the PC is, and the level archive as it stood (see level_archive.h).
+struct snap_depth_t {
+    int32_t depth;
+    int32_t reserved;
+    uint64_t game_id;
+    uint64_t archive_mark;
+};
+
+// --- Writing ---
+
+struct snap_writer_t {
+    std::vector<uint8_t> &buf;
+    string_table_t<str_ref_t> strings;
+    uint32_t sections = 0;
+
+    explicit snap_writer_t(std::vector<uint8_t> &buf) : buf(buf) {}
+
+    void section(uint32_t tag, const void* records, size_t count, size_t record_size) {
+        snap_section_t h = {tag, static_cast<uint32_t>(count), static_cast<uint32_t>(record_size),
+                            static_cast<uint32_t>(count * record_size)};
+        const uint8_t* hp = reinterpret_cast<const uint8_t*>(&h);
+        buf.insert(buf.end(), hp, hp + sizeof(h));
+        const uint8_t* rp = static_cast<const uint8_t*>(records);
+        buf.insert(buf.end(), rp, rp + h.bytes);
+        buf.resize((buf.size() + 7) & ~size_t(7), 0);
+        sections++;
+    }
+};
+
+static snap_item_t to_snap(snap_writer_t &w, const ObjectInstance &o, int owner, int slot) {
+    snap_item_t r;
+    r.name = w.strings.add(o.name);
+    r.color = w.strings.add_colors(o.color);
+    r.description = w.strings.add(o.description);
+    r.symbol = o.symbol;
+    r.hit = o.hit;
+    r.dodge = o.dodge;
+    r.defense = o.defense;
+    r.weight = o.weight;
+    r.speed = o.speed;
+    r.attribute = o.attribute;
+    r.value = o.value;
+    r.damage = dice_record<snap_dice_t>(o.damage);
+    r.is_artifact = o.is_artifact;
+    r.x = o.x;
+    r.y = o.y;
+    r.owner = owner;
+    r.slot = slot;
+    return r;
+}
+
+void snapshot_capture(std::vector<uint8_t> &buf, int &archive_fd) {
+    buf.clear();
+    buf.resize(sizeof(snap_header_t), 0);
+    snap_writer_t w(buf);
+
+    snap_level_t lv = {};
+    lv.pc_x = pc_x;
+    lv.pc_y = pc_y;
+    lv.room_count = room_count;
+    for (int i = 0; i < room_count; i++) {
+        lv.rooms[i][0] = room_x[i];
+        lv.rooms[i][1] = room_y[i];
+        lv.rooms[i][2] = room_w[i];
+        lv.rooms[i][3] = room_h[i];
+    }
+    lv.up_count = upCount > 0 ? 1 : 0;
+    lv.up_x = up_xCoord;
+    lv.up_y = up_yCoord;
+    lv.down_count = downCount > 0 ? 1 : 0;
+    lv.down_x = down_xCoord;
+    lv.down_y = down_yCoord;
+    lv.fog_toggle = fog_toggle;
+    w.section(TAG_LEVEL, &lv, 1, sizeof(lv));
+
+    std::vector<uint8_t> hard(WIDTH * HEIGHT);
+    for (int y = 0; y < HEIGHT; y++)
+        for (int x = 0; x < WIDTH; x++)
+            hard[y * WIDTH + x] = static_cast<uint8_t>(hardness[y][x]);
+    w.section(TAG_HARDNESS, hard.data(), hard.size(), 1);
+    w.section(TAG_EXPLORED, pc_explored.data(), HEIGHT * ROW_WORDS, sizeof(uint64_t));
+
+    std::vector<snap_char_t> chars;
+    std::vector<snap_item_t> items;
+    chars.reserve(characters.size());
+    for (size_t i = 0; i < characters.size(); i++) {
+        const character_t &c = characters[i];
+        snap_char_t r;
+        r.type = c.type == CharType::PC ? 0 : 1;
+        r.alive = c.alive;
+        r.x = c.x;
+        r.y = c.y;
+        r.hp = c.hp;
+        r.base_damage = dice_record<snap_dice_t>(c.base_damage);
+        r.speed = c.speed;
+        r.turn = c.turn;
+        r.monster_btype = c.monster_btype;
+        r.symbol = c.symbol;
+        r.color = w.strings.add_colors(c.color);
+        r.mana = c.mana;
+        r.max_mana = c.max_mana;
+        r.pc_seen_x = c.pc_seen_x;
+        r.pc_seen_y = c.pc_seen_y;
+        r.next_time = c.next_time;
+        chars.push_back(r);
+        for (int s = 0; s < character_t::MAX_CARRY; s++)
+            if (c.inventory[s])
+                items.push_back(to_snap(w, *c.inventory[s], i, s));
+        for (int s = 0; s < NUM_EQUIP_SLOTS; s++)
+            if (c.equipment[s])
+                items.push_back(to_snap(w, *c.equipment[s], i, character_t::MAX_CARRY + s));
+    }
+    for (const ObjectInstance &o : object_instances)
+        items.push_back(to_snap(w, o, -1, -1));
+    w.section(TAG_CHARS, chars.data(), chars.size(), sizeof(snap_char_t));
+    w.section(TAG_ITEMS, items.data(), items.size(), sizeof(snap_item_t));
+
+    std::vector<str_ref_t> artifacts;
+    for (const std::string &name : seen_artifacts)
+        artifacts.push_back(w.strings.add(name));
+    w.section(TAG_ARTIFACTS, artifacts.data(), artifacts.size(), sizeof(str_ref_t));
+    snap_rng_t rng = {};
+    rng.seed = rng_get_seed();
+    for (int i = 0; i < RNG_STREAMS; i++)
+        rng.positions[i] = rng_position(static_cast<RngStream>(i));
+    w.section(TAG_RNG, &rng, 1, sizeof(rng));
+    snap_depth_t depth = {dungeon_depth, 0, archive_game_id(), archive_mark()};
+    w.section(TAG_DEPTH, &depth, 1, sizeof(depth));
+    archive_fd = archive_sync_fd();
+    w.section(TAG_STRINGS, w.strings.bytes.data(), w.strings.bytes.size(), 1);
+
+    snap_header_t h = {};
+    std::memcpy(h.marker, FILE_MARKER, MARKER_LEN);
+    h.version_be = htobe32(SNAPSHOT_VERSION);
+    h.size_be = htobe32(static_cast<uint32_t>(buf.size()));
+    h.byte_order = SNAP_BYTE_ORDER;
+    h.width = WIDTH;
+    h.height = HEIGHT;
+    h.sections = w.sections;
+    std::memcpy(buf.data(), &h, sizeof(h));
+}
+
+void snapshot_seal(std::vector<uint8_t> &buf, int archive_fd) {
+    // The levels the snapshot refers to go to disk before it does.
+    archive_sync(archive_fd);
+    uint32_t crc = crc32c(buf.data() + sizeof(snap_header_t), buf.size() - sizeof(snap_header_t));
+    std::memcpy(buf.data() + offsetof(snap_header_t, crc), &crc, sizeof(crc));
+}
+
+void snapshot_build(std::vector<uint8_t> &buf) {
+    int archive_fd;
+    snapshot_capture(buf, archive_fd);
+    snapshot_seal(buf, archive_fd);
+}
+
+bool save_snapshot(const char* path) {
+    std::vector<uint8_t> buf;
+    snapshot_build(buf);
+    return write_file_atomic(path, buf);
+}
+
+// --- Reading ---
+
+struct snap_view_t {
+    const uint8_t* data = nullptr;
+    uint32_t count = 0, record_size = 0;
+};
+
+// Records of a section, or nullptr if it is missing or sized wrongly.
+template <typename T>
+static const T* records(const snap_view_t &v) {
+    if (!v.data || v.record_size != sizeof(T))
+        return nullptr;
+    return reinterpret_cast<const T*>(v.data);
+}
+
+static bool fail(const char* path, const char* why) {
+    std::cerr << "Bad save file " << path << ": " << why << std::endl;
+    return false;
+}
+
+// The header and the sections after it, which are indexed by tag (the
+// last of each kind wins); nullptr if they hold together, or what is wrong.
+static const char* read_sections(const std::vector<uint8_t> &buf, snap_header_t &h,
+                                 std::unordered_map<uint32_t, snap_view_t> &sections) {
+    if (buf.size() < sizeof(snap_header_t))
+        return "truncated header";
+    std::memcpy(&h, buf.data(), sizeof(h));
+    if (be32toh(h.size_be) != buf.size())
+        return "size does not match the file";
+    if (h.byte_order != SNAP_BYTE_ORDER)
+        return "written on a machine with a different byte order";
+    if (crc32c(buf.data() + sizeof(h), buf.size() - sizeof(h)) != h.crc)
+        return "checksum mismatch";
+    if (h.width != WIDTH || h.height != HEIGHT)
+        return "map size differs from this build";
+
+    size_t off = sizeof(h);
+    for (uint32_t i = 0; i < h.sections; i++) {
+        if (buf.size() - off < sizeof(snap_section_t))
+            return "truncated section header";
+        snap_section_t s;
+        std::memcpy(&s, buf.data() + off, sizeof(s));
+        off += sizeof(s);
+        uint64_t padded = (uint64_t(s.bytes) + 7) & ~uint64_t(7);
+        if (uint64_t(s.count) * s.record_size != s.bytes || padded > buf.size() - off)
+            return "section overruns the file";
+        snap_view_t &v = sections[s.tag];
+        v.data = buf.data() + off;
+        v.count = s.count;
+        v.record_size = s.record_size;
+        off += padded;
+    }
+    return nullptr;
+}
+
+// Check every section before anything is replaced.
+static bool load_session(const std::vector<uint8_t> &buf, const char* path) {
+    snap_header_t h;
+    std::unordered_map<uint32_t, snap_view_t> sections;
+    if (const char* why = read_sections(buf, h, sections))
+        return fail(path, why);
+    // Unknown sections are skipped so later versions can add more.
+    snap_view_t level = sections[TAG_LEVEL], hard = sections[TAG_HARDNESS],
+                explored = sections[TAG_EXPLORED], chars = sections[TAG_CHARS],
+                items = sections[TAG_ITEMS], artifacts = sections[TAG_ARTIFACTS],
+                strings = sections[TAG_STRINGS], rng = sections[TAG_RNG], depth = sections[TAG_DEPTH];
+
+    const snap_level_t* lv = records<snap_level_t>(level);
+    const uint8_t* hv = records<uint8_t>(hard);
+    const uint64_t* ev = records<uint64_t>(explored);
+    const snap_char_t* cv = records<snap_char_t>(chars);
+    const snap_item_t* iv = records<snap_item_t>(items);
+    const str_ref_t* av = records<str_ref_t>(artifacts);
+    const snap_rng_t* rv = records<snap_rng_t>(rng);
+    const snap_depth_t* dv = records<snap_depth_t>(depth);
+    const char* table = reinterpret_cast<const char*>(strings.data);
+    if (!lv || level.count != 1 || !hv || hard.count != uint32_t(WIDTH * HEIGHT) ||
+        !ev || explored.count != uint32_t(HEIGHT * ROW_WORDS) || !cv || chars.count == 0 ||
+        (items.data && !iv) || (artifacts.data && !av) || (rng.data && (!rv || rng.count != 1)) ||
+        (depth.data && (!dv || depth.count != 1)) ||
+        !table || strings.record_size != 1)
+        return fail(path, "missing or malformed section");
+
+    if (!in_map(lv->pc_x, lv->pc_y) || lv->room_count < 0 || lv->room_count > MAX_ROOMS)
+        return fail(path, "bad level record");
+    for (int i = 0; i < lv->room_count; i++) {
+        const int32_t* r = lv->rooms[i];
+        if (r[2] <= 0 || r[3] <= 0 || !in_map(r[0], r[1]) || !in_map(r[0] + r[2] - 1, r[1] + r[3] - 1))
+            return fail(path, "room outside the map");
+    }
+    if ((lv->up_count && !in_map(lv->up_x, lv->up_y)) ||
+        (lv->down_count && !in_map(lv->down_x, lv->down_y)))
+        return fail(path, "stairs outside the map");
+
+    // The PC is always characters[0].
+    uint32_t table_len = strings.count;
+    for (uint32_t i = 0; i < chars.count; i++) {
+        const snap_char_t &c = cv[i];
+        if ((c.type == 0) != (i == 0) || (c.type != 0 && c.type != 1) ||
+            !in_map(c.x, c.y) || c.speed <= 0 || !ref_ok(c.color, table_len))
+            return fail(path, "bad character record");
+    }
+    for (uint32_t i = 0; i < items.count; i++) {
+        const snap_item_t &o = iv[i];
+        bool placed = o.owner == -1 ? in_map(o.x, o.y)
+                    : o.owner >= 0 && uint32_t(o.owner) < chars.count &&
+                      o.slot >= 0 && o.slot < character_t::MAX_CARRY + NUM_EQUIP_SLOTS;
+        if (!placed || !ref_ok(o.name, table_len) || !ref_ok(o.color, table_len) ||
+            !ref_ok(o.description, table_len))
+            return fail(path, "bad object record");
+    }
+    for (uint32_t i = 0; i < artifacts.count; i++)
+        if (!ref_ok(av[i], table_len))
+            return fail(path, "bad artifact record");
+
+    // Everything checks out; replace the session.
+    auto str = [&](const str_ref_t &r) { return std::string(table + r.off, r.len); };
+
+    for (int y = 0; y < HEIGHT; y++)
+        for (int x = 0; x < WIDTH; x++)
+            hardness[y][x] = hv[y * WIDTH + x];
+    room_count = lv->room_count;
+    for (int i = 0; i < room_count; i++) {
+        room_x[i] = lv->rooms[i][0];
+        room_y[i] = lv->rooms[i][1];
+        room_w[i] = lv->rooms[i][2];
+        room_h[i] = lv->rooms[i][3];
+    }
+    upCount = lv->up_count ? 1 : 0;
+    up_xCoord = lv->up_x;
+    up_yCoord = lv->up_y;
+    downCount = lv->down_count ? 1 : 0;
+    down_xCoord = lv->down_x;
+    down_yCoord = lv->down_y;
+    rebuild_level_map();
+    base_map = dungeon;
+    terrain_generation++;
+    pc_x = lv->pc_x;
+    pc_y = lv->pc_y;
+    fog_toggle = lv->fog_toggle != 0;
+    for (int y = 0; y < HEIGHT; y++)
+        for (int w = 0; w < ROW_WORDS; w++)
+            pc_explored[y][w] = ev[y * ROW_WORDS + w];
+
+    characters.clear();
+    characters.reserve(chars.count);
+    monsters_alive = 0;
+    for (uint32_t i = 0; i < chars.count; i++) {
+        const snap_char_t &r = cv[i];
+        character_t c;
+        c.type = r.type == 0 ? CharType::PC : CharType::Monster;
+        c.alive = r.alive != 0;
+        c.x = r.x;
+        c.y = r.y;
+        c.hp = r.hp;
+        c.base_damage = dice_from(r.base_damage);
+        for (auto &slot : c.inventory) slot.reset();
+        for (auto &slot : c.equipment) slot.reset();
+        c.speed = r.speed;
+        c.turn = r.turn;
+        c.monster_btype = r.monster_btype;
+        c.symbol = static_cast<char>(r.symbol);
+        c.color = split_colors(str(r.color));
+        c.mana = r.mana;
+        c.max_mana = r.max_mana;
+        c.pc_seen_x = r.pc_seen_x;
+        c.pc_seen_y = r.pc_seen_y;
+        c.next_time = r.next_time;
+        characters.push_back(c);
+        if (c.alive)
+            dungeon[c.y][c.x] = c.type == CharType::PC ? '@' : c.symbol;
+        if (c.alive && c.type == CharType::Monster)
+            monsters_alive++;
+    }
+    pc_is_alive = characters[0].alive;
+
+    object_instances.clear();
+    for (uint32_t i = 0; i < items.count; i++) {
+        const snap_item_t &r = iv[i];
+        ObjectInstance o;
+        o.name = str(r.name);
+        o.symbol = static_cast<char>(r.symbol);
+        o.color = split_colors(str(r.color));
+        o.hit = r.hit;
+        o.dodge = r.dodge;
+        o.defense = r.defense;
+        o.weight = r.weight;
+        o.speed = r.speed;
+        o.attribute = r.attribute;
+        o.value = r.value;
+        o.damage = dice_from(r.damage);
+        o.is_artifact = r.is_artifact != 0;
+        o.description = str(r.description);
+        o.x = r.x;
+        o.y = r.y;
+        if (r.owner < 0)
+            object_instances.push_back(std::move(o));
+        else if (r.slot < character_t::MAX_CARRY)
+            characters[r.owner].inventory[r.slot] = std::move(o);
+        else
+            characters[r.owner].equipment[r.slot - character_t::MAX_CARRY] = std::move(o);
+    }
+
+    seen_artifacts.clear();
+    for (uint32_t i = 0; i < artifacts.count; i++)
+        seen_artifacts.insert(str(av[i]));
+
+    // Saves from before the random streams were recorded keep the current ones.
+    if (rv) {
+        rng_seed(rv->seed);
+        for (int i = 0; i < RNG_STREAMS; i++)
+            rng_set_position(static_cast<RngStream>(i), rv->positions[i]);
+    }
+    // Older saves knew one level only; the archive starts over with them.
+    level_cache_clear();
+    if (dv) {
+        dungeon_depth = dv->depth;
+        archive_attach(dv->game_id, dv->archive_mark);
+    } else {
+        dungeon_depth = 0;
+        archive_new_game();
+    }
+
+    rebuild_char_map();
+    rebuild_object_map();
+    level_changed = false;
+    return true;
+}
+
+LoadKind load_game(const char* path) {
+    std::vector<uint8_t> buf;
+    if (!read_file(path, buf)) {
+        std::cerr << "Error opening file: " << path << ": " << strerror(errno) << std::endl;
+        return LoadKind::Failed;
+    }
+    return load_game_from(buf, path);
+}
+
+uint64_t snapshot_game_id(const char* path) {
+    std::vector<uint8_t> buf;
+    uint32_t version_be;
+    if (!read_file(path, buf) || buf.size() < MARKER_LEN + sizeof(version_be) ||
+        std::memcmp(buf.data(), FILE_MARKER, MARKER_LEN) != 0)
+        return 0;
+    std::memcpy(&version_be, buf.data() + MARKER_LEN, sizeof(version_be));
+    snap_header_t h;
+    std::unordered_map<uint32_t, snap_view_t> sections;
+    if (be32toh(version_be) != SNAPSHOT_VERSION || read_sections(buf, h, sections))
+        return 0;
+    const snap_depth_t* dv = records<snap_depth_t>(sections[TAG_DEPTH]);
+    return dv && sections[TAG_DEPTH].count == 1 ? dv->game_id : 0;
+}
+
+LoadKind load_game_from(const std::vector<uint8_t> &buf, const char* path) {
+    uint32_t version_be;
+    if (buf.size() < MARKER_LEN + sizeof(version_be) ||
+        std::memcmp(buf.data(), FILE_MARKER, MARKER_LEN) != 0) {
+        std::cerr << "Invalid marker" << std::endl;
+        return LoadKind::Failed;
+    }
+    std::memcpy(&version_be, buf.data() + MARKER_LEN, sizeof(version_be));
+    switch (be32toh(version_be)) {
+        case FILE_VERSION:
+            return load_dungeon_from(buf, path) ? LoadKind::Level : LoadKind::Failed;
+        case SNAPSHOT_VERSION:
+            return load_session(buf, path) ? LoadKind::Session : LoadKind::Failed;
+        default:
+            std::cerr << "Unsupported file version" << std::endl;
+            return LoadKind::Failed;
+    }
+}
@@ -0,0 +1,89 @@
+#include "thread_pool.h"
+#include <algorithm>
+
+// Indices handed out per grab; keeps atomic traffic low for tiny jobs.
+static const int CHUNK = 64;
+
+ThreadPool::ThreadPool(unsigned threads) {
+    if (threads == 0)
+        threads = 1;
+    for (unsigned i = 1; i < threads; i++)
+        workers.emplace_back(&ThreadPool::worker_loop, this);
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopping = true;
+    }
+    work_cv.notify_all();
+    for (auto& t : workers)
+        t.join();
+}
+
+void ThreadPool::run_chunks(const std::function<void(int)>* fn, int n) {
+    for (;;) {
+        int start = next_index.fetch_add(CHUNK);
+        if (start >= n)
+            break;
+        int end = std::min(start + CHUNK, n);
+        for (int i = start; i < end; i++)
+            (*fn)(i);
+    }
+}
+
+void ThreadPool::worker_loop() {
+    unsigned seen = 0;
+    for (;;) {
+        const std::function<void(int)>* fn;
+        int n;
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            work_cv.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping)
+                return;
+            seen = generation;
+            fn = job;
+            n = job_size;
+            busy++;
+        }
+        if (fn)
+            run_chunks(fn, n);
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            busy--;
+        }
+        done_cv.notify_one();
+    }
+}
+
+void ThreadPool::parallel_for(int n, const std::function<void(int)>& fn) {
+    if (n <= 0)
+        return;
+    // Not worth waking anyone for a single chunk.
+    if (workers.empty() || n <= CHUNK) {
+        for (int i = 0; i < n; i++)
+            fn(i);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        job = &fn;
+        job_size = n;
+        next_index.store(0);
+        generation++;
+    }
+    work_cv.notify_all();
+    run_chunks(&fn, n);
+
+    // Workers that woke late find no chunks left and drop out immediately,
+    // so waiting for busy == 0 after the index is exhausted is enough.
+    std::unique_lock<std::mutex> lock(mtx);
+    done_cv.wait(lock, [&] { return busy == 0; });
+    job = nullptr;
+}
+
+ThreadPool& game_pool() {
+    static ThreadPool pool(std::thread::hardware_concurrency());
+    return pool;
+}
@@ -0,0 +1,192 @@
+#include "travel.h"
+#include "global.h"
+#include "fov.h"
+#include "occupancy.h"
+#include "ui.h"
+#include "renderer.h"
+#include "message_log.h"
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <vector>
+
+enum class TravelMode { None, ToCell, Explore };
+
+static TravelMode mode = TravelMode::None;
+static int goal_x, goal_y;
+static long interrupts_seen;
+
+// Steps to the nearest goal cell over known, walkable ground.
+static std::array<std::array<int, WIDTH>, HEIGHT> travel_dist;
+static bool dist_stale = true;
+
+static const int dirs[8][2] = { {-1,0}, {1,0}, {0,-1}, {0,1}, {-1,-1}, {-1,1}, {1,-1}, {1,1} };
+
+static bool known(int x, int y) {
+    return fog_toggle || bit_test(pc_explored, x, y);
+}
+
+static bool passable(int x, int y) {
+    return x >= 0 && x < WIDTH && y >= 0 && y < HEIGHT &&
+           known(x, y) && pc_can_walk_on(base_map[y][x]);
+}
+
+// Known floor with unexplored ground next to it.
+static bool frontier(int x, int y) {
+    for (const auto &d : dirs) {
+        int nx = x + d[0], ny = y + d[1];
+        if (nx >= 0 && nx < WIDTH && ny >= 0 && ny < HEIGHT && !bit_test(pc_explored, nx, ny))
+            return true;
+    }
+    return false;
+}
+
+// Breadth-first fill outward from every goal cell.
+static void build_travel_dist() {
+    std::vector<int> queue;
+    for (auto &row : travel_dist)
+        row.fill(INT_MAX);
+    if (mode == TravelMode::ToCell) {
+        travel_dist[goal_y][goal_x] = 0;
+        queue.push_back(goal_y * WIDTH + goal_x);
+    } else {
+        for (int y = 0; y < HEIGHT; y++)
+            for (int x = 0; x < WIDTH; x++)
+                if (passable(x, y) && frontier(x, y)) {
+                    travel_dist[y][x] = 0;
+                    queue.push_back(y * WIDTH + x);
+                }
+    }
+    for (size_t head = 0; head < queue.size(); head++) {
+        int x = queue[head] % WIDTH, y = queue[head] / WIDTH;
+        int next = travel_dist[y][x] + 1;
+        for (const auto &d : dirs) {
+            int nx = x + d[0], ny = y + d[1];
+            if (passable(nx, ny) && travel_dist[ny][nx] == INT_MAX) {
+                travel_dist[ny][nx] = next;
+                queue.push_back(ny * WIDTH + nx);
+            }
+        }
+    }
+    dist_stale = false;
+}
+
+static const character_t* monster_in_view() {
+    for (int y = pc_y - LIGHT_RADIUS; y <= pc_y + LIGHT_RADIUS; y++)
+        for (int x = pc_x - LIGHT_RADIUS; x <= pc_x + LIGHT_RADIUS; x++)
+            if (fov_visible(x, y))
+                if (const character_t* m = monster_at(x, y))
+                    return m;
+    return nullptr;
+}
+
+static bool start(TravelMode m) {
+    mode = m;
+    dist_stale = true;
+    interrupts_seen = message_log_interrupts();
+    update_fog_map();
+    build_travel_dist();
+    if (travel_dist[pc_y][pc_x] == INT_MAX) {
+        travel_stop(m == TravelMode::Explore ? "Nothing left to explore." :
+                                               "You don't know a way there.");
+        return false;
+    }
+    return true;
+}
+
+bool travel_to(int x, int y) {
+    goal_x = x;
+    goal_y = y;
+    if (x == pc_x && y == pc_y) {
+        display_message("You are already there.");
+        return false;
+    }
+    return start(TravelMode::ToCell);
+}
+
+bool travel_explore() {
+    return start(TravelMode::Explore);
+}
+
+bool travel_active() {
+    return mode != TravelMode::None;
+}
+
+void travel_stop(const std::string &why) {
+    mode = TravelMode::None;
+    if (!why.empty())
+        display_message(why);
+}
+
+bool travel_step(character_t &pc) {
+    if (mode == TravelMode::None)
+        return false;
+    if (screen_poll_key() != SCREEN_KEY_NONE) {
+        travel_stop("Travel interrupted.");
+        return false;
+    }
+    // Whatever was said (a hit, a pickup) already tells the player why.
+    if (message_log_interrupts() != interrupts_seen) {
+        travel_stop("");
+        return false;
+    }
+    if (const character_t* m = monster_in_view()) {
+        travel_stop(std::string("You see ") + m->symbol + ".");
+        return false;
+    }
+
+    if (dist_stale)
+        build_travel_dist();
+    int here = travel_dist[pc.y][pc.x];
+    if (here == 0 && mode == TravelMode::Explore) {
+        // Standing on the frontier means it was just explored; look again.
+        build_travel_dist();
+        here = travel_dist[pc.y][pc.x];
+    }
+    if (here == 0) {
+        travel_stop("You arrive.");
+        return false;
+    }
+    if (here == INT_MAX) {
+        travel_stop(mode == TravelMode::Explore ? "Explored everything in reach." :
+                                                  "You don't know a way there.");
+        return false;
+    }
+
+    int best_x = -1, best_y = -1, best = here;
+    for (const auto &d : dirs) {
+        int nx = pc.x + d[0], ny = pc.y + d[1];
+        if (nx < 0 || nx >= WIDTH || ny < 0 || ny >= HEIGHT)
+            continue;
+        if (travel_dist[ny][nx] < best && !monster_at(nx, ny)) {
+            best = travel_dist[ny][nx];
+            best_x = nx;
+            best_y = ny;
+        }
+    }
+    if (best_x < 0) {
+        travel_stop("The way is blocked.");
+        return false;
+    }
+
+    move_character(pc, best_x, best_y);
+    try_pickup_item(pc);
+    if (update_fog_map() > 0 && mode == TravelMode::Explore)
+        dist_stale = true;
+    return true;
+}
+
+bool nearest_known_stairs(char which, int &x, int &y) {
+    int best = INT_MAX;
+    for (int sy = 0; sy < HEIGHT; sy++)
+        for (int sx = 0; sx < WIDTH; sx++)
+            if (base_map[sy][sx] == which && known(sx, sy)) {
+                int d = std::max(std::abs(sx - pc_x), std::abs(sy - pc_y));
+                if (d < best) {
+                    best = d;
+                    x = sx;
+                    y = sy;
+                }
+            }
+    return best != INT_MAX;
+}
@@ -2,7 +2,22 @@
 #include "global.h"
 #include "character.h"
 #include "dungeon.h"
-#include <ncurses.h>
+#include "occupancy.h"
+#include "fov.h"
+#include "los.h"
+#include "aoe.h"
+#include "render.h"
+#include "compositor.h"
+#include "animation.h"
+#include "renderer.h"
+#include "metrics.h"
+#include "message_log.h"
+#include "travel.h"
+#include "commands.h"
+#include "rng.h"
+#include "rollback.h"
+#include "journal.h"
+#include <algorithm>
 #include <string>
 #include <cstdio>
 #include <vector>
@@ -14,18 +29,52 @@ bool inBounds(int x, int y) {
     return x >= 0 && x < WIDTH && y >= 0 && y < HEIGHT;
 }
 
-// Constant for the light radius 
-static const int LIGHT_RADIUS = 3;
-
-// Update the fog map for cells within the PC's light radius.
-void update_fog_map() {
-    for (int y = pc_y - LIGHT_RADIUS; y <= pc_y + LIGHT_RADIUS; y++) {
-        for (int x = pc_x - LIGHT_RADIUS; x <= pc_x + LIGHT_RADIUS; x++) {
-            if (inBounds(x, y)) {
-                fog_map[y][x] = dungeon[y][x];
-            }
+// Mark the cells the PC can currently see as explored, a word at a time.
+// Returns how many of them had never been seen before.
+int update_fog_map() {
+    fov_update();
+    int revealed = 0;
+    int y0 = std::max(0, pc_y - LIGHT_RADIUS);
+    int y1 = std::min(HEIGHT - 1, pc_y + LIGHT_RADIUS);
+    for (int y = y0; y <= y1; y++) {
+        for (int w = 0; w < ROW_WORDS; w++) {
+            uint64_t fresh = pc_visible[y][w] & ~pc_explored[y][w];
+            if (!fresh)
+                continue;
+            revealed += __builtin_popcountll(fresh);
+            pc_explored[y][w] |= fresh;
+            rollback_touch_cell(w * 64, y);
         }
     }
+    return revealed;
+}
+
+// Drop everything the PC remembers of the level.
+void forget_level() {
+    for (int y = 0; y < HEIGHT; y++)
+        for (int w = 0; w < ROW_WORDS; w++)
+            if (pc_explored[y][w])
+                rollback_touch_cell(w * 64, y);
+    bits_clear_all(pc_explored);
+}
+
+// Targeting cursor: green when the PC has a clear line to it, red if not.
+static void draw_target_cursor(const character_t &pc, int target_x, int target_y) {
+    int pair = los_clear(pc.x, pc.y, target_x, target_y) ? 2 : 1;
+    render_overlay(target_x, target_y, '*', pair);
+}
+
+// Effect timings; the animation timeline caps the frame rate and lets a
+// keypress skip the rest.
+static const int PROJECTILE_STEP_MS = 40;
+static const int BLAST_FLASH_MS = 250;
+
+// Clear for a full-screen view; the map must be repainted afterwards.
+static void clear_screen() {
+    metrics_frame_begin();
+    screen_clear();
+    render_invalidate();
+    messages_invalidate();
 }
 
 int get_color_pair(const std::vector<std::string>& colors) {
@@ -45,191 +94,191 @@ int get_color_pair(const std::vector<std::string>& colors) {
 }
 
 
-void display_dungeon() {
+void update_view() {
+    fov_update();
     if (!fog_toggle) {
         update_fog_map();
     }
-    for (int r = 0; r < HEIGHT; r++) {
-        move(r + 1, 0);  // offset for message line
-        for (int c = 0; c < WIDTH; c++) {
-            char ch;
-
-            bool visible = fog_toggle || (std::abs(r - pc_y) <= LIGHT_RADIUS && std::abs(c - pc_x) <= LIGHT_RADIUS);
-
-            if (fog_toggle) {
-                ch = dungeon[r][c];
-            } else {
-                if (visible) {
-                    ch = dungeon[r][c];
-                } else {
-                    ch = fog_map[r][c];
-                }
-            }
+}
 
-            // Special case: Player Character
-            if (ch == '@') {
-                attron(COLOR_PAIR(9));  // PC: white on blue
-                addch(ch);
-                attroff(COLOR_PAIR(9));
-                continue;
-            }
+void display_dungeon() {
+    metrics_frame_begin();
+    update_view();
+    // Compose the frame, then let the renderer send only what changed.
+    compose_frame();
+    messages_draw();
+    render_present();
+}
 
-            bool rendered = false;
-
-            if (visible) {
-                // Check if a monster occupies this tile
-                for (const auto& mon : characters) {
-                    if (mon.alive && mon.x == c && mon.y == r && mon.type == CharType::Monster) {
-                        int pair = get_color_pair(mon.color);
-                        attron(COLOR_PAIR(pair));
-                        addch(mon.symbol);
-                        attroff(COLOR_PAIR(pair));
-                        rendered = true;
-                        break;
-                    }
-                }
 
-                // If no monster, check for object
-                if (!rendered) {
-                    for (const auto& obj : object_instances) {
-                        if (obj.x == c && obj.y == r) {
-                            int pair = get_color_pair(obj.color);
-                            attron(COLOR_PAIR(pair));
-                            addch(obj.symbol);
-                            attroff(COLOR_PAIR(pair));
-                            rendered = true;
-                            break;
-                        }
-                    }
-                }
-            }
 
-            // If neither monster nor object, render terrain
-            if (!rendered) {
-                addch(ch);
-            }
-        }
-    }
 
-    refresh();
+void init_screen() {
+    renderer().begin();
 }
 
+void end_screen() {
+    renderer().end();
+}
 
+// Queued in the message log; shown with the next frame or key prompt.
+void display_message(const std::string &msg, bool interrupts) {
+    message_log_add(msg, interrupts);
+}
 
+// Monsters in view, nearest first. Only the front of the list is ever
+// sorted: at() extends the sorted prefix as far as it is asked to, so a
+// crowd of thousands costs one partial sort per page, not a full sort.
+struct nearest_monsters_t {
+    std::vector<int> ids;
+    size_t sorted = 0;
 
-void init_curses() {
-    initscr();
-    cbreak();
-    noecho();
-    keypad(stdscr, TRUE);
-    curs_set(0);
-    start_color();
+    void build() {
+        monsters_in_view(ids);
+        sorted = 0;
+    }
 
-    init_pair(1, COLOR_RED,     COLOR_BLACK);
-    init_pair(2, COLOR_GREEN,   COLOR_BLACK);
-    init_pair(3, COLOR_BLUE,    COLOR_BLACK);
-    init_pair(4, COLOR_CYAN,    COLOR_BLACK);
-    init_pair(5, COLOR_MAGENTA, COLOR_BLACK);
-    init_pair(6, COLOR_YELLOW,  COLOR_BLACK);
-    init_pair(7, COLOR_WHITE,   COLOR_BLACK);
-    init_pair(8, COLOR_BLACK,   COLOR_BLACK);
-    init_pair(9, COLOR_WHITE, COLOR_BLUE); // PC color
+    size_t size() const { return ids.size(); }
+
+    const character_t& at(size_t i) {
+        if (i >= sorted) {
+            size_t upto = std::min(ids.size(), std::max(i + 1, sorted * 2 + 32));
+            std::partial_sort(ids.begin() + sorted, ids.begin() + upto, ids.end(),
+                              [](int a, int b) {
+                                  int da = chebyshev_to_pc(characters[a]);
+                                  int db = chebyshev_to_pc(characters[b]);
+                                  return da != db ? da < db : a < b;
+                              });
+            sorted = upto;
+        }
+        return characters[ids[i]];
+    }
 
+    static int chebyshev_to_pc(const character_t &c) {
+        return std::max(std::abs(c.x - pc_x), std::abs(c.y - pc_y));
+    }
+};
+
+// "k, 3 north and 2 east" for a monster relative to the PC.
+static std::string describe_offset(const character_t &mon) {
+    int dx = mon.x - pc_x;
+    int dy = mon.y - pc_y;
+    const char* vert = nullptr, *horiz = nullptr;
+    if (dy < 0)
+        vert = "north";
+    else if (dy > 0)
+        vert = "south";
+    if (dx < 0)
+        horiz = "west";
+    else if (dx > 0)
+        horiz = "east";
+    char desc[80];
+    if (vert && horiz)
+        snprintf(desc, sizeof(desc), "%c, %d %s and %d %s", mon.symbol, std::abs(dy), vert, std::abs(dx), horiz);
+    else if (vert)
+        snprintf(desc, sizeof(desc), "%c, %d %s", mon.symbol, std::abs(dy), vert);
+    else if (horiz)
+        snprintf(desc, sizeof(desc), "%c, %d %s", mon.symbol, std::abs(dx), horiz);
+    else
+        snprintf(desc, sizeof(desc), "%c, same cell??", mon.symbol);
+    return desc;
 }
 
+void display_monster_list() {
+    nearest_monsters_t list;
+    list.build();
 
-void end_curses() {
-    endwin();
-}
+    const int lines_avail = 20;
+    const int count = static_cast<int>(list.size());
+    const int max_offset = std::max(0, count - lines_avail);
 
-void display_message(const std::string &msg) {
-    move(0, 0);
-    clrtoeol();
-    mvprintw(0, 0, "%s", msg.c_str());
-    refresh();
-}
+    // Scrolling repaints only the rows whose text changed.
+    clear_screen();
+    screen_printf(0, 0, "--- Monster List: %d in view (ESC to exit, up/down/PgUp/PgDn to scroll) ---", count);
+    std::vector<std::string> shown(lines_avail);
 
-void display_monster_list() {
-    struct moninfo_t {
-        char symbol;
-        int rel_x, rel_y;
-    };
-    std::vector<moninfo_t> list;
-    for (auto &ch : characters) {
-        if (!ch.alive)
-            continue;
-        if (ch.type == CharType::PC)
-            continue;
-        // Only show monster if illuminated.
-        if (!fog_toggle && (std::abs(ch.y - pc_y) > LIGHT_RADIUS || std::abs(ch.x - pc_x) > LIGHT_RADIUS))
-            continue;
-        moninfo_t info;
-        info.symbol = ch.symbol;
-        info.rel_x = ch.x - pc_x;
-        info.rel_y = ch.y - pc_y;
-        list.push_back(info);
-    }
-    
-    clear();
-    refresh();
-    
     int offset = 0;
-    const int lines_avail = 20;
     bool done = false;
     while (!done) {
-        clear();
-        mvprintw(0, 0, "--- Monster List (press ESC to exit, up/down to scroll) ---");
-        int line = 1;
         for (int i = 0; i < lines_avail; i++) {
             int idx = offset + i;
-            if (idx >= (int)list.size())
-                break;
-            int dx = list[idx].rel_x;
-            int dy = list[idx].rel_y;
-            const char* vert = nullptr, *horiz = nullptr;
-            int ady = (dy < 0) ? -dy : dy;
-            int adx = (dx < 0) ? -dx : dx;
-            if (dy < 0)
-                vert = "north";
-            else if (dy > 0)
-                vert = "south";
-            if (dx < 0)
-                horiz = "west";
-            else if (dx > 0)
-                horiz = "east";
-            char desc[80];
-            if (vert && horiz) {
-                snprintf(desc, sizeof(desc), "%c, %d %s and %d %s", list[idx].symbol, ady, vert, adx, horiz);
-            } else if (vert) {
-                snprintf(desc, sizeof(desc), "%c, %d %s", list[idx].symbol, ady, vert);
-            } else if (horiz) {
-                snprintf(desc, sizeof(desc), "%c, %d %s", list[idx].symbol, adx, horiz);
-            } else {
-                snprintf(desc, sizeof(desc), "%c, same cell??", list[idx].symbol);
-            }
-            mvprintw(line++, 0, "%s", desc);
+            std::string text = idx < count ? describe_offset(list.at(idx)) : std::string();
+            if (text == shown[i])
+                continue;
+            renderer().clear_line(i + 1);
+            screen_printf(i + 1, 0, "%s", text.c_str());
+            shown[i] = text;
         }
-        refresh();
-        int ch = getch();
+        screen_refresh();
+        int ch = screen_getch();
         switch (ch) {
             case 27:
                 done = true;
                 break;
-            case KEY_UP:
+            case SCREEN_KEY_UP:
+                offset = std::max(0, offset - 1);
+                break;
+            case SCREEN_KEY_DOWN:
+                offset = std::min(max_offset, offset + 1);
+                break;
+            case SCREEN_KEY_PPAGE:
+                offset = std::max(0, offset - lines_avail);
+                break;
+            case SCREEN_KEY_NPAGE:
+                offset = std::min(max_offset, offset + lines_avail);
+                break;
+            default:
+                break;
+        }
+    }
+    clear_screen();
+    display_dungeon();
+    display_message("Exited monster list.");
+}
+
+// Scrollback over the message log, newest at the bottom.
+void display_message_log() {
+    const int lines_avail = 20;
+    int total = message_log_size();
+    int offset = std::max(0, total - lines_avail);
+    bool done = false;
+    while (!done) {
+        clear_screen();
+        screen_printf(0, 0, "--- Messages (press ESC to exit, up/down to scroll) ---");
+        for (int i = 0; i < lines_avail && offset + i < total; i++)
+            screen_printf(i + 1, 0, "%s", message_log_format(message_log_entry(offset + i)).c_str());
+        screen_refresh();
+        switch (screen_getch()) {
+            case 27:
+                done = true;
+                break;
+            case SCREEN_KEY_UP:
                 if (offset > 0)
                     offset--;
                 break;
-            case KEY_DOWN:
-                if (offset + lines_avail < (int)list.size())
+            case SCREEN_KEY_DOWN:
+                if (offset + lines_avail < total)
                     offset++;
                 break;
             default:
                 break;
         }
     }
-    clear();
+    clear_screen();
+    display_dungeon();
+}
+
+// Debug view of the render-path metrics.
+void display_metrics() {
+    clear_screen();
+    screen_printf(0, 0, "--- Metrics, last %d samples each (press any key) ---", METRICS_WINDOW);
+    int row = 2;
+    for (const std::string &line : metrics_report())
+        screen_printf(row++, 0, "%s", line.c_str());
+    screen_refresh();
+    screen_getch();
+    clear_screen();
     display_dungeon();
-    display_message("Exited monster list.");
 }
 
 bool pc_can_walk_on(char cell) {
@@ -253,10 +302,10 @@ void handle_teleport_mode(character_t &pc) {
         // Redraw the full dungeon (fog off).
         display_dungeon();
         // Draw the targeting pointer (an asterisk) at the target location.
-        mvaddch(target_y + 1, target_x, '*');  // dungeon is drawn starting at row 1
-        refresh();
+        render_overlay(target_x, target_y, '*', 0);
+        screen_refresh();
         
-        int ch = getch();
+        int ch = screen_getch();
         switch (ch) {
             case 27: // ESC cancels teleport mode.
                 display_message("Teleport cancelled.");
@@ -309,8 +358,8 @@ void handle_teleport_mode(character_t &pc) {
             case 'r': { // Random teleport target.
                 int rx, ry;
                 do {
-                    rx = rand() % WIDTH;
-                    ry = rand() % HEIGHT;
+                    rx = rng_below(RngStream::Combat, WIDTH);
+                    ry = rng_below(RngStream::Combat, HEIGHT);
                 } while (hardness[ry][rx] == 255);  // Immutable rock is not allowed.
                 target_x = rx;
                 target_y = ry;
@@ -321,16 +370,13 @@ void handle_teleport_mode(character_t &pc) {
             case 'g': { // Confirm teleport.
                 if (hardness[target_y][target_x] == 255) {
                     display_message("Cannot teleport into immutable rock!");
+                } else if (monster_at(target_x, target_y)) {
+                    display_message("Something is already standing there!");
                 } else {
                     // Teleport: update PC's position.
-                    dungeon[pc.y][pc.x] = base_map[pc.y][pc.x];
-                    pc.x = target_x;
-                    pc.y = target_y;
-                    dungeon[pc.y][pc.x] = '@';
-                    // Update the base map to reflect the new position.
-                    for (int y = 0; y < HEIGHT; y++) {
-                        fog_map[y].fill(' ');
-                    }
+                    move_character(pc, target_x, target_y);
+                    // The PC loses its bearings.
+                    forget_level();
                     update_fog_map();
                     
                     display_message("Teleported.");
@@ -347,22 +393,67 @@ void handle_teleport_mode(character_t &pc) {
     display_dungeon();
 }
 
+// Pick a travel destination with a cursor over the remembered map.
+// Returns true once a trip has started.
+static bool handle_travel_mode(character_t &pc) {
+    int target_x = pc.x;
+    int target_y = pc.y;
+    nearest_known_stairs('>', target_x, target_y);
+
+    display_message("Travel: move the cursor, '<' or '>' for stairs, '.' or 'g' to go, ESC to cancel.");
+
+    while (true) {
+        display_dungeon();
+        render_overlay(target_x, target_y, '*', 6);
+        screen_refresh();
+
+        int ch = screen_getch();
+        int dx = 0, dy = 0;
+        switch (ch) {
+            case 27:
+                display_message("Travel cancelled.");
+                return false;
+            case '<': case '>':
+                if (!nearest_known_stairs(static_cast<char>(ch), target_x, target_y))
+                    display_message("You don't know of any such stairs.");
+                break;
+            case '.': case 'g':
+                return travel_to(target_x, target_y);
+            case '7': case 'y': dx = -1; dy = -1; break;
+            case '8': case 'k': dy = -1; break;
+            case '9': case 'u': dx = 1; dy = -1; break;
+            case '6': case 'l': dx = 1; break;
+            case '3': case 'n': dx = 1; dy = 1; break;
+            case '2': case 'j': dy = 1; break;
+            case '1': case 'b': dx = -1; dy = 1; break;
+            case '4': case 'h': dx = -1; break;
+            default:
+                break;
+        }
+        if (inBounds(target_x + dx, target_y + dy)) {
+            target_x += dx;
+            target_y += dy;
+        }
+    }
+}
+
 void handle_ranged_attack_mode(character_t &pc) {
     int target_x = pc.x;
     int target_y = pc.y;
 
     bool old_fog_toggle = fog_toggle;
     fog_toggle = true;
+    los_sync();
 
     display_message("Ranged attack mode: move to target and press 'f' to fire, ESC to cancel.");
 
     bool done = false;
     while (!done) {
         display_dungeon();
-        mvaddch(target_y + 1, target_x, '*'); // Draw targeting cursor
-        refresh();
+        draw_target_cursor(pc, target_x, target_y);
+        screen_refresh();
 
-        int ch = getch();
+        int ch = screen_getch();
         switch (ch) {
             case 27: // ESC
                 display_message("Ranged attack canceled.");
@@ -405,69 +496,42 @@ void handle_ranged_attack_mode(character_t &pc) {
                         display_message("Not enough mana to cast Fireball!");
                         return;
                     }                    
+                    // The shot flies along the precomputed line and stops on
+                    // the first monster or wall in the way.
+                    int hit_x, hit_y;
+                    bool hit = los_trace(pc.x, pc.y, target_x, target_y, hit_x, hit_y);
+
                     // Animate projectile
-                    int sx = pc.x;
-                    int sy = pc.y;
-                    int ex = target_x;
-                    int ey = target_y;
-                    int dx = (ex > sx) ? 1 : ((ex < sx) ? -1 : 0);
-                    int dy = (ey > sy) ? 1 : ((ey < sy) ? -1 : 0);
-                    int cx = sx;
-                    int cy = sy;
-                    while (cx != ex || cy != ey) {
-                        if (cx != ex) cx += dx;
-                        if (cy != ey) cy += dy;
-                        display_dungeon();
-                        move(cy + 1, cx);
-                        attron(COLOR_PAIR(1)); // Red
-                        addch('*');
-                        attroff(COLOR_PAIR(1));
-                        refresh();
-                        napms(150);
+                    for (const auto &cell : los_line(pc.x, pc.y, hit_x, hit_y)) {
+                        anim_frame(PROJECTILE_STEP_MS);
+                        anim_cell(cell.first, cell.second, '*', 1); // Red
                     }
                     int radius = 2;
-                    clear();
 
                     // EXPLOSION ANIMATION START
-                    for (int dy = -radius; dy <= radius; dy++) {
-                        for (int dx = -radius; dx <= radius; dx++) {
-                            int ex = target_x + dx;
-                            int ey = target_y + dy;
-                            if (inBounds(ex, ey) && dx*dx + dy*dy <= radius*radius) {
-                                move(ey + 1, ex);
-                                attron(COLOR_PAIR(6)); // Yellow
-                                addch('*');
-                                attroff(COLOR_PAIR(6));
-                            }
-                        }
-                    }
-                refresh();
-                napms(300); // pause 300ms
-                display_dungeon(); // redraw after flash
+                    anim_frame(BLAST_FLASH_MS);
+                    anim_cells(aoe_query(hit_x, hit_y, {AoeShape::Disc, radius, true}).cells, '*', 6); // Yellow
+                    anim_play();
 
                 pc.mana -= 5;
 
                 
                     // Handle actual hit/miss
-                    bool hit = false;
-                    for (auto &ch : characters) {
-                        if (ch.alive && ch.type == CharType::Monster && ch.x == target_x && ch.y == target_y) {
-                            int damage = 5 + (rand() % 6);
-                            ch.hp -= damage;
-                            char buf[80];
-                            snprintf(buf, sizeof(buf), "You hit %c for %d damage!", ch.symbol, damage);
-                            display_message(buf);
-                
-                            if (ch.hp <= 0) {
-                                ch.alive = false;
-                                dungeon[ch.y][ch.x] = base_map[ch.y][ch.x];
-                                display_message("Monster killed!");
-                            }
-                            hit = true;
-                            break;
+                    if (hit) {
+                        character_t &ch = *monster_at(hit_x, hit_y);
+                        int damage = 5 + rng_below(RngStream::Combat, 6);
+                        set_hp(ch, ch.hp - damage);
+                        char buf[80];
+                        snprintf(buf, sizeof(buf), "You hit %c for %d damage!", ch.symbol, damage);
+                        display_message(buf);
+            
+                        if (ch.hp <= 0) {
+                            kill_character(ch);
+                            display_message("Monster killed!");
                         }
-                    }
-                    if (!hit) {
+                    } else if (hit_x != target_x || hit_y != target_y) {
+                        display_message("Your shot hits a wall.");
+                    } else {
                         display_message("You missed. No monster there!");
                     }
                     done = true;
@@ -489,6 +553,7 @@ void handle_magic_spell_mode(character_t &pc) {
 
     bool old_fog_toggle = fog_toggle;
     fog_toggle = true;
+    los_sync();
 
     display_message("Poison ball mode: move to center, press 'f' to cast, ESC to cancel.");
 
@@ -500,10 +565,10 @@ void handle_magic_spell_mode(character_t &pc) {
     
     while (!done) {
         display_dungeon();
-        mvaddch(target_y + 1, target_x, '*'); // Draw targeting cursor
-        refresh();
+        draw_target_cursor(pc, target_x, target_y);
+        screen_refresh();
 
-        int ch = getch();
+        int ch = screen_getch();
         switch (ch) {
             case 27: // ESC
                 display_message("Spell casting canceled.");
@@ -542,50 +607,22 @@ void handle_magic_spell_mode(character_t &pc) {
                     target_x--;
                 break;
             case 'f': { // 'f' to cast spell
+                if (!los_clear(pc.x, pc.y, target_x, target_y)) {
+                    display_message("No clear line to that spot.");
+                    break;
+                }
                 int radius = 2;
-                clear();
 
                 // EXPLOSION ANIMATION START
-                for (int dy = -radius; dy <= radius; dy++) {
-                    for (int dx = -radius; dx <= radius; dx++) {
-                        int ex = target_x + dx;
-                        int ey = target_y + dy;
-                        if (inBounds(ex, ey) && dx*dx + dy*dy <= radius*radius) {
-                            move(ey + 1, ex);
-                            attron(COLOR_PAIR(2)); // GREEN
-                            addch('*');
-                            attroff(COLOR_PAIR(2));
-                        }
-                    }
-                }
-                refresh();
-                napms(300); // pause 300ms
-                display_dungeon(); // redraw after flash
+                aoe_hits_t hits = aoe_query(target_x, target_y, {AoeShape::Disc, radius, true});
+                anim_frame(BLAST_FLASH_MS);
+                anim_cells(hits.cells, '*', 2); // GREEN
+                anim_play();
 
                 pc.mana -= 3;
 
             
-                int monsters_hit = 0;
-                for (auto &ch : characters) {
-                    if (ch.alive && ch.type == CharType::Monster) {
-                        int dx = ch.x - target_x;
-                        int dy = ch.y - target_y;
-                        if (dx*dx + dy*dy <= radius*radius) {
-                            int damage = 3 + (rand() % 5);
-                            ch.hp -= damage;
-                            monsters_hit++;
-                            if (ch.hp <= 0) {
-                                ch.alive = false;
-                                dungeon[ch.y][ch.x] = base_map[ch.y][ch.x];
-                            }
-                        }
-                    }
-                }
-                if (monsters_hit > 0) {
-                    display_message("Poison ball explodes! Monsters take damage.");
-                } else {
-                    display_message("Poison ball explodes harmlessly.");
-                }
+                aoe_apply_damage(hits, 3, 5, "Poison ball");
                 done = true;
                 break;
             }
@@ -609,16 +646,17 @@ void handle_fireball_spell_mode(character_t &pc) {
 
     bool old_fog_toggle = fog_toggle;
     fog_toggle = true;
+    los_sync();
 
     display_message("Fireball mode: move to center, press 'f' to cast, ESC to cancel.");
 
     bool done = false;
     while (!done) {
         display_dungeon();
-        mvaddch(target_y + 1, target_x, '*'); // Draw targeting cursor
-        refresh();
+        draw_target_cursor(pc, target_x, target_y);
+        screen_refresh();
 
-        int ch = getch();
+        int ch = screen_getch();
         switch (ch) {
             case 27: // ESC
                 display_message("Spell casting canceled.");
@@ -657,48 +695,21 @@ void handle_fireball_spell_mode(character_t &pc) {
                     target_x--;
                 break;
             case 'f': { // 'f' to cast
+                if (!los_clear(pc.x, pc.y, target_x, target_y)) {
+                    display_message("No clear line to that spot.");
+                    break;
+                }
                 int radius = 1;
 
                 // EXPLOSION FLASH
-                for (int dy = -radius; dy <= radius; dy++) {
-                    for (int dx = -radius; dx <= radius; dx++) {
-                        int ex = target_x + dx;
-                        int ey = target_y + dy;
-                        if (inBounds(ex, ey) && dx*dx + dy*dy <= radius*radius) {
-                            move(ey + 1, ex);
-                            attron(COLOR_PAIR(1)); // RED Explosion
-                            addch('*');
-                            attroff(COLOR_PAIR(1));
-                        }
-                    }
-                }
-                refresh();
-                napms(300);
-                display_dungeon();
+                aoe_hits_t hits = aoe_query(target_x, target_y, {AoeShape::Disc, radius, true});
+                anim_frame(BLAST_FLASH_MS);
+                anim_cells(hits.cells, '*', 1); // RED Explosion
+                anim_play();
 
                 pc.mana -= 5; // Spend mana
 
-                int monsters_hit = 0;
-                for (auto &ch : characters) {
-                    if (ch.alive && ch.type == CharType::Monster) {
-                        int dx = ch.x - target_x;
-                        int dy = ch.y - target_y;
-                        if (dx*dx + dy*dy <= radius*radius) {
-                            int damage = 10 + (rand() % 6); // 10-15 massive fire damage
-                            ch.hp -= damage;
-                            monsters_hit++;
-                            if (ch.hp <= 0) {
-                                ch.alive = false;
-                                dungeon[ch.y][ch.x] = base_map[ch.y][ch.x];
-                            }
-                        }
-                    }
-                }
-                if (monsters_hit > 0) {
-                    display_message("Fireball explodes! Massive damage!");
-                } else {
-                    display_message("Fireball explodes harmlessly.");
-                }
+                aoe_apply_damage(hits, 10, 6, "Fireball");
                 done = true;
                 break;
             }
@@ -716,18 +727,22 @@ void handle_monster_look_mode(character_t &pc) {
     int target_x = pc.x;
     int target_y = pc.y;
     bool old_fog = fog_toggle;
+    // Gather what is in view before the fog is lifted for the cursor.
+    nearest_monsters_t nearby;
+    nearby.build();
+    int current = -1;
     fog_toggle = true;
 
-    display_message("Look mode: Move with hjkl+yubn. Press 't' to inspect. ESC to exit.");
+    display_message("Look mode: hjkl+yubn move, Tab/- next/prev monster, 't' inspect, ESC exit.");
 
     while (true) {
         display_dungeon();
 
         // Draw cursor
-        mvaddch(target_y + 1, target_x, '*');
-        refresh();
+        render_overlay(target_x, target_y, '*', 0);
+        screen_refresh();
 
-        int ch = getch();
+        int ch = screen_getch();
         if (ch == 27) {  // ESC
             display_message("Exited look mode.");
             break;
@@ -751,23 +766,37 @@ void handle_monster_look_mode(character_t &pc) {
             target_y = ny;
         }
 
+        // Tab jumps to the next nearest monster in view, '-' back again.
+        if ((ch == '\t' || ch == '-') && nearby.size() > 0) {
+            int n = static_cast<int>(nearby.size());
+            if (ch == '\t')
+                current = (current + 1) % n;
+            else
+                current = current <= 0 ? n - 1 : current - 1;
+            const character_t &mon = nearby.at(current);
+            target_x = mon.x;
+            target_y = mon.y;
+        } else if (ch == '\t' || ch == '-') {
+            display_message("No monsters in view.");
+        }
+
         // Press 't' to inspect a monster at the cursor
         if (ch == 't') {
-            for (const auto &mon : characters) {
-                if (mon.alive && mon.type == CharType::Monster &&
-                    mon.x == target_x && mon.y == target_y) {
-
-                    clear();
-                    mvprintw(0, 0, "=== Monster ===");
-                    mvprintw(1, 0, "Symbol: %c", mon.symbol);
-                    mvprintw(2, 0, "HP: %d", mon.hp);
-                    mvprintw(3, 0, "Speed: %d", mon.speed);
-                    mvprintw(4, 0, "Position: (%d, %d)", mon.x, mon.y);
-                    mvprintw(5, 0, "Press any key...");
-                    refresh();
-                    getch();
-                    break;
-                }
+            // Look mode lifts the fog for targeting, but only what the PC
+            // can actually see is inspectable.
+            if (!old_fog && !fov_visible(target_x, target_y)) {
+                display_message("You can't see that far.");
+            } else if (const character_t* m = monster_at(target_x, target_y)) {
+                const character_t &mon = *m;
+                clear_screen();
+                screen_printf(0, 0, "=== Monster ===");
+                screen_printf(1, 0, "Symbol: %c", mon.symbol);
+                screen_printf(2, 0, "HP: %d", mon.hp);
+                screen_printf(3, 0, "Speed: %d", mon.speed);
+                screen_printf(4, 0, "Position: (%d, %d)", mon.x, mon.y);
+                screen_printf(5, 0, "Press any key...");
+                screen_refresh();
+                screen_getch();
             }
         }
     }
@@ -778,412 +807,320 @@ void handle_monster_look_mode(character_t &pc) {
 
 
 
-void handle_pc_input(character_t &pc) {
-    while (true) {
-        int ch = getch();
-        switch (ch) {
-            case '7': case 'y': {
-                int nx = pc.x - 1, ny = pc.y - 1;
+// Command handlers. Each returns true when the PC's turn is used up and
+// false for free actions (menus, views), after which another key is read.
+typedef bool (*command_fn)(character_t &pc);
 
-                // Check for monster at target cell
-                for (auto &target : characters) {
-                    if (target.alive && target.x == nx && target.y == ny && target.type == CharType::Monster) {
-                        perform_attack(pc, target);
-                        return; 
-                    }
-                }
-                if (inBounds(nx, ny) && pc_can_walk_on(dungeon[ny][nx])) {
-                    dungeon[pc.y][pc.x] = base_map[pc.y][pc.x];
-                    pc.x = nx; pc.y = ny;
-                    dungeon[ny][nx] = '@';
-                    try_pickup_item(pc);
-                } else {
-                    display_message("Blocked!");
-                }
-                return;
-            }
-            case '8': case 'k': {
-                int nx = pc.x, ny = pc.y - 1;
-                // Check for monster at target cell
-                for (auto &target : characters) {
-                    if (target.alive && target.x == nx && target.y == ny && target.type == CharType::Monster) {
-                        perform_attack(pc, target);
-                        return; // No movement if attack occurs
-                    }
-                }
-                if (inBounds(nx, ny) && pc_can_walk_on(dungeon[ny][nx])) {
-                    dungeon[pc.y][pc.x] = base_map[pc.y][pc.x];
-                    pc.y = ny;
-                    dungeon[ny][nx] = '@';
-                    try_pickup_item(pc);
-                } else {
-                    display_message("Blocked!");
-                }
-                return;
-            }
-            case '9': case 'u': {
-                int nx = pc.x + 1, ny = pc.y - 1;
-                if (inBounds(nx, ny) && pc_can_walk_on(dungeon[ny][nx])) {
-                    dungeon[pc.y][pc.x] = base_map[pc.y][pc.x];
-                    pc.x = nx; pc.y = ny;
-                    dungeon[ny][nx] = '@';
-                    try_pickup_item(pc);
-                } else {
-                    display_message("Blocked!");
-                }
-                return;
-            }
-            case '6': case 'l': {
-                int nx = pc.x + 1, ny = pc.y;
-                for (auto &target : characters) {
-                    if (target.alive && target.x == nx && target.y == ny && target.type == CharType::Monster) {
-                        perform_attack(pc, target);
-                        return; // No movement if attack occurs
-                    }
-                }
-                if (inBounds(nx, ny) && pc_can_walk_on(dungeon[ny][nx])) {
-                    dungeon[pc.y][pc.x] = base_map[pc.y][pc.x];
-                    pc.x = nx;
-                    dungeon[ny][nx] = '@';
-                    try_pickup_item(pc);
-                } else {
-                    display_message("Blocked!");
-                }
-                return;
-            }
-            case '3': case 'n': {
-                int nx = pc.x + 1, ny = pc.y + 1;
-                for (auto &target : characters) {
-                    if (target.alive && target.x == nx && target.y == ny && target.type == CharType::Monster) {
-                        perform_attack(pc, target);
-                        return; // No movement if attack occurs
-                    }
-                }
-                if (inBounds(nx, ny) && pc_can_walk_on(dungeon[ny][nx])) {
-                    dungeon[pc.y][pc.x] = base_map[pc.y][pc.x];
-                    pc.x = nx; pc.y = ny;
-                    dungeon[ny][nx] = '@';
-                    try_pickup_item(pc);
-                } else {
-                    display_message("Blocked!");
-                }
-                return;
-            }
-            case '2': case 'j': {
-                int nx = pc.x, ny = pc.y + 1;
-                if (inBounds(nx, ny) && pc_can_walk_on(dungeon[ny][nx])) {
-                    dungeon[pc.y][pc.x] = base_map[pc.y][pc.x];
-                    pc.y = ny;
-                    dungeon[ny][nx] = '@';
-                    try_pickup_item(pc);
-                } else {
-                    display_message("Blocked!");
-                }
-                return;
-            }
-            case '1': case 'b': {
-                int nx = pc.x - 1, ny = pc.y + 1;
-                for (auto &target : characters) {
-                    if (target.alive && target.x == nx && target.y == ny && target.type == CharType::Monster) {
-                        perform_attack(pc, target);
-                        return; // No movement if attack occurs
-                    }
-                }
-                if (inBounds(nx, ny) && pc_can_walk_on(dungeon[ny][nx])) {
-                    dungeon[pc.y][pc.x] = base_map[pc.y][pc.x];
-                    pc.x = nx; pc.y = ny;
-                    dungeon[ny][nx] = '@';
-                    try_pickup_item(pc);
-                } else {
-                    display_message("Blocked!");
-                }
-                return;
-            }
-            case '4': case 'h': {
-                int nx = pc.x - 1, ny = pc.y;
-                for (auto &target : characters) {
-                    if (target.alive && target.x == nx && target.y == ny && target.type == CharType::Monster) {
-                        perform_attack(pc, target);
-                        return; // No movement if attack occurs
-                    }
-                }
-                if (inBounds(nx, ny) && pc_can_walk_on(dungeon[ny][nx])) {
-                    dungeon[pc.y][pc.x] = base_map[pc.y][pc.x];
-                    pc.x = nx;
-                    dungeon[ny][nx] = '@';
-                    try_pickup_item(pc);
-                } else {
-                    display_message("Blocked!");
-                }
-                return;
-            }
-            // g now activates teleport mode.
-            case 'g': {
-                handle_teleport_mode(pc);
-                return;
-            }
-            case 'i': {
-                clear();
-                mvprintw(0, 0, "--- Inventory (0-9) ---");
-                character_t &pc = characters[0];  // assuming PC is first
-            
-                int row = 1;
-                for (int i = 0; i < character_t::MAX_CARRY; ++i) {
-                    if (pc.inventory[i])
-                        mvprintw(row++, 0, "%d: %s", i, pc.inventory[i]->name.c_str());
-                    else
-                        mvprintw(row++, 0, "%d: <empty>", i);
-                }
-            
-                mvprintw(row + 1, 0, "Press any key to continue...");
-                refresh();
-                getch();
-                display_dungeon();
-                break;
-            }
-            case 'e': {
-                clear();
-                mvprintw(0, 0, "--- Equipment (a-l) ---");
-                character_t &pc = characters[0];
-            
-                const char* slot_names[] = {
-                    "a: WEAPON", "b: OFFHAND", "c: RANGED", "d: ARMOR", "e: HELMET", "f: CLOAK",
-                    "g: GLOVES", "h: BOOTS", "i: AMULET", "j: LIGHT", "k: RING1", "l: RING2"
-                };
-            
-                int row = 1;
-                for (int i = 0; i < NUM_EQUIP_SLOTS; ++i) {
-                    if (pc.equipment[i])
-                        mvprintw(row++, 0, "%s - %s", slot_names[i], pc.equipment[i]->name.c_str());
-                    else
-                        mvprintw(row++, 0, "%s - <empty>", slot_names[i]);
-                }
-            
-                mvprintw(row + 1, 0, "Press any key to continue...");
-                refresh();
-                getch();
-                display_dungeon();
-                break;
-            }
-            case 'I': {
-                display_message("Inspect item (0-9), ESC to cancel");
-                int ch = getch();
-                if (ch >= '0' && ch <= '9') {
-                    int idx = ch - '0';
-                    character_t &pc = characters[0];
-                    if (pc.inventory[idx]) {
-                        clear();
-                        mvprintw(0, 0, "=== %s ===", pc.inventory[idx]->name.c_str());
-                        mvprintw(1, 0, "%s", object_templates[0].description.c_str()); // FIX: this line later
-                        mvprintw(3, 0, "Press any key to return.");
-                        refresh();
-                        getch();
-                    } else {
-                        display_message("Empty slot.");
-                    }
-                } else {
-                    display_message("Inspection cancelled.");
-                }
-                break;
-            }
-            case 'f': {
-                fog_toggle = !fog_toggle;
-                if (fog_toggle)
-                    display_message("Fog disabled: full dungeon view.");
-                else
-                    display_message("Fog enabled: dungeon with fog of war.");
-                return;
-            }
-            // Use stairs to go down.
-            case '>': { 
-            // Check underlying terrain from base_map.
-            if (base_map[pc.y][pc.x] == '>') {
-                new_level(DEFAULT_NUMMON);
-                display_message("You go down the stairs...");
-            } else {
-                display_message("No downward staircase here!");
-            }
-                return;
-            }
-            case 'w': {
-                display_message("Wear item from inventory (0-9), ESC to cancel");
-                int ch = getch();
-                if (ch >= '0' && ch <= '9') {
-                    int idx = ch - '0';
-                    character_t &pc = characters[0];
-                    if (!pc.inventory[idx]) {
-                        display_message("No item in that slot.");
-                        break;
-                    }
-            
-                    ObjectType type = object_templates[0].type; // Fix this later when templates are linked
-            
-                    int slot = -1;
-                    switch (type) {
-                        case ObjectType::WEAPON: slot = 0; break;
-                        case ObjectType::OFFHAND: slot = 1; break;
-                        case ObjectType::RANGED: slot = 2; break;
-                        case ObjectType::ARMOR: slot = 3; break;
-                        case ObjectType::HELMET: slot = 4; break;
-                        case ObjectType::CLOAK: slot = 5; break;
-                        case ObjectType::GLOVES: slot = 6; break;
-                        case ObjectType::BOOTS: slot = 7; break;
-                        case ObjectType::AMULET: slot = 8; break;
-                        case ObjectType::LIGHT: slot = 9; break;
-                        case ObjectType::RING:
-                            slot = pc.equipment[10] ? 11 : 10; // Pick first free ring
-                            break;
-                        default:
-                            display_message("Can't equip that type.");
-                            return;
-                    }
-            
-                    if (slot < 0 || slot >= NUM_EQUIP_SLOTS) {
-                        display_message("Invalid slot.");
-                        return;
-                    }
-            
-                    if (pc.equipment[slot]) {
-                        // Swap
-                        std::swap(pc.inventory[idx], pc.equipment[slot]);
-                        display_message("Swapped with equipped item.");
-                    } else {
-                        // Equip directly
-                        pc.equipment[slot] = pc.inventory[idx];
-                        pc.inventory[idx].reset();
-                        display_message("Item equipped.");
-                    }
-                } else {
-                    display_message("Wear cancelled.");
-                }
-                break;
-            }
-            case 't': {
-                display_message("Take off equipment (a-l), ESC to cancel");
-                int ch = getch();
-                int slot = -1;
-                if (ch >= 'a' && ch <= 'l')
-                    slot = ch - 'a';
-                else {
-                    display_message("Cancelled.");
-                    break;
-                }
-            
-                character_t &pc = characters[0];
-                if (!pc.equipment[slot]) {
-                    display_message("Nothing in that slot.");
-                    break;
-                }
-            
-                // Find an open carry slot
-                for (int i = 0; i < character_t::MAX_CARRY; ++i) {
-                    if (!pc.inventory[i]) {
-                        pc.inventory[i] = pc.equipment[slot];
-                        pc.equipment[slot].reset();
-                        display_message("Item taken off.");
-                        return;
-                    }
-                }
-            
-                display_message("Inventory full. Cannot unequip.");
-                break;
-            }
-            case 'd': {
-                display_message("Drop item (0-9), ESC to cancel");
-                int ch = getch();
-                if (ch >= '0' && ch <= '9') {
-                    int idx = ch - '0';
-                    character_t &pc = characters[0];
-                    if (!pc.inventory[idx]) {
-                        display_message("Nothing in that slot.");
-                        break;
-                    }
-            
-                    ObjectInstance &item = *pc.inventory[idx];
-                    item.x = pc.x;
-                    item.y = pc.y;
-                    object_instances.push_back(item);
-                    pc.inventory[idx].reset();
-                    display_message("Item dropped.");
-                } else {
-                    display_message("Drop cancelled.");
-                }
-                break;
-            }
-            case 'x': {
-                display_message("Expunge item (0-9), ESC to cancel");
-                int ch = getch();
-                if (ch >= '0' && ch <= '9') {
-                    int idx = ch - '0';
-                    character_t &pc = characters[0];
-                    if (!pc.inventory[idx]) {
-                        display_message("No item to expunge.");
-                    } else {
-                        pc.inventory[idx].reset();
-                        display_message("Item destroyed.");
-                    }
-                } else {
-                    display_message("Expunge cancelled.");
-                }
-                break;
-            }
-            
-            
-                // Use stairs to go up.
-            case '<': {
-                if (base_map[pc.y][pc.x] == '<') {
-                    new_level(DEFAULT_NUMMON);
-                    display_message("You go up the stairs...");
-                } else {
-                display_message("No upward staircase here!");
-                }
-                return;
-            }
-            case 'L': {
-                handle_monster_look_mode(pc);
-                return;
-            }            
-            case 'm': {
-                display_monster_list();
-                break;
-            }
-            case 'Q': {
-                return;
-            }
-            case 'a': {
-                handle_ranged_attack_mode(pc);
-                return;
-            }
-            case 'p': {
-                handle_magic_spell_mode(pc);
-                return;
-            }
-            case 'F': {
-                handle_fireball_spell_mode(pc);
-                return;
-            }                        
-            default:
-                break;
+// Attack whatever stands on the target cell, else step there.
+static bool move_or_attack(character_t &pc, int dx, int dy) {
+    int nx = pc.x + dx, ny = pc.y + dy;
+    if (character_t* target = monster_at(nx, ny)) {
+        perform_attack(pc, *target);
+        return true;
+    }
+    if (inBounds(nx, ny) && pc_can_walk_on(dungeon[ny][nx])) {
+        move_character(pc, nx, ny);
+        try_pickup_item(pc);
+    } else {
+        display_message("Blocked!");
+    }
+    return true;
+}
+
+static bool cmd_rest(character_t &) {
+    return true;
+}
+
+static bool cmd_stairs(character_t &pc, char stair, const char* went, const char* none) {
+    // Check underlying terrain from base_map.
+    if (base_map[pc.y][pc.x] == stair) {
+        change_level(stair == '>' ? 1 : -1, DEFAULT_NUMMON);
+        display_message(went);
+    } else {
+        display_message(none);
+    }
+    return true;
+}
+
+static bool cmd_inventory(character_t &pc) {
+    clear_screen();
+    screen_printf(0, 0, "--- Inventory (0-9) ---");
+
+    int row = 1;
+    for (int i = 0; i < character_t::MAX_CARRY; ++i) {
+        if (pc.inventory[i])
+            screen_printf(row++, 0, "%d: %s", i, pc.inventory[i]->name.c_str());
+        else
+            screen_printf(row++, 0, "%d: <empty>", i);
+    }
+
+    screen_printf(row + 1, 0, "Press any key to continue...");
+    screen_refresh();
+    screen_getch();
+    display_dungeon();
+    return false;
+}
+
+static bool cmd_equipment(character_t &pc) {
+    clear_screen();
+    screen_printf(0, 0, "--- Equipment (a-l) ---");
+
+    const char* slot_names[] = {
+        "a: WEAPON", "b: OFFHAND", "c: RANGED", "d: ARMOR", "e: HELMET", "f: CLOAK",
+        "g: GLOVES", "h: BOOTS", "i: AMULET", "j: LIGHT", "k: RING1", "l: RING2"
+    };
+
+    int row = 1;
+    for (int i = 0; i < NUM_EQUIP_SLOTS; ++i) {
+        if (pc.equipment[i])
+            screen_printf(row++, 0, "%s - %s", slot_names[i], pc.equipment[i]->name.c_str());
+        else
+            screen_printf(row++, 0, "%s - <empty>", slot_names[i]);
+    }
+
+    screen_printf(row + 1, 0, "Press any key to continue...");
+    screen_refresh();
+    screen_getch();
+    display_dungeon();
+    return false;
+}
+
+static bool cmd_inspect(character_t &pc) {
+    display_message("Inspect item (0-9), ESC to cancel");
+    int ch = screen_getch();
+    if (ch >= '0' && ch <= '9') {
+        int idx = ch - '0';
+        if (pc.inventory[idx]) {
+            clear_screen();
+            screen_printf(0, 0, "=== %s ===", pc.inventory[idx]->name.c_str());
+            screen_printf(1, 0, "%s", object_templates[0].description.c_str()); // FIX: this line later
+            screen_printf(3, 0, "Press any key to return.");
+            screen_refresh();
+            screen_getch();
+        } else {
+            display_message("Empty slot.");
+        }
+    } else {
+        display_message("Inspection cancelled.");
+    }
+    return false;
+}
+
+static bool cmd_wear(character_t &pc) {
+    display_message("Wear item from inventory (0-9), ESC to cancel");
+    int ch = screen_getch();
+    if (ch < '0' || ch > '9') {
+        display_message("Wear cancelled.");
+        return false;
+    }
+    int idx = ch - '0';
+    if (!pc.inventory[idx]) {
+        display_message("No item in that slot.");
+        return false;
+    }
+
+    ObjectType type = object_templates[0].type; // Fix this later when templates are linked
+
+    int slot = -1;
+    switch (type) {
+        case ObjectType::WEAPON: slot = 0; break;
+        case ObjectType::OFFHAND: slot = 1; break;
+        case ObjectType::RANGED: slot = 2; break;
+        case ObjectType::ARMOR: slot = 3; break;
+        case ObjectType::HELMET: slot = 4; break;
+        case ObjectType::CLOAK: slot = 5; break;
+        case ObjectType::GLOVES: slot = 6; break;
+        case ObjectType::BOOTS: slot = 7; break;
+        case ObjectType::AMULET: slot = 8; break;
+        case ObjectType::LIGHT: slot = 9; break;
+        case ObjectType::RING:
+            slot = pc.equipment[10] ? 11 : 10; // Pick first free ring
+            break;
+        default:
+            display_message("Can't equip that type.");
+            return true;
+    }
+
+    if (slot < 0 || slot >= NUM_EQUIP_SLOTS) {
+        display_message("Invalid slot.");
+        return true;
+    }
+
+    if (pc.equipment[slot]) {
+        // Swap
+        std::swap(pc.inventory[idx], pc.equipment[slot]);
+        display_message("Swapped with equipped item.");
+    } else {
+        // Equip directly
+        pc.equipment[slot] = pc.inventory[idx];
+        pc.inventory[idx].reset();
+        display_message("Item equipped.");
+    }
+    return false;
+}
+
+static bool cmd_take_off(character_t &pc) {
+    display_message("Take off equipment (a-l), ESC to cancel");
+    int ch = screen_getch();
+    if (ch < 'a' || ch > 'l') {
+        display_message("Cancelled.");
+        return false;
+    }
+    int slot = ch - 'a';
+    if (!pc.equipment[slot]) {
+        display_message("Nothing in that slot.");
+        return false;
+    }
+
+    // Find an open carry slot
+    for (int i = 0; i < character_t::MAX_CARRY; ++i) {
+        if (!pc.inventory[i]) {
+            pc.inventory[i] = pc.equipment[slot];
+            pc.equipment[slot].reset();
+            display_message("Item taken off.");
+            return true;
         }
     }
+
+    display_message("Inventory full. Cannot unequip.");
+    return false;
+}
+
+static bool cmd_drop(character_t &pc) {
+    display_message("Drop item (0-9), ESC to cancel");
+    int ch = screen_getch();
+    if (ch < '0' || ch > '9') {
+        display_message("Drop cancelled.");
+        return false;
+    }
+    int idx = ch - '0';
+    if (!pc.inventory[idx]) {
+        display_message("Nothing in that slot.");
+        return false;
+    }
+
+    ObjectInstance &item = *pc.inventory[idx];
+    item.x = pc.x;
+    item.y = pc.y;
+    place_object(item);
+    pc.inventory[idx].reset();
+    display_message("Item dropped.");
+    return false;
+}
+
+static bool cmd_expunge(character_t &pc) {
+    display_message("Expunge item (0-9), ESC to cancel");
+    int ch = screen_getch();
+    if (ch < '0' || ch > '9') {
+        display_message("Expunge cancelled.");
+        return false;
+    }
+    int idx = ch - '0';
+    if (!pc.inventory[idx]) {
+        display_message("No item to expunge.");
+    } else {
+        pc.inventory[idx].reset();
+        display_message("Item destroyed.");
+    }
+    return false;
+}
+
+static bool cmd_toggle_fog(character_t &) {
+    fog_toggle = !fog_toggle;
+    if (fog_toggle)
+        display_message("Fog disabled: full dungeon view.");
+    else
+        display_message("Fog enabled: dungeon with fog of war.");
+    return true;
+}
+
+static bool cmd_travel(character_t &pc) {
+    if (handle_travel_mode(pc) && travel_step(pc))
+        return true;
+    display_dungeon();
+    return false;
+}
+
+static bool cmd_explore(character_t &pc) {
+    if (travel_explore() && travel_step(pc))
+        return true;
+    display_dungeon();
+    return false;
+}
+
+static bool cmd_unbound(character_t &) {
+    return false;
+}
+
+static const std::array<command_fn, ACTION_COUNT> command_table = [](){
+    std::array<command_fn, ACTION_COUNT> t;
+    t.fill(cmd_unbound);
+    auto set = [&t](Action a, command_fn fn) { t[static_cast<int>(a)] = fn; };
+    set(Action::MoveNW, [](character_t &pc) { return move_or_attack(pc, -1, -1); });
+    set(Action::MoveN,  [](character_t &pc) { return move_or_attack(pc,  0, -1); });
+    set(Action::MoveNE, [](character_t &pc) { return move_or_attack(pc,  1, -1); });
+    set(Action::MoveE,  [](character_t &pc) { return move_or_attack(pc,  1,  0); });
+    set(Action::MoveSE, [](character_t &pc) { return move_or_attack(pc,  1,  1); });
+    set(Action::MoveS,  [](character_t &pc) { return move_or_attack(pc,  0,  1); });
+    set(Action::MoveSW, [](character_t &pc) { return move_or_attack(pc, -1,  1); });
+    set(Action::MoveW,  [](character_t &pc) { return move_or_attack(pc, -1,  0); });
+    set(Action::Rest, cmd_rest);
+    set(Action::StairsDown, [](character_t &pc) {
+        return cmd_stairs(pc, '>', "You go down the stairs...", "No downward staircase here!");
+    });
+    set(Action::StairsUp, [](character_t &pc) {
+        return cmd_stairs(pc, '<', "You go up the stairs...", "No upward staircase here!");
+    });
+    set(Action::Teleport, [](character_t &pc) { handle_teleport_mode(pc); return true; });
+    set(Action::Travel, cmd_travel);
+    set(Action::Explore, cmd_explore);
+    set(Action::Inventory, cmd_inventory);
+    set(Action::Equipment, cmd_equipment);
+    set(Action::Inspect, cmd_inspect);
+    set(Action::Wear, cmd_wear);
+    set(Action::TakeOff, cmd_take_off);
+    set(Action::Drop, cmd_drop);
+    set(Action::Expunge, cmd_expunge);
+    set(Action::ToggleFog, cmd_toggle_fog);
+    set(Action::Look, [](character_t &pc) { handle_monster_look_mode(pc); return true; });
+    set(Action::MonsterList, [](character_t &) { display_monster_list(); return false; });
+    set(Action::MessageLog, [](character_t &) { display_message_log(); return false; });
+    set(Action::Metrics, [](character_t &) { display_metrics(); return false; });
+    set(Action::Ranged, [](character_t &pc) { handle_ranged_attack_mode(pc); return true; });
+    set(Action::PoisonBall, [](character_t &pc) { handle_magic_spell_mode(pc); return true; });
+    set(Action::Fireball, [](character_t &pc) { handle_fireball_spell_mode(pc); return true; });
+    set(Action::Quit, [](character_t &) { game_quit = true; return true; });
+    return t;
+}();
+
+// Keys already typed ahead are handled without drawing in between.
+bool input_pending() {
+    return screen_key_waiting();
+}
+
+void handle_pc_input(character_t &pc) {
+    while (!journal_replay_finished()) {
+        Action a = action_for_key(screen_getch());
+        if (command_table[static_cast<int>(a)](pc))
+            return;
+    }
 }
 
 
 void try_pickup_item(character_t &pc) {
-    for (auto it = object_instances.begin(); it != object_instances.end(); ++it) {
-        if (it->x == pc.x && it->y == pc.y) {
-            // Find an empty inventory slot
-            for (auto &slot : pc.inventory) {
-                if (!slot.has_value()) {
-                    slot = *it;
-                    display_message("You picked up: " + it->name);
-                    object_instances.erase(it);
-                    return;
-                }
-            }
-            display_message("Inventory full! Can't pick up " + it->name);
+    int idx = object_at(pc.x, pc.y);
+    if (idx < 0)
+        return;
+    const ObjectInstance &obj = object_instances[idx];
+    // Find an empty inventory slot
+    for (auto &slot : pc.inventory) {
+        if (!slot.has_value()) {
+            slot = obj;
+            display_message("You picked up: " + obj.name);
+            remove_object(idx);
             return;
         }
     }
+    display_message("Inventory full! Can't pick up " + obj.name);
 }
 
@@ -0,0 +1,142 @@
+#include "zobrist.h"
+#include "character.h"
+#include "rng.h"
+
+enum ZobristKind : uint64_t {
+    Z_TERRAIN = 1, Z_ROOM, Z_STAIRS, Z_POS, Z_HP, Z_ALIVE, Z_FLOOR, Z_CARRIED, Z_PC, Z_RNG,
+};
+
+static zobrist_state_t state;
+
+// splitmix64's finalizer.
+static uint64_t mix(uint64_t z) {
+    z += 0x9e3779b97f4a7c15ULL;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static uint64_t key(uint64_t kind, uint64_t a, uint64_t b = 0, uint64_t c = 0) {
+    return mix(mix(mix(mix(kind) + a) + b) + c);
+}
+
+static uint64_t cell(int x, int y) {
+    return static_cast<uint64_t>(y) * WIDTH + x;
+}
+
+// Everything that tells two objects apart, as one value.
+static uint64_t object_print(const ObjectInstance &o) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    auto add = [&h](uint64_t v) { h = mix(h ^ v); };
+    auto add_str = [&h](const std::string &s) {
+        for (unsigned char ch : s)
+            h = (h ^ ch) * 0x100000001b3ULL;
+        h = mix(h ^ s.size());
+    };
+    add_str(o.name);
+    add_str(o.description);
+    for (const std::string &c : o.color)
+        add_str(c);
+    add(static_cast<unsigned char>(o.symbol));
+    add(o.is_artifact);
+    for (int v : {o.hit, o.dodge, o.defense, o.weight, o.speed, o.attribute, o.value,
+                  o.damage.base, o.damage.dice, o.damage.sides})
+        add(static_cast<uint32_t>(v));
+    return h;
+}
+
+static uint64_t floor_key(const ObjectInstance &o) {
+    return key(Z_FLOOR, cell(o.x, o.y), object_print(o));
+}
+
+static uint64_t character_key(int idx, const character_t &c) {
+    uint64_t h = key(Z_POS, idx, cell(c.x, c.y)) ^ key(Z_HP, idx, static_cast<uint32_t>(c.hp));
+    return c.alive ? h ^ key(Z_ALIVE, idx) : h;
+}
+
+// Read-time part: the PC's pack and mana, and the random streams.
+static uint64_t folded() {
+    uint64_t h = 0;
+    if (!characters.empty()) {
+        const character_t &pc = characters[0];
+        for (int s = 0; s < character_t::MAX_CARRY; s++)
+            if (pc.inventory[s])
+                h ^= key(Z_CARRIED, s, object_print(*pc.inventory[s]));
+        for (int s = 0; s < NUM_EQUIP_SLOTS; s++)
+            if (pc.equipment[s])
+                h ^= key(Z_CARRIED, character_t::MAX_CARRY + s, object_print(*pc.equipment[s]));
+        h ^= key(Z_PC, static_cast<uint32_t>(pc.mana), static_cast<uint32_t>(pc.max_mana),
+                 static_cast<uint32_t>(dungeon_depth));
+    }
+    for (int s = 0; s < RNG_STREAMS; s++)
+        h ^= key(Z_RNG, s, rng_position(static_cast<RngStream>(s)));
+    return h;
+}
+
+static zobrist_state_t compute() {
+    zobrist_state_t z;
+    for (int i = 0; i < room_count; i++)
+        z.level ^= key(Z_ROOM, i, cell(room_x[i], room_y[i]), cell(room_w[i], room_h[i]));
+    if (upCount)
+        z.level ^= key(Z_STAIRS, '<', cell(up_xCoord, up_yCoord));
+    if (downCount)
+        z.level ^= key(Z_STAIRS, '>', cell(down_xCoord, down_yCoord));
+    for (int y = 0; y < HEIGHT; y++)
+        for (int x = 0; x < WIDTH; x++)
+            z.terrain ^= key(Z_TERRAIN, cell(x, y), static_cast<uint32_t>(hardness[y][x]));
+    for (size_t i = 0; i < characters.size(); i++)
+        z.characters ^= character_key(static_cast<int>(i), characters[i]);
+    for (const ObjectInstance &o : object_instances)
+        z.floor += floor_key(o);
+    return z;
+}
+
+static uint64_t combine(const zobrist_state_t &z) {
+    return z.level ^ z.terrain ^ z.characters ^ z.floor ^ folded();
+}
+
+void zobrist_rehash() {
+    state = compute();
+}
+
+uint64_t zobrist_hash() {
+    return combine(state);
+}
+
+uint64_t zobrist_full() {
+    return combine(compute());
+}
+
+zobrist_state_t zobrist_save() {
+    return state;
+}
+
+void zobrist_restore(const zobrist_state_t &z) {
+    state = z;
+}
+
+void zobrist_terrain(int x, int y, int old_hardness, int new_hardness) {
+    state.terrain ^= key(Z_TERRAIN, cell(x, y), static_cast<uint32_t>(old_hardness)) ^
+                     key(Z_TERRAIN, cell(x, y), static_cast<uint32_t>(new_hardness));
+}
+
+void zobrist_moved(int idx, int ox, int oy, int nx, int ny) {
+    state.characters ^= key(Z_POS, idx, cell(ox, oy)) ^ key(Z_POS, idx, cell(nx, ny));
+}
+
+void zobrist_hp(int idx, int old_hp, int new_hp) {
+    state.characters ^= key(Z_HP, idx, static_cast<uint32_t>(old_hp)) ^
+                        key(Z_HP, idx, static_cast<uint32_t>(new_hp));
+}
+
+void zobrist_died(int idx) {
+    state.characters ^= key(Z_ALIVE, idx);
+}
+
+void zobrist_object_added(const ObjectInstance &o) {
+    state.floor += floor_key(o);
+}
+
+void zobrist_object_removed(const ObjectInstance &o) {
+    state.floor -= floor_key(o);
+}